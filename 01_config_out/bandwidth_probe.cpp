@@ -0,0 +1,156 @@
+#include "bandwidth_probe.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#include "opencl_utils.h"
+#include "units.h"
+
+namespace {
+
+const char* kStreamCopySource = R"CLC(
+__kernel void stream_copy(__global const float4* src, __global float4* dst) {
+    size_t i = get_global_id(0);
+    dst[i] = src[i];
+}
+)CLC";
+
+double nanosecondsSince(std::chrono::steady_clock::time_point start) {
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+// Run the timed operation repetitions + 1 times, drop the warm-up and convert nanoseconds per run into GB/s.
+template <typename Operation>
+Summary timeRepetitions(int repetitions, double bytesPerRun, Operation operation) {
+    std::vector<double> gbs;
+    for(int rep = 0; rep <= repetitions; ++rep) {
+        double nanoseconds = operation();
+        if(rep > 0 && nanoseconds > 0) {
+            gbs.push_back(bytesPerRun / nanoseconds);
+        }
+    }
+    return summarize(gbs);
+}
+
+}
+
+std::vector<BandwidthSample> measureBandwidth(const DeviceRecord& record, const BandwidthOptions& options) {
+    std::vector<BandwidthSample> samples;
+    const auto& caps = record.caps;
+
+    size_t maxBytes = std::min<size_t>(options.maxBytes, static_cast<size_t>(caps.maxMemAllocSize / 4));
+    if(maxBytes < options.minBytes) {
+        return samples;
+    }
+
+    auto session = DeviceSession::create(record.device);
+    cl_program program = buildProgram(session.context, record.device, streamCopySource());
+    cl_kernel kernel = createKernel(program, "stream_copy");
+    cl_int err;
+
+    // Allocate the largest size once, every smaller transfer uses a prefix of the same buffers.
+    std::vector<char> host(maxBytes, 1);
+    cl_mem src = clCreateBuffer(session.context, CL_MEM_READ_WRITE, maxBytes, nullptr, &err);
+    checkOpenCLError(err);
+    cl_mem dst = clCreateBuffer(session.context, CL_MEM_READ_WRITE, maxBytes, nullptr, &err);
+    checkOpenCLError(err);
+    cl_mem mapped = clCreateBuffer(session.context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, maxBytes, nullptr, &err);
+    checkOpenCLError(err);
+    checkOpenCLError( clEnqueueWriteBuffer(session.queue, src, CL_TRUE, 0, maxBytes, host.data(), 0, nullptr, nullptr) );
+    checkOpenCLError( clSetKernelArg(kernel, 0, sizeof(cl_mem), &src) );
+    checkOpenCLError( clSetKernelArg(kernel, 1, sizeof(cl_mem), &dst) );
+
+    for(size_t bytes = options.minBytes; bytes <= maxBytes; bytes *= 4) {
+        double size = static_cast<double>(bytes);
+
+        samples.push_back({"write", bytes, timeRepetitions(options.repetitions, size, [&] {
+            return timeWriteNanoseconds(session, src, bytes, host.data());
+        })});
+
+        samples.push_back({"read", bytes, timeRepetitions(options.repetitions, size, [&] {
+            return timeReadNanoseconds(session, src, bytes, host.data());
+        })});
+
+        samples.push_back({"copy", bytes, timeRepetitions(options.repetitions, 2 * size, [&] {
+            cl_event event;
+            checkOpenCLError( clEnqueueCopyBuffer(session.queue, src, dst, 0, 0, bytes, 0, nullptr, &event) );
+            checkOpenCLError( clWaitForEvents(1, &event) );
+            auto nanoseconds = static_cast<double>(eventElapsedNanoseconds(event));
+            clReleaseEvent(event);
+            return nanoseconds;
+        })});
+
+        samples.push_back({"map-write", bytes, timeRepetitions(options.repetitions, size, [&] {
+            auto start = std::chrono::steady_clock::now();
+            void* ptr = clEnqueueMapBuffer(session.queue, mapped, CL_TRUE, CL_MAP_WRITE_INVALIDATE_REGION, 0, bytes, 0, nullptr, nullptr, &err);
+            checkOpenCLError(err);
+            std::memcpy(ptr, host.data(), bytes);
+            checkOpenCLError( clEnqueueUnmapMemObject(session.queue, mapped, ptr, 0, nullptr, nullptr) );
+            checkOpenCLError( clFinish(session.queue) );
+            return nanosecondsSince(start);
+        })});
+
+        samples.push_back({"map-read", bytes, timeRepetitions(options.repetitions, size, [&] {
+            auto start = std::chrono::steady_clock::now();
+            void* ptr = clEnqueueMapBuffer(session.queue, mapped, CL_TRUE, CL_MAP_READ, 0, bytes, 0, nullptr, nullptr, &err);
+            checkOpenCLError(err);
+            std::memcpy(host.data(), ptr, bytes);
+            checkOpenCLError( clEnqueueUnmapMemObject(session.queue, mapped, ptr, 0, nullptr, nullptr) );
+            checkOpenCLError( clFinish(session.queue) );
+            return nanosecondsSince(start);
+        })});
+
+        samples.push_back({"kernel", bytes, timeRepetitions(options.repetitions, 2 * size, [&] {
+            return timeStreamCopyNanoseconds(session, kernel, bytes);
+        })});
+    }
+
+    clReleaseMemObject(mapped);
+    clReleaseMemObject(dst);
+    clReleaseMemObject(src);
+    clReleaseKernel(kernel);
+    clReleaseProgram(program);
+    session.release();
+    return samples;
+}
+
+std::string streamCopySource() {
+    return kStreamCopySource;
+}
+
+double timeWriteNanoseconds(const DeviceSession& session, cl_mem buffer, size_t bytes, const void* host) {
+    auto start = std::chrono::steady_clock::now();
+    checkOpenCLError( clEnqueueWriteBuffer(session.queue, buffer, CL_TRUE, 0, bytes, host, 0, nullptr, nullptr) );
+    return nanosecondsSince(start);
+}
+
+double timeReadNanoseconds(const DeviceSession& session, cl_mem buffer, size_t bytes, void* host) {
+    auto start = std::chrono::steady_clock::now();
+    checkOpenCLError( clEnqueueReadBuffer(session.queue, buffer, CL_TRUE, 0, bytes, host, 0, nullptr, nullptr) );
+    return nanosecondsSince(start);
+}
+
+double timeStreamCopyNanoseconds(const DeviceSession& session, cl_kernel kernel, size_t bytes) {
+    // One float4 per work-item.
+    size_t items = bytes / 16;
+    cl_event event;
+    checkOpenCLError( clEnqueueNDRangeKernel(session.queue, kernel, 1, nullptr, &items, nullptr, 0, nullptr, &event) );
+    checkOpenCLError( clWaitForEvents(1, &event) );
+    auto nanoseconds = static_cast<double>(eventElapsedNanoseconds(event));
+    clReleaseEvent(event);
+    return nanoseconds;
+}
+
+void printBandwidthReport(const std::vector<BandwidthSample>& samples) {
+    std::cout << std::left << std::setw(10) << "Path" << std::right << std::setw(10) << "Size"
+              << std::setw(12) << "min GB/s" << std::setw(12) << "median" << std::setw(12) << "max" << std::endl;
+    for(const auto& sample : samples) {
+        std::cout << std::left << std::setw(10) << sample.path << std::right << std::setw(10) << formatBytes(sample.bytes)
+                  << std::fixed << std::setprecision(2)
+                  << std::setw(12) << sample.gbs.min << std::setw(12) << sample.gbs.median << std::setw(12) << sample.gbs.max
+                  << std::defaultfloat << std::endl;
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef BANDWIDTH_PROBE_H
+#define BANDWIDTH_PROBE_H
+
+#include <string>
+#include <vector>
+
+#include "device_inventory.h"
+#include "device_session.h"
+#include "statistics.h"
+
+struct BandwidthOptions {
+    // Transfer sizes sweep from minBytes to maxBytes in powers of 4, capped by a quarter of CL_DEVICE_MAX_MEM_ALLOC_SIZE.
+    size_t minBytes = 4u << 10;
+    size_t maxBytes = 64u << 20;
+    // Timed repetitions per path and size, after one untimed warm-up.
+    int repetitions = 10;
+};
+
+// One path at one transfer size. GB/s are 1e9 bytes per second.
+struct BandwidthSample {
+    std::string path;
+    size_t bytes = 0;
+    Summary gbs;
+};
+
+// Measure, for every size of the sweep:
+//      write       clEnqueueWriteBuffer from pageable host memory          (host wall clock)
+//      read        clEnqueueReadBuffer into pageable host memory           (host wall clock)
+//      copy        clEnqueueCopyBuffer between two device buffers          (profiling events, bytes read + written)
+//      map-write   map CL_MEM_ALLOC_HOST_PTR buffer, memcpy in, unmap      (host wall clock)
+//      map-read    map CL_MEM_ALLOC_HOST_PTR buffer, memcpy out, unmap     (host wall clock)
+//      kernel      float4 streaming copy kernel                            (profiling events, bytes read + written)
+// Nothing here depends on a GPU, CPU implementations such as POCL run the same paths.
+std::vector<BandwidthSample> measureBandwidth(const DeviceRecord& record, const BandwidthOptions& options);
+
+// OpenCL C source of stream_copy(__global const float4* src, __global float4* dst), the kernel of the "kernel" path.
+std::string streamCopySource();
+
+// Single transfers of the sweep, in nanoseconds: a blocking write or read of bytes on the host wall clock, and one stream_copy launch over
+// bytes (arguments already set) from its profiling event.
+double timeWriteNanoseconds(const DeviceSession& session, cl_mem buffer, size_t bytes, const void* host);
+double timeReadNanoseconds(const DeviceSession& session, cl_mem buffer, size_t bytes, void* host);
+double timeStreamCopyNanoseconds(const DeviceSession& session, cl_kernel kernel, size_t bytes);
+
+void printBandwidthReport(const std::vector<BandwidthSample>& samples);
+
+#endif //BANDWIDTH_PROBE_H
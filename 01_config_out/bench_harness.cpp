@@ -0,0 +1,184 @@
+#include "bench_harness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+
+#include "statistics.h"
+
+namespace {
+
+const int kBenchFormat = 1;
+// Scale from the median absolute deviation to the standard deviation of normally distributed trials.
+const double kMadToSigma = 1.4826;
+
+// Two-sided 95% critical values of Student's t distribution for 1..30 degrees of freedom, the normal value beyond.
+const double kStudentT95[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228, 2.201, 2.179, 2.160, 2.145, 2.131,
+                              2.120, 2.110, 2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+const double kNormal95 = 1.960;
+
+double studentT95(size_t degreesOfFreedom) {
+    if(degreesOfFreedom == 0) {
+        return 0.0;
+    }
+    const size_t tabulated = sizeof(kStudentT95) / sizeof(kStudentT95[0]);
+    return degreesOfFreedom <= tabulated ? kStudentT95[degreesOfFreedom - 1] : kNormal95;
+}
+
+double medianOf(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    return percentile(values, 50.0);
+}
+
+}
+
+TrialStatistics runTrials(const TrialOptions& options, const std::function<double()>& trial) {
+    for(int run = 0; run < options.warmup; ++run) {
+        trial();
+    }
+    std::vector<double> values;
+    for(int run = 0; run < std::max(1, options.trials); ++run) {
+        values.push_back(trial());
+    }
+
+    TrialStatistics statistics;
+    statistics.trials = values.size();
+    double median = medianOf(values);
+    std::vector<double> deviations;
+    for(auto value : values) {
+        deviations.push_back(std::fabs(value - median));
+    }
+    // With a zero MAD (more than half the trials identical) every other value would count as an outlier, keep them all instead.
+    double sigma = kMadToSigma * medianOf(deviations);
+    if(sigma > 0) {
+        values.erase(std::remove_if(values.begin(), values.end(), [&](double value) {
+            return std::fabs(value - median) > options.outlierDeviations * sigma;
+        }), values.end());
+    }
+    statistics.rejected = statistics.trials - values.size();
+
+    size_t n = values.size();
+    statistics.mean = std::accumulate(values.begin(), values.end(), 0.0) / n;
+    statistics.median = medianOf(values);
+    double squares = 0.0;
+    for(auto value : values) {
+        squares += (value - statistics.mean) * (value - statistics.mean);
+    }
+    statistics.stddev = n > 1 ? std::sqrt(squares / (n - 1)) : 0.0;
+    double halfWidth = studentT95(n - 1) * statistics.stddev / std::sqrt(static_cast<double>(n));
+    statistics.ciLow = statistics.mean - halfWidth;
+    statistics.ciHigh = statistics.mean + halfWidth;
+    return statistics;
+}
+
+std::string benchResultsToJson(const BenchSubject& subject, const std::vector<BenchResult>& results) {
+    JsonWriter json;
+    json.beginObject();
+    json.key("format");
+    json.value(kBenchFormat);
+    json.key("device");
+    json.value(subject.device);
+    json.key("platform");
+    json.value(subject.platform);
+    json.key("driver_version");
+    json.value(subject.driverVersion);
+    json.key("results");
+    json.beginArray();
+    for(const auto& result : results) {
+        const auto& statistics = result.statistics;
+        json.beginObject();
+        json.key("name");
+        json.value(result.name);
+        json.key("unit");
+        json.value(result.unit);
+        json.key("higher_is_better");
+        json.value(result.higherIsBetter);
+        json.key("mean");
+        json.value(statistics.mean);
+        json.key("median");
+        json.value(statistics.median);
+        json.key("stddev");
+        json.value(statistics.stddev);
+        json.key("ci95_low");
+        json.value(statistics.ciLow);
+        json.key("ci95_high");
+        json.value(statistics.ciHigh);
+        json.key("trials");
+        json.value(statistics.trials);
+        json.key("rejected");
+        json.value(statistics.rejected);
+        json.endObject();
+    }
+    json.endArray();
+    json.endObject();
+    return json.str();
+}
+
+bool compareWithBaseline(const BenchSubject& subject, const std::vector<BenchResult>& results, const JsonValue& baseline, double threshold,
+                         std::vector<BenchComparison>& comparisons, std::string& error) {
+    auto format = baseline.find("format");
+    auto device = baseline.find("device");
+    auto entries = baseline.find("results");
+    if(!format || format->number() != kBenchFormat || !device || !entries || entries->type != JsonValue::Type::Array) {
+        error = "not a benchmark results document of format " + std::to_string(kBenchFormat);
+        return false;
+    }
+    if(device->text != subject.device) {
+        error = "baseline was measured on \"" + device->text + "\", not on \"" + subject.device + "\"";
+        return false;
+    }
+
+    comparisons.clear();
+    for(const auto& result : results) {
+        auto entry = std::find_if(entries->items.begin(), entries->items.end(), [&result](const JsonValue& item) {
+            auto name = item.find("name");
+            return name && name->text == result.name;
+        });
+        if(entry == entries->items.end() || !entry->find("mean")) {
+            continue;
+        }
+        BenchComparison comparison;
+        comparison.name = result.name;
+        comparison.baselineMean = entry->find("mean")->number();
+        comparison.currentMean = result.statistics.mean;
+        if(comparison.baselineMean > 0) {
+            double change = (comparison.currentMean - comparison.baselineMean) / comparison.baselineMean;
+            comparison.improvement = result.higherIsBetter ? change : -change;
+            if(result.higherIsBetter) {
+                comparison.regressed = result.statistics.ciHigh < comparison.baselineMean * (1.0 - threshold);
+            }
+            else {
+                comparison.regressed = result.statistics.ciLow > comparison.baselineMean * (1.0 + threshold);
+            }
+        }
+        comparisons.push_back(comparison);
+    }
+    return true;
+}
+
+void printBenchResults(const std::vector<BenchResult>& results) {
+    std::cout << std::left << std::setw(28) << "Benchmark" << std::setw(8) << "unit" << std::right << std::setw(12) << "mean"
+              << std::setw(24) << "95% CI" << std::setw(10) << "stddev" << std::setw(10) << "outliers" << std::endl;
+    for(const auto& result : results) {
+        const auto& statistics = result.statistics;
+        std::ostringstream interval;
+        interval << std::setprecision(4) << "[" << statistics.ciLow << ", " << statistics.ciHigh << "]";
+        std::cout << std::left << std::setw(28) << result.name << std::setw(8) << result.unit << std::right << std::setprecision(4)
+                  << std::setw(12) << statistics.mean << std::setw(24) << interval.str() << std::setw(10) << statistics.stddev
+                  << std::setw(10) << (std::to_string(statistics.rejected) + "/" + std::to_string(statistics.trials)) << std::defaultfloat
+                  << std::setprecision(6) << std::endl;
+    }
+}
+
+void printBenchComparisons(const std::vector<BenchComparison>& comparisons, double threshold) {
+    std::cout << "Against baseline (regression threshold " << threshold * 100 << "%):" << std::endl;
+    for(const auto& comparison : comparisons) {
+        std::cout << std::left << std::setw(28) << comparison.name << std::right << std::setprecision(4) << std::setw(12) << comparison.baselineMean
+                  << " -> " << std::setw(12) << comparison.currentMean << std::fixed << std::setprecision(1) << std::setw(9)
+                  << comparison.improvement * 100 << "%" << (comparison.regressed ? "  REGRESSION" : "") << std::defaultfloat
+                  << std::setprecision(6) << std::endl;
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "json.h"
+
+struct TrialOptions {
+    // Untimed runs before the trials: lazy code upload, page faults, clock ramp-up.
+    int warmup = 3;
+    int trials = 15;
+    // Trials further than this many robust standard deviations (1.4826 x the median absolute deviation) from the median are dropped.
+    double outlierDeviations = 3.0;
+};
+
+// Statistics of the kept trials. The confidence interval is the 95% Student t interval of the mean.
+struct TrialStatistics {
+    size_t trials = 0;
+    size_t rejected = 0;
+    double mean = 0.0;
+    double median = 0.0;
+    double stddev = 0.0;
+    double ciLow = 0.0;
+    double ciHigh = 0.0;
+};
+
+// Warm up, run the trials (each returns one measurement), reject outliers and summarize.
+TrialStatistics runTrials(const TrialOptions& options, const std::function<double()>& trial);
+
+struct BenchResult {
+    std::string name;
+    std::string unit;
+    // Throughputs regress downwards, latencies and durations upwards.
+    bool higherIsBetter = true;
+    TrialStatistics statistics;
+};
+
+// Which device and driver the results belong to, the comparison refuses results of a different device.
+struct BenchSubject {
+    std::string device;
+    std::string platform;
+    std::string driverVersion;
+};
+
+std::string benchResultsToJson(const BenchSubject& subject, const std::vector<BenchResult>& results);
+
+struct BenchComparison {
+    std::string name;
+    double baselineMean = 0.0;
+    double currentMean = 0.0;
+    // Relative change of the mean, positive is better.
+    double improvement = 0.0;
+    bool regressed = false;
+};
+
+// Compare against a document written by benchResultsToJson. A result regressed if even the favorable end of its confidence interval is
+// more than threshold (a fraction, 0.1 = 10%) worse than the baseline mean, so noise alone does not fail the gate.
+// Results missing from the baseline are not compared. Returns false (with error) if the baseline is malformed or of another device.
+bool compareWithBaseline(const BenchSubject& subject, const std::vector<BenchResult>& results, const JsonValue& baseline, double threshold,
+                         std::vector<BenchComparison>& comparisons, std::string& error);
+
+void printBenchResults(const std::vector<BenchResult>& results);
+void printBenchComparisons(const std::vector<BenchComparison>& comparisons, double threshold);
+
+#endif //BENCH_HARNESS_H
@@ -0,0 +1,223 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <CL/cl.h>
+
+#include "bandwidth_probe.h"
+#include "bench_harness.h"
+#include "binary_archive.h"
+#include "cache_paths.h"
+#include "capability_cache.h"
+#include "compute_probe.h"
+#include "device_capabilities.h"
+#include "device_inventory.h"
+#include "device_session.h"
+#include "json.h"
+#include "latency_probe.h"
+#include "opencl_utils.h"
+
+namespace {
+
+// CTest treats this exit status as a skipped test (SKIP_RETURN_CODE): no OpenCL device, or no baseline recorded yet.
+const int kExitSkipped = 77;
+
+const size_t kTransferBytes = 16u << 20;
+// The compute probe's kernel at the width most devices run natively.
+const cl_uint kFmaWidth = 4;
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]" << std::endl
+              << "  --device N          benchmark device #N (default: the first CPU device, else #0)" << std::endl
+              << "  --warmup N          untimed runs before the trials (default 3)" << std::endl
+              << "  --trials N          timed trials per benchmark (default 15)" << std::endl
+              << "  --json FILE         write the results as JSON (\"-\" for stdout)" << std::endl
+              << "  --baseline FILE     compare against stored results, exit status 1 on a regression, 77 if the file does not exist" << std::endl
+              << "  --record            write this run as the baseline instead of comparing" << std::endl
+              << "  --threshold PCT     regression threshold in percent (default 10)" << std::endl;
+}
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+size_t defaultDevice(const DeviceInventory& inventory) {
+    for(size_t idx = 0; idx < inventory.devices.size(); ++idx) {
+        if(inventory.devices[idx].caps.type & CL_DEVICE_TYPE_CPU) {
+            return idx;
+        }
+    }
+    return 0;
+}
+
+// The probes of the gate: what a driver or library upgrade tends to break, from the start-up path to kernel throughput. Each trial is one
+// run of the single-launch helpers the latency, bandwidth and compute probes time themselves with.
+std::vector<BenchResult> runBenchmarks(const DeviceRecord& record, const TrialOptions& options) {
+    std::vector<BenchResult> results;
+    auto session = DeviceSession::create(record.device);
+    cl_int err;
+
+    results.push_back({"capability_query", "us", false, runTrials(options, [&record] {
+        auto start = std::chrono::steady_clock::now();
+        DeviceCapabilities::query(record.device);
+        return millisecondsSince(start) * 1000.0;
+    })});
+
+    // A distinct define per build, so a driver side program cache does not turn the measurement into a lookup.
+    int build = 0;
+    results.push_back({"program_build", "ms", false, runTrials(options, [&session, &build] {
+        auto start = std::chrono::steady_clock::now();
+        cl_program program = buildFmaChainProgram(session, "float", "-DBENCH_BUILD=" + std::to_string(build++));
+        double milliseconds = millisecondsSince(start);
+        clReleaseProgram(program);
+        return milliseconds;
+    })});
+
+    cl_program latencyProgram = buildProgram(session.context, record.device, latencyProbeSource());
+    cl_kernel empty = createKernel(latencyProgram, "empty_kernel");
+    results.push_back({"launch_round_trip", "us", false, runTrials(options, [&session, empty] {
+        return launchRoundTripMicroseconds(session, empty, 1);
+    })});
+    clReleaseKernel(empty);
+    clReleaseProgram(latencyProgram);
+
+    // Whole float4s, stream_copy moves one per work-item.
+    size_t transferBytes = std::min<size_t>(kTransferBytes, record.caps.maxMemAllocSize) / 16 * 16;
+    std::vector<char> host(transferBytes, 1);
+    cl_mem src = clCreateBuffer(session.context, CL_MEM_READ_WRITE, transferBytes, nullptr, &err);
+    checkOpenCLError(err);
+    cl_mem dst = clCreateBuffer(session.context, CL_MEM_READ_WRITE, transferBytes, nullptr, &err);
+    checkOpenCLError(err);
+    // GB/s are bytes per nanosecond.
+    results.push_back({"write_bandwidth", "GB/s", true, runTrials(options, [&session, src, &host] {
+        return host.size() / std::max(timeWriteNanoseconds(session, src, host.size(), host.data()), 1.0);
+    })});
+    results.push_back({"read_bandwidth", "GB/s", true, runTrials(options, [&session, src, &host] {
+        return host.size() / std::max(timeReadNanoseconds(session, src, host.size(), host.data()), 1.0);
+    })});
+
+    cl_program copyProgram = buildProgram(session.context, record.device, streamCopySource());
+    cl_kernel copy = createKernel(copyProgram, "stream_copy");
+    checkOpenCLError( clSetKernelArg(copy, 0, sizeof(cl_mem), &src) );
+    checkOpenCLError( clSetKernelArg(copy, 1, sizeof(cl_mem), &dst) );
+    results.push_back({"kernel_copy_bandwidth", "GB/s", true, runTrials(options, [&session, copy, transferBytes] {
+        return 2.0 * transferBytes / std::max(timeStreamCopyNanoseconds(session, copy, transferBytes), 1.0);
+    })});
+    clReleaseKernel(copy);
+    clReleaseProgram(copyProgram);
+    clReleaseMemObject(dst);
+    clReleaseMemObject(src);
+
+    size_t fmaItems = fmaChainItems(record.caps);
+    cl_mem out = clCreateBuffer(session.context, CL_MEM_WRITE_ONLY, fmaItems * kFmaWidth * sizeof(cl_float), nullptr, &err);
+    checkOpenCLError(err);
+    cl_program fmaProgram = buildFmaChainProgram(session, "float");
+    cl_kernel fma = createFmaChainKernel(fmaProgram, kFmaWidth, out);
+    results.push_back({"fma_throughput", "GFLOPS", true, runTrials(options, [&session, fma, fmaItems] {
+        return launchFmaChainGflops(session, fma, fmaItems, kFmaWidth);
+    })});
+    clReleaseKernel(fma);
+    clReleaseProgram(fmaProgram);
+    clReleaseMemObject(out);
+
+    session.release();
+    return results;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    long deviceIndex = -1;
+    TrialOptions options;
+    std::string jsonPath;
+    std::string baselinePath;
+    bool record = false;
+    double threshold = 0.10;
+    for(int idx = 1; idx < argc; ++idx) {
+        std::string arg = argv[idx];
+        if(arg == "--device" && idx + 1 < argc) {
+            deviceIndex = std::stol(argv[++idx]);
+        }
+        else if(arg == "--warmup" && idx + 1 < argc) {
+            options.warmup = std::max(0, std::stoi(argv[++idx]));
+        }
+        else if(arg == "--trials" && idx + 1 < argc) {
+            options.trials = std::max(2, std::stoi(argv[++idx]));
+        }
+        else if(arg == "--json" && idx + 1 < argc) {
+            jsonPath = argv[++idx];
+        }
+        else if(arg == "--baseline" && idx + 1 < argc) {
+            baselinePath = argv[++idx];
+        }
+        else if(arg == "--record") {
+            record = true;
+        }
+        else if(arg == "--threshold" && idx + 1 < argc) {
+            threshold = std::max(0.0, std::stod(argv[++idx]) / 100.0);
+        }
+        else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    // Always the live driver values: the cache could hide exactly the upgrade the gate is meant to catch.
+    CapabilityCache cache(cacheFilePath("device_capabilities.bin"));
+    auto inventory = DeviceInventory::enumerate(cache, true, 0);
+    if(inventory.devices.empty()) {
+        std::cerr << "No OpenCL device found, nothing to benchmark" << std::endl;
+        return kExitSkipped;
+    }
+    size_t target = deviceIndex < 0 ? defaultDevice(inventory) : static_cast<size_t>(deviceIndex);
+    if(target >= inventory.devices.size()) {
+        std::cerr << "No device #" << deviceIndex << ", " << inventory.devices.size() << " devices found" << std::endl;
+        return 1;
+    }
+    const auto& device = inventory.devices[target];
+    BenchSubject subject{device.caps.name, device.caps.platformName, device.caps.driverVersion};
+    std::cout << "Benchmarking " << subject.device << " on " << subject.platform << ", driver " << subject.driverVersion << ": "
+              << options.warmup << " warm-up runs, " << options.trials << " trials" << std::endl;
+
+    auto results = runBenchmarks(device, options);
+    printBenchResults(results);
+    auto json = benchResultsToJson(subject, results);
+    if(!jsonPath.empty() && !writeWholeFile(jsonPath, json)) {
+        std::cerr << "Failed to write " << jsonPath << std::endl;
+        return 1;
+    }
+    if(baselinePath.empty()) {
+        return 0;
+    }
+
+    if(record) {
+        if(!writeWholeFile(baselinePath, json)) {
+            std::cerr << "Failed to write baseline " << baselinePath << std::endl;
+            return 1;
+        }
+        std::cout << "Baseline recorded in " << baselinePath << std::endl;
+        return 0;
+    }
+    // Never record implicitly: a fresh build directory would pass without comparing anything, and a driver upgrade that came first
+    // would become the reference.
+    std::vector<char> baselineData;
+    if(!readWholeFile(baselinePath, baselineData)) {
+        std::cerr << "No baseline " << baselinePath << ", record one with --record" << std::endl;
+        return kExitSkipped;
+    }
+    JsonValue baseline;
+    std::string error;
+    std::vector<BenchComparison> comparisons;
+    if(!parseJson(std::string(baselineData.begin(), baselineData.end()), baseline, error)
+       || !compareWithBaseline(subject, results, baseline, threshold, comparisons, error)) {
+        std::cerr << "Invalid baseline " << baselinePath << ": " << error << std::endl;
+        return 1;
+    }
+    printBenchComparisons(comparisons, threshold);
+    bool regressed = std::any_of(comparisons.begin(), comparisons.end(), [](const BenchComparison& comparison) { return comparison.regressed; });
+    return regressed ? 1 : 0;
+}
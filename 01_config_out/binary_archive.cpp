@@ -0,0 +1,50 @@
+#include "binary_archive.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool readWholeFile(const std::string& path, std::vector<char>& data) {
+    std::ifstream file(path, std::ios::binary);
+    if(!file) {
+        return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+bool replaceFile(const std::string& path, const std::vector<char>& data) {
+    // A unique name in the target's directory: concurrent runs (e.g. a fleet sharing $HOME) each write their own file, and the rename
+    // stays within one file system.
+    std::string tmpPath = path + ".XXXXXX";
+    int fd = mkstemp(&tmpPath[0]);
+    if(fd < 0) {
+        return false;
+    }
+    // mkstemp creates 0600, keep the cache readable like a file written with the default umask.
+    fchmod(fd, 0644);
+    size_t written = 0;
+    while(written < data.size()) {
+        ssize_t count = write(fd, data.data() + written, data.size() - written);
+        if(count < 0 && errno == EINTR) {
+            continue;
+        }
+        if(count <= 0) {
+            break;
+        }
+        written += static_cast<size_t>(count);
+    }
+    // A short write or a failed close (e.g. ENOSPC reported late) must not replace the good file.
+    bool ok = written == data.size();
+    ok = close(fd) == 0 && ok;
+    if(!ok || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
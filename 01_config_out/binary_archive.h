@@ -0,0 +1,93 @@
+#ifndef BINARY_ARCHIVE_H
+#define BINARY_ARCHIVE_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Minimal binary serialization shared by the on-disk caches. Trivially copyable values are stored raw (host endianness),
+// strings and vectors are prefixed with a 64 bit element count. A cache written on another machine is simply rejected by its magic or version.
+class BinaryWriter {
+public:
+    template <typename T>
+    void operator()(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable fields can be written raw");
+        auto bytes = reinterpret_cast<const char*>(&value);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+    }
+    void operator()(const std::string& value) {
+        (*this)(static_cast<uint64_t>(value.size()));
+        buffer.insert(buffer.end(), value.begin(), value.end());
+    }
+    template <typename T>
+    void operator()(const std::vector<T>& values) {
+        (*this)(static_cast<uint64_t>(values.size()));
+        for(const auto& value : values) {
+            (*this)(value);
+        }
+    }
+
+    std::vector<char> buffer;
+};
+
+// Reads what BinaryWriter wrote. Never reads past the end, ok turns false instead and every later read is a no-op.
+class BinaryReader {
+public:
+    BinaryReader(const char* data, size_t size) : cursor(data), end(data + size) {}
+
+    template <typename T>
+    void operator()(T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable fields can be read raw");
+        if(!take(sizeof(T))) {
+            return;
+        }
+        std::memcpy(&value, cursor - sizeof(T), sizeof(T));
+    }
+    void operator()(std::string& value) {
+        uint64_t size = 0;
+        (*this)(size);
+        if(!take(size)) {
+            return;
+        }
+        value.assign(cursor - size, cursor);
+    }
+    template <typename T>
+    void operator()(std::vector<T>& values) {
+        uint64_t size = 0;
+        (*this)(size);
+        if(size > static_cast<uint64_t>(end - cursor)) {
+            ok = false;
+            return;
+        }
+        values.resize(size);
+        for(auto& value : values) {
+            (*this)(value);
+        }
+    }
+
+    bool ok = true;
+
+private:
+    bool take(uint64_t size) {
+        if(!ok || size > static_cast<uint64_t>(end - cursor)) {
+            ok = false;
+            return false;
+        }
+        cursor += size;
+        return true;
+    }
+
+    const char* cursor;
+    const char* end;
+};
+
+// Read a whole file into memory. Returns false if it cannot be opened.
+bool readWholeFile(const std::string& path, std::vector<char>& data);
+
+// Write the buffer to a uniquely named temporary file next to path and rename it over path once it is completely written, so a
+// concurrent run never sees a half written file. On any failure path is left untouched.
+bool replaceFile(const std::string& path, const std::vector<char>& data);
+
+#endif //BINARY_ARCHIVE_H
@@ -0,0 +1,227 @@
+#include "buffer_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+#include "device_session.h"
+#include "opencl_utils.h"
+#include "units.h"
+
+namespace {
+
+const size_t kDefaultParentSize = 64u << 20;
+// Requests above parentSize / kLargestClassDivisor get a dedicated buffer, so one allocation never claims most of a parent.
+const size_t kLargestClassDivisor = 8;
+
+}
+
+double PoolStatistics::internalFragmentation() const {
+    return liveReservedBytes > 0 ? 1.0 - static_cast<double>(liveRequestedBytes) / liveReservedBytes : 0.0;
+}
+
+double PoolStatistics::externalFragmentation() const {
+    return parentBytes > 0 ? static_cast<double>(cachedBytes + retiredTailBytes) / parentBytes : 0.0;
+}
+
+BufferPool::BufferPool(cl_context context, const DeviceCapabilities& caps, size_t parentSize, cl_mem_flags flags)
+        : context_(context), flags_(flags) {
+    // CL_DEVICE_MEM_BASE_ADDR_ALIGN is in bits.
+    alignment_ = std::max<size_t>(caps.memBaseAddrAlign / 8, 64);
+    parentSize_ = parentSize ? parentSize : kDefaultParentSize;
+    if(caps.maxMemAllocSize > 0) {
+        parentSize_ = std::min<size_t>(parentSize_, caps.maxMemAllocSize);
+    }
+    parentSize_ = std::max(parentSize_ / alignment_ * alignment_, alignment_);
+
+    classCount_ = 1;
+    while(classBytes(classCount_) <= parentSize_ / kLargestClassDivisor) {
+        ++classCount_;
+    }
+    freeLists_.resize(classCount_);
+}
+
+BufferPool::~BufferPool() {
+    for(auto buffer : subBuffers_) {
+        clReleaseMemObject(buffer);
+    }
+    for(const auto& parent : parents_) {
+        clReleaseMemObject(parent.buffer);
+    }
+}
+
+int BufferPool::sizeClassOf(size_t size) const {
+    for(int sizeClass = 0; sizeClass < classCount_; ++sizeClass) {
+        if(size <= classBytes(sizeClass)) {
+            return sizeClass;
+        }
+    }
+    return -1;
+}
+
+cl_mem BufferPool::carve(size_t bytes) {
+    // Only the newest parent is carved from, older ones are full up to a tail smaller than this request.
+    if(parents_.empty() || parents_.back().used + bytes > parentSize_) {
+        if(!parents_.empty()) {
+            stats_.retiredTailBytes += parentSize_ - parents_.back().used;
+        }
+        cl_int err;
+        cl_mem buffer = clCreateBuffer(context_, flags_, parentSize_, nullptr, &err);
+        checkOpenCLError(err);
+        parents_.push_back({buffer, 0});
+        ++stats_.parentBuffers;
+        stats_.parentBytes += parentSize_;
+    }
+
+    auto& parent = parents_.back();
+    cl_buffer_region region = {parent.used, bytes};
+    cl_int err;
+    // Flags 0: the sub-buffer inherits the access flags of the parent.
+    cl_mem buffer = clCreateSubBuffer(parent.buffer, 0, CL_BUFFER_CREATE_TYPE_REGION, &region, &err);
+    checkOpenCLError(err);
+    parent.used += bytes;
+    subBuffers_.push_back(buffer);
+    ++stats_.subBuffersCreated;
+    return buffer;
+}
+
+PoolAllocation BufferPool::allocate(size_t size) {
+    PoolAllocation allocation;
+    allocation.size = std::max<size_t>(size, 1);
+    allocation.sizeClass = sizeClassOf(allocation.size);
+
+    if(allocation.sizeClass < 0) {
+        cl_int err;
+        allocation.buffer = clCreateBuffer(context_, flags_, allocation.size, nullptr, &err);
+        checkOpenCLError(err);
+        allocation.reserved = allocation.size;
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.allocations;
+        ++stats_.dedicatedBuffers;
+        return allocation;
+    }
+
+    allocation.reserved = classBytes(allocation.sizeClass);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& freeList = freeLists_[allocation.sizeClass];
+    if(!freeList.empty()) {
+        allocation.buffer = freeList.back();
+        freeList.pop_back();
+        ++stats_.reuses;
+        --stats_.cachedAllocations;
+        stats_.cachedBytes -= allocation.reserved;
+    }
+    else {
+        allocation.buffer = carve(allocation.reserved);
+    }
+    ++stats_.allocations;
+    ++stats_.liveAllocations;
+    stats_.liveRequestedBytes += allocation.size;
+    stats_.liveReservedBytes += allocation.reserved;
+    return allocation;
+}
+
+void BufferPool::free(const PoolAllocation& allocation) {
+    if(!allocation.buffer) {
+        return;
+    }
+    if(allocation.sizeClass < 0) {
+        clReleaseMemObject(allocation.buffer);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    freeLists_[allocation.sizeClass].push_back(allocation.buffer);
+    --stats_.liveAllocations;
+    stats_.liveRequestedBytes -= allocation.size;
+    stats_.liveReservedBytes -= allocation.reserved;
+    ++stats_.cachedAllocations;
+    stats_.cachedBytes += allocation.reserved;
+}
+
+PoolStatistics BufferPool::statistics() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+PoolChurnResult measurePoolChurn(const DeviceRecord& record, int rounds) {
+    const size_t buffersPerRound = 256;
+    PoolChurnResult result;
+
+    auto session = DeviceSession::create(record.device, 0);
+    cl_int err;
+
+    // Same sizes and free order for both allocators. Sizes are log-uniform, small buffers dominate like in the services.
+    std::mt19937 random(12345);
+    std::uniform_real_distribution<double> logSize(6.0, 16.0);
+    std::vector<std::vector<size_t>> sizes(rounds);
+    std::vector<std::vector<size_t>> freeOrder(rounds);
+    for(int round = 0; round < rounds; ++round) {
+        for(size_t idx = 0; idx < buffersPerRound; ++idx) {
+            sizes[round].push_back(static_cast<size_t>(std::exp2(logSize(random))));
+            freeOrder[round].push_back(idx);
+        }
+        std::shuffle(freeOrder[round].begin(), freeOrder[round].end(), random);
+    }
+    result.operations = static_cast<size_t>(rounds) * buffersPerRound;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<cl_mem> raw(buffersPerRound);
+    for(int round = 0; round < rounds; ++round) {
+        for(size_t idx = 0; idx < buffersPerRound; ++idx) {
+            raw[idx] = clCreateBuffer(session.context, CL_MEM_READ_WRITE, sizes[round][idx], nullptr, &err);
+            checkOpenCLError(err);
+        }
+        for(auto idx : freeOrder[round]) {
+            clReleaseMemObject(raw[idx]);
+        }
+    }
+    double rawSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    {
+        BufferPool pool(session.context, record.caps);
+        std::vector<PoolAllocation> allocations(buffersPerRound);
+        start = std::chrono::steady_clock::now();
+        for(int round = 0; round < rounds; ++round) {
+            for(size_t idx = 0; idx < buffersPerRound; ++idx) {
+                allocations[idx] = pool.allocate(sizes[round][idx]);
+            }
+            // Keep the last round live so the statistics show the fragmentation of a populated pool.
+            if(round + 1 < rounds) {
+                for(auto idx : freeOrder[round]) {
+                    pool.free(allocations[idx]);
+                }
+            }
+        }
+        double poolSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        result.statistics = pool.statistics();
+        result.alignment = pool.alignment();
+        result.parentSize = pool.parentSize();
+        result.rawAllocationsPerSecond = rawSeconds > 0 ? result.operations / rawSeconds : 0.0;
+        result.poolAllocationsPerSecond = poolSeconds > 0 ? result.operations / poolSeconds : 0.0;
+    }
+
+    session.release();
+    return result;
+}
+
+void printPoolChurnReport(const PoolChurnResult& result) {
+    const auto& stats = result.statistics;
+    std::cout << "Churn of " << result.operations << " allocate/free pairs, sizes 64 B to 64 KiB" << std::endl
+              << std::fixed << std::setprecision(0)
+              << "    clCreateBuffer/clReleaseMemObject: " << result.rawAllocationsPerSecond << " allocations/s" << std::endl
+              << "    BufferPool:                        " << result.poolAllocationsPerSecond << " allocations/s"
+              << std::setprecision(1) << " (" << (result.rawAllocationsPerSecond > 0 ? result.poolAllocationsPerSecond / result.rawAllocationsPerSecond : 0.0) << "x)" << std::endl
+              << std::defaultfloat;
+    std::cout << "Pool: alignment " << result.alignment << " B, " << stats.parentBuffers << " parent(s) of " << formatBytes(result.parentSize)
+              << ", " << stats.subBuffersCreated << " sub-buffers created, " << stats.reuses << " of " << stats.allocations << " allocations reused"
+              << ", " << stats.dedicatedBuffers << " dedicated" << std::endl;
+    std::cout << "Live: " << stats.liveAllocations << " allocations, " << formatBytes(stats.liveRequestedBytes) << " requested in "
+              << formatBytes(stats.liveReservedBytes) << " reserved, free lists hold " << stats.cachedAllocations << " (" << formatBytes(stats.cachedBytes) << ")"
+              << ", retired tails " << formatBytes(stats.retiredTailBytes) << std::endl;
+    std::cout << std::fixed << std::setprecision(1) << "Fragmentation: internal " << stats.internalFragmentation() * 100 << "%, external "
+              << stats.externalFragmentation() * 100 << "%" << std::defaultfloat << std::endl;
+}
@@ -0,0 +1,103 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include <CL/cl.h>
+
+#include "device_inventory.h"
+
+// A sub-buffer handed out by BufferPool. Pass buffer to kernels like any cl_mem, give the whole allocation back with BufferPool::free.
+struct PoolAllocation {
+    cl_mem buffer = nullptr;
+    // Bytes asked for and bytes reserved (the size class).
+    size_t size = 0;
+    size_t reserved = 0;
+    // Index into the size classes, -1 for requests too large to pool, which get a buffer of their own.
+    int sizeClass = -1;
+};
+
+struct PoolStatistics {
+    size_t parentBuffers = 0;
+    uint64_t parentBytes = 0;
+    // Handed out and not yet freed.
+    size_t liveAllocations = 0;
+    uint64_t liveRequestedBytes = 0;
+    uint64_t liveReservedBytes = 0;
+    // Freed sub-buffers kept on the free lists for reuse.
+    size_t cachedAllocations = 0;
+    uint64_t cachedBytes = 0;
+    // Unused ends of parents that were retired because the next allocation did not fit.
+    uint64_t retiredTailBytes = 0;
+    uint64_t allocations = 0;
+    uint64_t reuses = 0;
+    uint64_t subBuffersCreated = 0;
+    uint64_t dedicatedBuffers = 0;
+
+    // Share of the reserved bytes lost to rounding up to the size class.
+    double internalFragmentation() const;
+    // Share of the parent bytes neither live nor still available for new carving (free lists and retired tails).
+    double externalFragmentation() const;
+};
+
+// Pool of sub-buffers carved out of a few large parent buffers, replacing clCreateBuffer/clReleaseMemObject per allocation.
+// Requests are rounded up to power of two size classes, never smaller than CL_DEVICE_MEM_BASE_ADDR_ALIGN, so every sub-buffer origin is
+// aligned as clCreateSubBuffer requires. Freed sub-buffers stay alive on a free list per size class and are handed out again as is,
+// so a reuse costs neither clCreateSubBuffer nor clReleaseMemObject. Safe to use from several threads.
+class BufferPool {
+public:
+    // parentSize 0 picks 64 MiB, capped at CL_DEVICE_MAX_MEM_ALLOC_SIZE.
+    BufferPool(cl_context context, const DeviceCapabilities& caps, size_t parentSize = 0, cl_mem_flags flags = CL_MEM_READ_WRITE);
+    ~BufferPool();
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    PoolAllocation allocate(size_t size);
+    void free(const PoolAllocation& allocation);
+
+    PoolStatistics statistics() const;
+    size_t alignment() const { return alignment_; }
+    size_t parentSize() const { return parentSize_; }
+
+private:
+    struct Parent {
+        cl_mem buffer;
+        size_t used;
+    };
+
+    int sizeClassOf(size_t size) const;
+    size_t classBytes(int sizeClass) const { return alignment_ << sizeClass; }
+    cl_mem carve(size_t bytes);
+
+    cl_context context_;
+    cl_mem_flags flags_;
+    size_t alignment_;
+    size_t parentSize_;
+    int classCount_;
+
+    mutable std::mutex mutex_;
+    std::vector<Parent> parents_;
+    std::vector<std::vector<cl_mem>> freeLists_;
+    // Every sub-buffer ever created, released before the parents.
+    std::vector<cl_mem> subBuffers_;
+    PoolStatistics stats_;
+};
+
+struct PoolChurnResult {
+    size_t operations = 0;
+    double rawAllocationsPerSecond = 0.0;
+    double poolAllocationsPerSecond = 0.0;
+    PoolStatistics statistics;
+    size_t alignment = 0;
+    size_t parentSize = 0;
+};
+
+// Allocate and free rounds of small buffers of random sizes (64 B to 64 KiB), once with clCreateBuffer/clReleaseMemObject, once through a pool.
+PoolChurnResult measurePoolChurn(const DeviceRecord& record, int rounds);
+
+void printPoolChurnReport(const PoolChurnResult& result);
+
+#endif //BUFFER_POOL_H
@@ -0,0 +1,56 @@
+#include "cache_paths.h"
+
+#include <cerrno>
+#include <cstdlib>
+
+#include <sys/stat.h>
+
+namespace {
+
+// mkdir -p
+bool makeDirectories(const std::string& path) {
+    for(size_t pos = path.find('/', 1); ; pos = path.find('/', pos + 1)) {
+        auto prefix = path.substr(0, pos);
+        if(mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST) {
+            return false;
+        }
+        if(pos == std::string::npos) {
+            return true;
+        }
+    }
+}
+
+}
+
+std::string cacheDirectory() {
+    static const std::string directory = [] {
+        std::string path;
+        if(const char* dir = std::getenv("OPENCL_CONFIG_OUT_CACHE_DIR")) {
+            path = dir;
+        }
+        else if(const char* xdg = std::getenv("XDG_CACHE_HOME")) {
+            path = std::string(xdg) + "/opencl_config_out";
+        }
+        else if(const char* home = std::getenv("HOME")) {
+            path = std::string(home) + "/.cache/opencl_config_out";
+        }
+
+        if(path.empty() || !makeDirectories(path)) {
+            return std::string(".");
+        }
+        return path;
+    }();
+    return directory;
+}
+
+std::string cacheFilePath(const std::string& fileName) {
+    return cacheDirectory() + "/" + fileName;
+}
+
+std::string cacheSubdirectory(const std::string& name) {
+    auto path = cacheFilePath(name);
+    if(!makeDirectories(path)) {
+        return cacheDirectory();
+    }
+    return path;
+}
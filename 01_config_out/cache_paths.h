@@ -0,0 +1,16 @@
+#ifndef CACHE_PATHS_H
+#define CACHE_PATHS_H
+
+#include <string>
+
+// Directory holding the tool's on-disk caches, created on first use.
+// $OPENCL_CONFIG_OUT_CACHE_DIR wins, then $XDG_CACHE_HOME/opencl_config_out, then $HOME/.cache/opencl_config_out, then the working directory.
+std::string cacheDirectory();
+
+// Full path of a file inside cacheDirectory().
+std::string cacheFilePath(const std::string& fileName);
+
+// Subdirectory of cacheDirectory() for caches made of many files, created on first use. Falls back to cacheDirectory() itself.
+std::string cacheSubdirectory(const std::string& name);
+
+#endif //CACHE_PATHS_H
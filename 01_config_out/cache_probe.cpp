@@ -0,0 +1,211 @@
+#include "cache_probe.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <sstream>
+
+#include "device_session.h"
+#include "opencl_utils.h"
+#include "units.h"
+
+namespace {
+
+const char* kChaseSource = R"CLC(
+__kernel void chase(__global const uint* next, uint steps, __global uint* sink) {
+    uint p = 0;
+    for(uint i = 0; i < steps; ++i) {
+        p = next[p];
+    }
+    sink[0] = p;
+}
+)CLC";
+
+const size_t kMinWorkingSet = 1024;
+// Block of the stride sweep, the largest stride tested is half of it.
+const size_t kBlockBytes = 1024;
+// Working set of the stride sweep: beyond every first level cache, small enough to upload quickly for each stride.
+const size_t kStrideWorkingSet = 16u << 20;
+// A latency this much above the current plateau starts the next level.
+const double kLevelJump = 1.25;
+// While consecutive points still rise by this much the curve is between two plateaus.
+const double kStillRising = 1.1;
+const int kTimedRuns = 3;
+
+struct Chaser {
+    const DeviceSession& session;
+    cl_kernel kernel;
+    cl_mem chain;
+
+    // Upload the chain, warm the caches with one pass and return the median latency of one dependent load.
+    double measure(const std::vector<cl_uint>& next, size_t bytes, uint32_t steps, uint32_t warmupSteps) {
+        checkOpenCLError( clEnqueueWriteBuffer(session.queue, chain, CL_TRUE, 0, bytes, next.data(), 0, nullptr, nullptr) );
+        run(warmupSteps);
+        std::vector<double> samples;
+        for(int rep = 0; rep < kTimedRuns; ++rep) {
+            double single = run(steps);
+            double twice = run(2 * steps);
+            samples.push_back(std::max(0.0, (twice - single) / steps));
+        }
+        std::sort(samples.begin(), samples.end());
+        return samples[samples.size() / 2];
+    }
+
+    double run(uint32_t steps) {
+        checkOpenCLError( clSetKernelArg(kernel, 1, sizeof(cl_uint), &steps) );
+        size_t one = 1;
+        cl_event event;
+        checkOpenCLError( clEnqueueNDRangeKernel(session.queue, kernel, 1, nullptr, &one, &one, 0, nullptr, &event) );
+        checkOpenCLError( clWaitForEvents(1, &event) );
+        auto nanoseconds = eventElapsedNanoseconds(event);
+        clReleaseEvent(event);
+        return static_cast<double>(nanoseconds);
+    }
+};
+
+// Working sets of the size sweep: powers of two and the midpoints 1.5x between them.
+std::vector<size_t> workingSets(size_t maxBytes) {
+    std::vector<size_t> sizes;
+    for(size_t bytes = kMinWorkingSet; bytes <= maxBytes; bytes *= 2) {
+        sizes.push_back(bytes);
+        if(bytes + bytes / 2 <= maxBytes) {
+            sizes.push_back(bytes + bytes / 2);
+        }
+    }
+    return sizes;
+}
+
+// Plateaus of the latency curve: a point kLevelJump above the current plateau closes the level at the previous working set.
+std::vector<CacheLevel> inferLevels(const std::vector<LatencyPoint>& sweep) {
+    std::vector<CacheLevel> levels;
+    if(sweep.empty()) {
+        return levels;
+    }
+    double plateau = sweep.front().nanoseconds;
+    for(size_t idx = 1; idx < sweep.size(); ++idx) {
+        if(plateau > 0 && sweep[idx].nanoseconds > plateau * kLevelJump) {
+            levels.push_back({sweep[idx - 1].bytes, plateau});
+            while(idx + 1 < sweep.size() && sweep[idx + 1].nanoseconds > sweep[idx].nanoseconds * kStillRising) {
+                ++idx;
+            }
+            plateau = sweep[idx].nanoseconds;
+        }
+    }
+    // Whatever lies beyond the last step is main memory, or the outermost level the sweep could not leave.
+    levels.push_back({0, plateau});
+    return levels;
+}
+
+}
+
+CacheProbeReport measureCacheHierarchy(const DeviceRecord& record, const CacheProbeOptions& options) {
+    CacheProbeReport report;
+    const auto& caps = record.caps;
+    size_t maxWorkingSet = std::max(kStrideWorkingSet, std::min<size_t>(options.maxWorkingSet, caps.maxMemAllocSize / 2));
+    uint32_t steps = std::max<uint32_t>(options.steps, 1024);
+
+    auto session = DeviceSession::create(record.device);
+    cl_program program = buildProgram(session.context, record.device, kChaseSource);
+    cl_kernel kernel = createKernel(program, "chase");
+    cl_int err;
+    cl_mem chain = clCreateBuffer(session.context, CL_MEM_READ_ONLY, maxWorkingSet, nullptr, &err);
+    checkOpenCLError(err);
+    cl_mem sink = clCreateBuffer(session.context, CL_MEM_WRITE_ONLY, sizeof(cl_uint), nullptr, &err);
+    checkOpenCLError(err);
+    checkOpenCLError( clSetKernelArg(kernel, 0, sizeof(cl_mem), &chain) );
+    checkOpenCLError( clSetKernelArg(kernel, 2, sizeof(cl_mem), &sink) );
+    Chaser chaser{session, kernel, chain};
+
+    std::mt19937 random(42);
+    std::vector<cl_uint> next(maxWorkingSet / sizeof(cl_uint), 0);
+
+    // Stride sweep: blocks in random order, the pair of loads of each block at distance stride.
+    {
+        size_t blocks = kStrideWorkingSet / kBlockBytes;
+        const size_t blockElements = kBlockBytes / sizeof(cl_uint);
+        std::vector<cl_uint> order(blocks);
+        std::iota(order.begin(), order.end(), 0);
+        std::shuffle(order.begin() + 1, order.end(), random);
+        for(size_t stride = sizeof(cl_uint); stride <= kBlockBytes / 2; stride *= 2) {
+            for(size_t idx = 0; idx < blocks; ++idx) {
+                size_t base = order[idx] * blockElements;
+                size_t partner = base + stride / sizeof(cl_uint);
+                next[base] = static_cast<cl_uint>(partner);
+                next[partner] = static_cast<cl_uint>(order[(idx + 1) % blocks] * blockElements);
+            }
+            double pair = chaser.measure(next, kStrideWorkingSet, steps, static_cast<uint32_t>(2 * blocks));
+            report.strideSweep.push_back({stride, pair});
+        }
+        // Below the line size a pair is one miss and one hit, from the line size on two misses: the line size is the first stride
+        // past the midpoint between the two.
+        double low = report.strideSweep.front().nanoseconds, high = report.strideSweep.back().nanoseconds;
+        if(high > low * kLevelJump) {
+            for(const auto& point : report.strideSweep) {
+                if(point.nanoseconds > (low + high) / 2) {
+                    report.lineBytes = point.bytes;
+                    break;
+                }
+            }
+        }
+    }
+
+    // Size sweep: one element per line, lines in a random cycle so neither the prefetcher nor the access order helps.
+    size_t line = report.lineBytes ? report.lineBytes : (caps.globalMemCachelineSize ? caps.globalMemCachelineSize : 64);
+    const size_t lineElements = std::max<size_t>(1, line / sizeof(cl_uint));
+    for(auto bytes : workingSets(maxWorkingSet)) {
+        size_t lines = std::max<size_t>(2, bytes / line);
+        std::vector<cl_uint> order(lines);
+        std::iota(order.begin(), order.end(), 0);
+        std::shuffle(order.begin() + 1, order.end(), random);
+        for(size_t idx = 0; idx < lines; ++idx) {
+            next[order[idx] * lineElements] = static_cast<cl_uint>(order[(idx + 1) % lines] * lineElements);
+        }
+        uint32_t warmup = static_cast<uint32_t>(std::min<size_t>(lines, 4 * static_cast<size_t>(steps)));
+        report.sizeSweep.push_back({bytes, chaser.measure(next, std::min(maxWorkingSet, lines * line), steps, warmup)});
+    }
+    report.levels = inferLevels(report.sizeSweep);
+
+    clReleaseMemObject(sink);
+    clReleaseMemObject(chain);
+    clReleaseKernel(kernel);
+    clReleaseProgram(program);
+    session.release();
+    return report;
+}
+
+void printCacheReport(const DeviceRecord& record, const CacheProbeReport& report) {
+    const auto& caps = record.caps;
+    std::cout << "Pair latency by stride (two dependent loads per block):" << std::endl;
+    for(const auto& point : report.strideSweep) {
+        std::cout << std::setw(10) << (std::to_string(point.bytes) + " B") << std::fixed << std::setprecision(1) << std::setw(10)
+                  << point.nanoseconds << " ns" << (point.bytes == report.lineBytes ? "  <- line size" : "") << std::defaultfloat << std::endl;
+    }
+
+    std::cout << "Load latency by working set:" << std::endl;
+    for(const auto& point : report.sizeSweep) {
+        bool boundary = std::any_of(report.levels.begin(), report.levels.end(), [&point](const CacheLevel& level) { return level.bytes == point.bytes; });
+        std::cout << std::setw(10) << formatBytes(point.bytes) << std::fixed << std::setprecision(1) << std::setw(10)
+                  << point.nanoseconds << " ns" << (boundary ? "  <- level capacity" : "") << std::defaultfloat << std::endl;
+    }
+
+    std::cout << std::left << std::setw(22) << "" << std::setw(20) << "driver" << "measured" << std::right << std::endl;
+    std::cout << std::left << std::setw(22) << "Cache line" << std::setw(20) << (std::to_string(caps.globalMemCachelineSize) + " B")
+              << (report.lineBytes ? std::to_string(report.lineBytes) + " B" : std::string("no step found")) << std::right << std::endl;
+    size_t level = 1;
+    for(const auto& cache : report.levels) {
+        std::ostringstream measured;
+        measured << std::fixed << std::setprecision(1) << cache.nanoseconds << " ns";
+        if(cache.bytes == 0) {
+            std::cout << std::left << std::setw(22) << "Memory" << std::setw(20) << formatBytes(caps.globalMemSize) << measured.str() << std::right << std::endl;
+            continue;
+        }
+        // The driver reports a single global memory cache, shown next to the outermost measured level.
+        bool outermost = level + 1 == report.levels.size();
+        std::string driver = outermost ? formatBytes(caps.globalMemCacheSize) : "-";
+        std::cout << std::left << std::setw(22) << ("L" + std::to_string(level)) << std::setw(20) << driver
+                  << formatBytes(cache.bytes) + " @ " + measured.str() << std::right << std::endl;
+        ++level;
+    }
+}
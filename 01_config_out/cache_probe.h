@@ -0,0 +1,48 @@
+#ifndef CACHE_PROBE_H
+#define CACHE_PROBE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "device_inventory.h"
+
+struct CacheProbeOptions {
+    // Largest working set of the size sweep, capped by half of CL_DEVICE_MAX_MEM_ALLOC_SIZE.
+    size_t maxWorkingSet = 256u << 20;
+    // Dependent loads per timed launch. The latency is the difference between a launch of 2 x steps and one of steps, which cancels the
+    // launch overhead.
+    uint32_t steps = 1u << 16;
+};
+
+struct LatencyPoint {
+    // Working set in bytes (size sweep) or distance between the two loads of a pair (stride sweep).
+    size_t bytes = 0;
+    double nanoseconds = 0.0;
+};
+
+struct CacheLevel {
+    // Largest working set still served at this level's latency, 0 for main memory.
+    size_t bytes = 0;
+    double nanoseconds = 0.0;
+};
+
+struct CacheProbeReport {
+    std::vector<LatencyPoint> strideSweep;
+    std::vector<LatencyPoint> sizeSweep;
+    // Inferred from the stride sweep, 0 if no step was found.
+    size_t lineBytes = 0;
+    // Inferred from the size sweep, innermost first, main memory last.
+    std::vector<CacheLevel> levels;
+};
+
+// Chase pointers with a single work-item.
+// Stride sweep: random order of 1 KiB blocks over a working set far larger than any cache, two loads per block at distance s. While s is below
+// the line size the second load hits the line the first one brought in; the smallest s at which the pair costs two misses is the line size.
+// Size sweep: a random cyclic permutation of lines over working sets from 1 KiB up; every step in the latency curve is a cache level and
+// the working set just before it the capacity of that level.
+CacheProbeReport measureCacheHierarchy(const DeviceRecord& record, const CacheProbeOptions& options);
+
+// The latency curves and the inferred hierarchy next to CL_DEVICE_GLOBAL_MEM_CACHE_SIZE and CL_DEVICE_GLOBAL_MEM_CACHELINE_SIZE.
+void printCacheReport(const DeviceRecord& record, const CacheProbeReport& report);
+
+#endif //CACHE_PROBE_H
@@ -0,0 +1,135 @@
+#include "capability_cache.h"
+
+#include <chrono>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "binary_archive.h"
+#include "opencl_utils.h"
+
+namespace {
+
+const char kCacheMagic[8] = {'C', 'L', 'C', 'A', 'P', 'S', '\0', '\0'};
+// Bump whenever visitCapabilityFields changes.
+const uint32_t kCacheFormatVersion = 7;
+
+// Every persisted field of the snapshot, in file order. Shared by the writer and the reader so the two can never disagree.
+template <typename Archive, typename Caps>
+void visitFields(Archive& ar, Caps& caps) {
+    visitCapabilityFields([&ar](const char*, auto& field) { ar(field); }, caps);
+}
+
+uint64_t nanosecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+CapabilityCache::CapabilityCache(std::string path) : path_(std::move(path)) {}
+
+bool CapabilityCache::load() {
+    // One read of the whole file, the entries are parsed from memory.
+    std::vector<char> data;
+    if(!readWholeFile(path_, data)) {
+        return false;
+    }
+
+    if(data.size() < sizeof(kCacheMagic) || std::memcmp(data.data(), kCacheMagic, sizeof(kCacheMagic)) != 0) {
+        return false;
+    }
+    BinaryReader reader(data.data() + sizeof(kCacheMagic), data.size() - sizeof(kCacheMagic));
+    uint32_t version = 0;
+    uint64_t count = 0;
+    reader(version);
+    reader(count);
+    if(!reader.ok || version != kCacheFormatVersion) {
+        return false;
+    }
+
+    std::map<std::string, Entry> entries;
+    for(uint64_t idx = 0; idx < count && reader.ok; ++idx) {
+        std::string key;
+        Entry entry;
+        reader(key);
+        reader(entry.queryNanoseconds);
+        visitFields(reader, entry.caps);
+        entries[key] = std::move(entry);
+    }
+    if(!reader.ok) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_ = std::move(entries);
+    dirty_ = false;
+    return true;
+}
+
+bool CapabilityCache::save() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(!dirty_) {
+        return true;
+    }
+
+    BinaryWriter writer;
+    writer.buffer.insert(writer.buffer.end(), kCacheMagic, kCacheMagic + sizeof(kCacheMagic));
+    writer(kCacheFormatVersion);
+    writer(static_cast<uint64_t>(entries_.size()));
+    for(const auto& entry : entries_) {
+        writer(entry.first);
+        writer(entry.second.queryNanoseconds);
+        visitFields(writer, entry.second.caps);
+    }
+
+    return replaceFile(path_, writer.buffer);
+}
+
+DeviceCapabilities CapabilityCache::get(cl_device_id device, CapabilitySource* source, bool refresh) {
+    auto start = std::chrono::steady_clock::now();
+
+    auto platform = getDeviceInfoScalar<cl_platform_id>(device, CL_DEVICE_PLATFORM);
+    auto key = makeKey(getPlatformInfoString(platform, CL_PLATFORM_NAME),
+                       getDeviceInfoString(device, CL_DEVICE_NAME),
+                       getDeviceInfoString(device, CL_DRIVER_VERSION));
+
+    if(!refresh) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if(it != entries_.end()) {
+            if(source) {
+                source->fromCache = true;
+                source->elapsedNanoseconds = nanosecondsSince(start);
+                source->liveQueryNanoseconds = it->second.queryNanoseconds;
+            }
+            return it->second.caps;
+        }
+    }
+
+    // The full query runs unlocked so misses on different devices proceed in parallel.
+    auto queryStart = std::chrono::steady_clock::now();
+    Entry entry;
+    entry.caps = DeviceCapabilities::query(device);
+    entry.queryNanoseconds = nanosecondsSince(queryStart);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_[key] = entry;
+        dirty_ = true;
+    }
+
+    if(source) {
+        source->fromCache = false;
+        source->elapsedNanoseconds = nanosecondsSince(start);
+        source->liveQueryNanoseconds = entry.queryNanoseconds;
+    }
+    return entry.caps;
+}
+
+std::string CapabilityCache::makeKey(const std::string& platformName, const std::string& deviceName, const std::string& driverVersion) {
+    return platformName + '\n' + deviceName + '\n' + driverVersion;
+}
+
+size_t CapabilityCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
@@ -0,0 +1,55 @@
+#ifndef CAPABILITY_CACHE_H
+#define CAPABILITY_CACHE_H
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include <CL/cl.h>
+
+#include "device_capabilities.h"
+
+// How a snapshot handed out by CapabilityCache::get was obtained.
+struct CapabilitySource {
+    bool fromCache = false;
+    // Time spent producing the snapshot in this run (key query + cache lookup, or key query + full query).
+    uint64_t elapsedNanoseconds = 0;
+    // Time the full query took when the entry was populated, i.e. what a cache hit saves.
+    uint64_t liveQueryNanoseconds = 0;
+};
+
+// On-disk binary cache of DeviceCapabilities snapshots.
+// Entries are keyed by platform name, device name and CL_DRIVER_VERSION, so a driver upgrade invalidates the entry of that device only.
+// The whole file is read once by load() and written back once by save(). get() may be called from several threads at once.
+class CapabilityCache {
+public:
+    explicit CapabilityCache(std::string path);
+
+    // Read the cache file. Returns false if the file is missing, truncated or was written by another format version.
+    bool load();
+    // Write all entries back if anything changed since load().
+    bool save() const;
+
+    // Return the cached snapshot of the device, querying the driver (and populating the cache) on a miss or when refresh is set.
+    // Only the three key strings are queried on a hit.
+    DeviceCapabilities get(cl_device_id device, CapabilitySource* source = nullptr, bool refresh = false);
+
+    static std::string makeKey(const std::string& platformName, const std::string& deviceName, const std::string& driverVersion);
+
+    const std::string& path() const { return path_; }
+    size_t size() const;
+
+private:
+    struct Entry {
+        DeviceCapabilities caps;
+        uint64_t queryNanoseconds = 0;
+    };
+
+    std::string path_;
+    mutable std::mutex mutex_;
+    std::map<std::string, Entry> entries_;
+    bool dirty_ = false;
+};
+
+#endif //CAPABILITY_CACHE_H
@@ -0,0 +1,165 @@
+#include "cl_trace.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <unistd.h>
+
+#include "json.h"
+#include "opencl_utils.h"
+
+namespace {
+
+struct Span {
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+    cl_int result;
+};
+
+// Written by its thread only. The mutex is uncontended except while the trace is written.
+struct ThreadBuffer {
+    uint32_t tid = 0;
+    std::mutex mutex;
+    std::vector<Span> spans;
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::chrono::steady_clock::time_point origin;
+    std::string path;
+};
+
+// Never destroyed: the trace is written by an atexit handler, and threads may still record while static objects are destroyed.
+Registry& registry() {
+    static Registry* instance = new Registry;
+    return *instance;
+}
+
+const size_t kInitialSpans = 4096;
+
+// Buffers outlive their threads, so spans of the inventory workers are still there at exit.
+ThreadBuffer& threadBuffer() {
+    thread_local ThreadBuffer* buffer = nullptr;
+    if(!buffer) {
+        auto& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.buffers.emplace_back(new ThreadBuffer);
+        buffer = reg.buffers.back().get();
+        buffer->tid = static_cast<uint32_t>(reg.buffers.size() - 1);
+        buffer->spans.reserve(kInitialSpans);
+    }
+    return *buffer;
+}
+
+void writeTraceAtExit() {
+    std::string error;
+    if(!writeTrace(registry().path, error)) {
+        std::cerr << "Failed to write trace: " << error << std::endl;
+    }
+}
+
+}
+
+namespace cl_trace {
+
+std::atomic<bool> enabled(false);
+
+uint64_t now() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - registry().origin).count());
+}
+
+void record(const char* name, uint64_t start, uint64_t end, cl_int result) {
+    auto& buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.spans.push_back({name, start, end, result});
+}
+
+}
+
+void startTracing(const std::string& path) {
+    if(cl_trace::enabled.load()) {
+        return;
+    }
+    auto& reg = registry();
+    reg.origin = std::chrono::steady_clock::now();
+    reg.path = path;
+    // The starting thread registers first and becomes tid 0.
+    threadBuffer();
+    std::atexit(writeTraceAtExit);
+    cl_trace::enabled.store(true);
+}
+
+bool writeTrace(const std::string& path, std::string& error) {
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    auto pid = static_cast<int64_t>(getpid());
+    size_t count = 0;
+
+    JsonWriter json;
+    json.beginObject();
+    json.key("traceEvents");
+    json.beginArray();
+    for(const auto& buffer : reg.buffers) {
+        json.beginObject();
+        json.key("name");
+        json.value("thread_name");
+        json.key("ph");
+        json.value("M");
+        json.key("pid");
+        json.value(pid);
+        json.key("tid");
+        json.value(buffer->tid);
+        json.key("args");
+        json.beginObject();
+        json.key("name");
+        json.value(buffer->tid == 0 ? std::string("main") : "worker " + std::to_string(buffer->tid));
+        json.endObject();
+        json.endObject();
+
+        std::lock_guard<std::mutex> spansLock(buffer->mutex);
+        for(const auto& span : buffer->spans) {
+            json.beginObject();
+            json.key("name");
+            json.value(span.name);
+            json.key("cat");
+            json.value(span.name[0] == 'c' && span.name[1] == 'l' ? "opencl" : "tool");
+            json.key("ph");
+            json.value("X");
+            // Chrome traces count in microseconds.
+            json.key("ts");
+            json.value(span.start / 1000.0);
+            json.key("dur");
+            json.value((span.end - span.start) / 1000.0);
+            json.key("pid");
+            json.value(pid);
+            json.key("tid");
+            json.value(buffer->tid);
+            if(span.result != kTraceNoResult) {
+                json.key("args");
+                json.beginObject();
+                json.key("result");
+                json.value(getOpenCLErrorString(span.result));
+                json.endObject();
+            }
+            json.endObject();
+        }
+        count += buffer->spans.size();
+    }
+    json.endArray();
+    json.key("displayTimeUnit");
+    json.value("ns");
+    json.endObject();
+
+    if(!writeWholeFile(path, json.str())) {
+        error = "cannot write " + path;
+        return false;
+    }
+    std::cerr << "Trace of " << count << " spans on " << reg.buffers.size() << " threads written to " << path << std::endl;
+    return true;
+}
@@ -0,0 +1,176 @@
+#ifndef CL_TRACE_H
+#define CL_TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include <CL/cl.h>
+
+// Tracing of OpenCL API calls. Every translation unit calling OpenCL sees this header (through opencl_utils.h), which replaces the
+// names of the API functions below with call wrappers: a call costs one relaxed atomic load more while tracing is off, and records a
+// span (name, start, duration, thread, result code) into a buffer owned by the calling thread while it is on.
+// startTracing() switches it on and writes the collected spans as a Chrome trace (chrome://tracing, Perfetto) when the process exits.
+
+// Spans of calls without a result code (clSVMAlloc, clSVMFree, creation calls passing a null errcode_ret).
+const cl_int kTraceNoResult = 1;
+
+namespace cl_trace {
+
+extern std::atomic<bool> enabled;
+
+// Nanoseconds since tracing started.
+uint64_t now();
+void record(const char* name, uint64_t start, uint64_t end, cl_int result);
+
+inline cl_int resultOf(cl_int result) {
+    return result;
+}
+template <typename T>
+cl_int resultOf(const T&) {
+    return kTraceNoResult;
+}
+
+// Creation calls report through their last parameter, errcode_ret.
+inline cl_int errcodeOf() {
+    return kTraceNoResult;
+}
+inline cl_int errcodeOf(cl_int* errcode) {
+    return errcode ? *errcode : kTraceNoResult;
+}
+template <typename T>
+cl_int errcodeOf(const T&) {
+    return kTraceNoResult;
+}
+template <typename First, typename Second, typename... Rest>
+cl_int errcodeOf(const First&, const Second& second, const Rest&... rest) {
+    return errcodeOf(second, rest...);
+}
+
+template <typename Function>
+struct Call;
+
+template <typename R, typename... Params>
+struct Call<R(Params...)> {
+    const char* name;
+    R (*function)(Params...);
+
+    R operator()(Params... params) const {
+        if(!enabled.load(std::memory_order_relaxed)) {
+            return function(params...);
+        }
+        uint64_t start = now();
+        R result = function(params...);
+        cl_int code = resultOf(result);
+        record(name, start, now(), code == kTraceNoResult ? errcodeOf(params...) : code);
+        return result;
+    }
+};
+
+template <typename... Params>
+struct Call<void(Params...)> {
+    const char* name;
+    void (*function)(Params...);
+
+    void operator()(Params... params) const {
+        if(!enabled.load(std::memory_order_relaxed)) {
+            function(params...);
+            return;
+        }
+        uint64_t start = now();
+        function(params...);
+        record(name, start, now(), kTraceNoResult);
+    }
+};
+
+}
+
+// A span for a stretch of the tool's own work (the report output, the cache file), shown next to the API calls it makes.
+class TraceScope {
+public:
+    explicit TraceScope(const char* name) : name_(name), start_(cl_trace::enabled.load(std::memory_order_relaxed) ? cl_trace::now() : 0) {}
+    ~TraceScope() {
+        if(cl_trace::enabled.load(std::memory_order_relaxed)) {
+            cl_trace::record(name_, start_, cl_trace::now(), kTraceNoResult);
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name_;
+    uint64_t start_;
+};
+
+// Start recording and write the trace to path at exit, including exits through checkOpenCLError. Spans of threads still running
+// at that point may be missing their last calls.
+void startTracing(const std::string& path);
+
+// Write the spans recorded so far as Chrome trace JSON. Returns false (with error) if the file cannot be written.
+bool writeTrace(const std::string& path, std::string& error);
+
+// The wrapped functions. A name inside its own replacement is not replaced again, so the wrapper still refers to the real entry point.
+#define CL_TRACED(name) cl_trace::Call<decltype(::name)>{#name, &::name}
+
+#define clBuildProgram CL_TRACED(clBuildProgram)
+#define clCreateBuffer CL_TRACED(clCreateBuffer)
+#define clCreateCommandQueueWithProperties CL_TRACED(clCreateCommandQueueWithProperties)
+#define clCreateContext CL_TRACED(clCreateContext)
+#define clCreateImage CL_TRACED(clCreateImage)
+#define clCreateKernel CL_TRACED(clCreateKernel)
+#define clCreateProgramWithBinary CL_TRACED(clCreateProgramWithBinary)
+#define clCreateProgramWithSource CL_TRACED(clCreateProgramWithSource)
+#define clCreateSamplerWithProperties CL_TRACED(clCreateSamplerWithProperties)
+#define clCreateSubBuffer CL_TRACED(clCreateSubBuffer)
+#define clCreateSubDevices CL_TRACED(clCreateSubDevices)
+#define clCreateUserEvent CL_TRACED(clCreateUserEvent)
+#define clEnqueueBarrierWithWaitList CL_TRACED(clEnqueueBarrierWithWaitList)
+#define clEnqueueCopyBuffer CL_TRACED(clEnqueueCopyBuffer)
+#define clEnqueueFillBuffer CL_TRACED(clEnqueueFillBuffer)
+#define clEnqueueMapBuffer CL_TRACED(clEnqueueMapBuffer)
+#define clEnqueueMarkerWithWaitList CL_TRACED(clEnqueueMarkerWithWaitList)
+#define clEnqueueMigrateMemObjects CL_TRACED(clEnqueueMigrateMemObjects)
+#define clEnqueueNDRangeKernel CL_TRACED(clEnqueueNDRangeKernel)
+#define clEnqueueReadBuffer CL_TRACED(clEnqueueReadBuffer)
+#define clEnqueueReadImage CL_TRACED(clEnqueueReadImage)
+#define clEnqueueSVMMap CL_TRACED(clEnqueueSVMMap)
+#define clEnqueueSVMUnmap CL_TRACED(clEnqueueSVMUnmap)
+#define clEnqueueUnmapMemObject CL_TRACED(clEnqueueUnmapMemObject)
+#define clEnqueueWriteBuffer CL_TRACED(clEnqueueWriteBuffer)
+#define clEnqueueWriteImage CL_TRACED(clEnqueueWriteImage)
+#define clFinish CL_TRACED(clFinish)
+#define clFlush CL_TRACED(clFlush)
+#define clGetContextInfo CL_TRACED(clGetContextInfo)
+#define clGetDeviceIDs CL_TRACED(clGetDeviceIDs)
+#define clGetDeviceInfo CL_TRACED(clGetDeviceInfo)
+#define clGetEventInfo CL_TRACED(clGetEventInfo)
+#define clGetEventProfilingInfo CL_TRACED(clGetEventProfilingInfo)
+#define clGetKernelInfo CL_TRACED(clGetKernelInfo)
+#define clGetKernelWorkGroupInfo CL_TRACED(clGetKernelWorkGroupInfo)
+#define clGetMemObjectInfo CL_TRACED(clGetMemObjectInfo)
+#define clGetPlatformIDs CL_TRACED(clGetPlatformIDs)
+#define clGetPlatformInfo CL_TRACED(clGetPlatformInfo)
+#define clGetProgramBuildInfo CL_TRACED(clGetProgramBuildInfo)
+#define clGetProgramInfo CL_TRACED(clGetProgramInfo)
+#define clGetSupportedImageFormats CL_TRACED(clGetSupportedImageFormats)
+#define clReleaseCommandQueue CL_TRACED(clReleaseCommandQueue)
+#define clReleaseContext CL_TRACED(clReleaseContext)
+#define clReleaseDevice CL_TRACED(clReleaseDevice)
+#define clReleaseEvent CL_TRACED(clReleaseEvent)
+#define clReleaseKernel CL_TRACED(clReleaseKernel)
+#define clReleaseMemObject CL_TRACED(clReleaseMemObject)
+#define clReleaseProgram CL_TRACED(clReleaseProgram)
+#define clReleaseSampler CL_TRACED(clReleaseSampler)
+#define clRetainEvent CL_TRACED(clRetainEvent)
+#define clRetainMemObject CL_TRACED(clRetainMemObject)
+#define clSVMAlloc CL_TRACED(clSVMAlloc)
+#define clSVMFree CL_TRACED(clSVMFree)
+#define clSetEventCallback CL_TRACED(clSetEventCallback)
+#define clSetKernelArg CL_TRACED(clSetKernelArg)
+#define clSetKernelArgSVMPointer CL_TRACED(clSetKernelArgSVMPointer)
+#define clSetKernelExecInfo CL_TRACED(clSetKernelExecInfo)
+#define clSetUserEventStatus CL_TRACED(clSetUserEventStatus)
+#define clWaitForEvents CL_TRACED(clWaitForEvents)
+
+#endif //CL_TRACE_H
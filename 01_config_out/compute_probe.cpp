@@ -0,0 +1,165 @@
+#include "compute_probe.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <map>
+
+#include "opencl_utils.h"
+
+namespace {
+
+const int kFmaIterations = 512;
+// Independent chains per work-item so the mad latency is hidden behind the other chains.
+const int kFmaChains = 4;
+const cl_uint kVectorWidths[] = {1, 2, 4, 8, 16};
+
+cl_uint nativeWidthOf(const DeviceCapabilities& caps, const std::string& type) {
+    if(type == "double") {
+        return caps.nativeVectorWidthDouble;
+    }
+    if(type == "half") {
+        return caps.nativeVectorWidthHalf;
+    }
+    return caps.nativeVectorWidthFloat;
+}
+
+}
+
+std::vector<ComputeSample> measureCompute(const DeviceRecord& record, int repetitions) {
+    std::vector<ComputeSample> samples;
+    const auto& caps = record.caps;
+
+    std::vector<std::string> types = {"float"};
+    if(caps.doubleFpConfig != 0) {
+        types.push_back("double");
+    }
+    if(caps.hasExtension("cl_khr_fp16")) {
+        types.push_back("half");
+    }
+
+    auto session = DeviceSession::create(record.device);
+    cl_int err;
+
+    // The output buffer fits the widest vector of the widest type.
+    size_t items = fmaChainItems(caps);
+    cl_mem out = clCreateBuffer(session.context, CL_MEM_WRITE_ONLY, items * 16 * sizeof(double), nullptr, &err);
+    checkOpenCLError(err);
+
+    for(const auto& type : types) {
+        cl_program program = buildFmaChainProgram(session, type);
+        double estimate = static_cast<double>(caps.maxComputeUnits) * caps.maxClockFrequency * 1e6 * 2 * nativeWidthOf(caps, type) / 1e9;
+
+        for(auto width : kVectorWidths) {
+            cl_kernel kernel = createFmaChainKernel(program, width, out);
+            std::vector<double> gflops;
+            // One untimed warm-up launch which also absorbs any lazy compilation.
+            for(int rep = 0; rep <= repetitions; ++rep) {
+                double launch = launchFmaChainGflops(session, kernel, items, width);
+                if(rep > 0 && launch > 0) {
+                    gflops.push_back(launch);
+                }
+            }
+
+            ComputeSample sample;
+            sample.type = type;
+            sample.vectorWidth = width;
+            sample.gflops = summarize(gflops);
+            sample.estimateGflops = estimate;
+            samples.push_back(sample);
+
+            clReleaseKernel(kernel);
+        }
+        clReleaseProgram(program);
+    }
+
+    clReleaseMemObject(out);
+    session.release();
+    return samples;
+}
+
+// One kernel per vector width. The multiply factor is slightly below one and the addend small,
+// so the chains converge instead of overflowing in half precision.
+std::string fmaChainSource(const std::string& type) {
+    std::string source;
+    if(type == "double") {
+        source += "#pragma OPENCL EXTENSION cl_khr_fp64 : enable\n";
+    }
+    if(type == "half") {
+        source += "#pragma OPENCL EXTENSION cl_khr_fp16 : enable\n";
+    }
+    for(auto width : kVectorWidths) {
+        auto vtype = type + (width > 1 ? std::to_string(width) : "");
+        auto w = std::to_string(width);
+        source += "__kernel void fma_chain_" + w + "(__global " + vtype + "* out, float a, float b) {\n"
+                  "    " + vtype + " va = (" + vtype + ")((" + type + ")a);\n"
+                  "    " + vtype + " vb = (" + vtype + ")((" + type + ")b);\n"
+                  "    " + vtype + " x0 = (" + vtype + ")((" + type + ")get_local_id(0));\n"
+                  "    " + vtype + " x1 = x0 + va;\n"
+                  "    " + vtype + " x2 = x1 + va;\n"
+                  "    " + vtype + " x3 = x2 + va;\n"
+                  "    for(int i = 0; i < ITERATIONS; ++i) {\n"
+                  "        x0 = mad(x0, va, vb); x1 = mad(x1, va, vb); x2 = mad(x2, va, vb); x3 = mad(x3, va, vb);\n"
+                  "    }\n"
+                  "    out[get_global_id(0)] = x0 + x1 + x2 + x3;\n"
+                  "}\n";
+    }
+    return source;
+}
+
+cl_program buildFmaChainProgram(const DeviceSession& session, const std::string& type, const std::string& extraOptions) {
+    auto options = "-DITERATIONS=" + std::to_string(kFmaIterations);
+    if(!extraOptions.empty()) {
+        options += " " + extraOptions;
+    }
+    return buildProgram(session.context, session.device, fmaChainSource(type), options);
+}
+
+cl_kernel createFmaChainKernel(cl_program program, cl_uint width, cl_mem out) {
+    auto name = "fma_chain_" + std::to_string(width);
+    cl_kernel kernel = createKernel(program, name.c_str());
+    float a = 0.999f, b = 0.001f;
+    checkOpenCLError( clSetKernelArg(kernel, 0, sizeof(cl_mem), &out) );
+    checkOpenCLError( clSetKernelArg(kernel, 1, sizeof(float), &a) );
+    checkOpenCLError( clSetKernelArg(kernel, 2, sizeof(float), &b) );
+    return kernel;
+}
+
+size_t fmaChainItems(const DeviceCapabilities& caps) {
+    return std::min<size_t>(std::max<size_t>(1, caps.maxComputeUnits) * std::max<size_t>(1, caps.maxWorkGroupSize) * 8, 1u << 20);
+}
+
+double launchFmaChainGflops(const DeviceSession& session, cl_kernel kernel, size_t items, cl_uint width) {
+    double flops = static_cast<double>(items) * kFmaIterations * kFmaChains * width * 2;
+    cl_event event;
+    checkOpenCLError( clEnqueueNDRangeKernel(session.queue, kernel, 1, nullptr, &items, nullptr, 0, nullptr, &event) );
+    checkOpenCLError( clWaitForEvents(1, &event) );
+    auto nanoseconds = eventElapsedNanoseconds(event);
+    clReleaseEvent(event);
+    return nanoseconds > 0 ? flops / nanoseconds : 0.0;
+}
+
+void printComputeReport(const std::vector<ComputeSample>& samples) {
+    std::cout << std::left << std::setw(8) << "Type" << std::right << std::setw(6) << "Width"
+              << std::setw(12) << "min GFLOPS" << std::setw(12) << "median" << std::setw(12) << "max"
+              << std::setw(12) << "estimate" << std::setw(10) << "max/est" << std::endl;
+
+    std::map<std::string, const ComputeSample*> best;
+    for(const auto& sample : samples) {
+        std::cout << std::left << std::setw(8) << sample.type << std::right << std::setw(6) << sample.vectorWidth
+                  << std::fixed << std::setprecision(1)
+                  << std::setw(12) << sample.gflops.min << std::setw(12) << sample.gflops.median << std::setw(12) << sample.gflops.max
+                  << std::setw(12) << sample.estimateGflops
+                  << std::setprecision(2) << std::setw(10) << (sample.estimateGflops > 0 ? sample.gflops.max / sample.estimateGflops : 0.0)
+                  << std::defaultfloat << std::endl;
+
+        auto& current = best[sample.type];
+        if(!current || sample.gflops.median > current->gflops.median) {
+            current = &sample;
+        }
+    }
+    for(const auto& entry : best) {
+        std::cout << "Best " << entry.first << " vector width: " << entry.second->vectorWidth
+                  << " (" << std::fixed << std::setprecision(1) << entry.second->gflops.median << " GFLOPS median)" << std::defaultfloat << std::endl;
+    }
+}
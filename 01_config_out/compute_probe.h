@@ -0,0 +1,44 @@
+#ifndef COMPUTE_PROBE_H
+#define COMPUTE_PROBE_H
+
+#include <string>
+#include <vector>
+
+#include "device_inventory.h"
+#include "device_session.h"
+#include "statistics.h"
+
+// Achieved FMA throughput of one precision at one vector width.
+struct ComputeSample {
+    // "float", "double" or "half".
+    std::string type;
+    cl_uint vectorWidth = 1;
+    Summary gflops;
+    // CL_DEVICE_MAX_COMPUTE_UNITS x CL_DEVICE_MAX_CLOCK_FREQUENCY x 2 flops x CL_DEVICE_NATIVE_VECTOR_WIDTH_<type>.
+    // The driver does not report how many lanes a compute unit has, so this is one native vector FMA per compute unit per clock:
+    // a floor for CPUs, far below the peak of GPUs whose compute units issue many lanes per clock.
+    double estimateGflops = 0.0;
+};
+
+// Run chains of dependent mad() for float, for double only when CL_DEVICE_DOUBLE_FP_CONFIG is non-zero and for half only when
+// cl_khr_fp16 is listed in CL_DEVICE_EXTENSIONS, at vector widths 1, 2, 4, 8 and 16.
+std::vector<ComputeSample> measureCompute(const DeviceRecord& record, int repetitions);
+
+// OpenCL C source of the fma_chain_<width> kernels for one precision, needs -DITERATIONS=<n>.
+std::string fmaChainSource(const std::string& type);
+
+// fmaChainSource(type) built with the probe's iteration count, extraOptions appended.
+cl_program buildFmaChainProgram(const DeviceSession& session, const std::string& type, const std::string& extraOptions = "");
+
+// fma_chain_<width> of program writing to out, with the probe's converging factors as arguments.
+cl_kernel createFmaChainKernel(cl_program program, cl_uint width, cl_mem out);
+
+// Work-items per launch, enough to fill every compute unit several times over. out needs items x width elements of the type.
+size_t fmaChainItems(const DeviceCapabilities& caps);
+
+// One launch of a createFmaChainKernel kernel over items work-items, GFLOPS from its profiling event, 0 if the driver reported no time.
+double launchFmaChainGflops(const DeviceSession& session, cl_kernel kernel, size_t items, cl_uint width);
+
+void printComputeReport(const std::vector<ComputeSample>& samples);
+
+#endif //COMPUTE_PROBE_H
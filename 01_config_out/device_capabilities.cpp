@@ -0,0 +1,265 @@
+#include "device_capabilities.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "device_info_traits.h"
+#include "opencl_utils.h"
+
+DeviceCapabilities DeviceCapabilities::query(cl_device_id device) {
+    DeviceCapabilities caps;
+
+    auto platform = queryDeviceInfo<CL_DEVICE_PLATFORM>(device);
+    caps.platformName = getPlatformInfoString(platform, CL_PLATFORM_NAME);
+
+    caps.type = queryDeviceInfo<CL_DEVICE_TYPE>(device);
+    caps.vendor = queryDeviceInfo<CL_DEVICE_VENDOR>(device);
+    caps.vendorId = queryDeviceInfo<CL_DEVICE_VENDOR_ID>(device);
+    caps.name = queryDeviceInfo<CL_DEVICE_NAME>(device);
+    caps.driverVersion = queryDeviceInfo<CL_DRIVER_VERSION>(device);
+    caps.version = queryDeviceInfo<CL_DEVICE_VERSION>(device);
+    caps.profile = queryDeviceInfo<CL_DEVICE_PROFILE>(device);
+    caps.openclCVersion = queryDeviceInfo<CL_DEVICE_OPENCL_C_VERSION>(device);
+    caps.extensions = queryDeviceInfo<CL_DEVICE_EXTENSIONS>(device);
+
+    caps.available = queryDeviceInfo<CL_DEVICE_AVAILABLE>(device);
+    caps.addressBits = queryDeviceInfo<CL_DEVICE_ADDRESS_BITS>(device);
+    caps.profilingTimerResolution = queryDeviceInfo<CL_DEVICE_PROFILING_TIMER_RESOLUTION>(device);
+    caps.referenceCount = queryDeviceInfo<CL_DEVICE_REFERENCE_COUNT>(device);
+    caps.endianLittle = queryDeviceInfo<CL_DEVICE_ENDIAN_LITTLE>(device);
+    caps.errorCorrectionSupport = queryDeviceInfo<CL_DEVICE_ERROR_CORRECTION_SUPPORT>(device);
+    // Deprecated by OpenCL 2.0 but still answered, hence optional in the trait table.
+    caps.hostUnifiedMemory = queryDeviceInfo<CL_DEVICE_HOST_UNIFIED_MEMORY>(device);
+
+    caps.compilerAvailable = queryDeviceInfo<CL_DEVICE_COMPILER_AVAILABLE>(device);
+    caps.linkerAvailable = queryDeviceInfo<CL_DEVICE_LINKER_AVAILABLE>(device);
+    caps.executionCapabilities = queryDeviceInfo<CL_DEVICE_EXECUTION_CAPABILITIES>(device);
+    caps.builtInKernels = queryDeviceInfo<CL_DEVICE_BUILT_IN_KERNELS>(device);
+
+    caps.singleFpConfig = queryDeviceInfo<CL_DEVICE_SINGLE_FP_CONFIG>(device);
+    caps.doubleFpConfig = queryDeviceInfo<CL_DEVICE_DOUBLE_FP_CONFIG>(device);
+    caps.nativeVectorWidthFloat = queryDeviceInfo<CL_DEVICE_NATIVE_VECTOR_WIDTH_FLOAT>(device);
+    caps.nativeVectorWidthDouble = queryDeviceInfo<CL_DEVICE_NATIVE_VECTOR_WIDTH_DOUBLE>(device);
+    caps.nativeVectorWidthHalf = queryDeviceInfo<CL_DEVICE_NATIVE_VECTOR_WIDTH_HALF>(device);
+    caps.preferredVectorWidthFloat = queryDeviceInfo<CL_DEVICE_PREFERRED_VECTOR_WIDTH_FLOAT>(device);
+    caps.preferredVectorWidthDouble = queryDeviceInfo<CL_DEVICE_PREFERRED_VECTOR_WIDTH_DOUBLE>(device);
+    caps.preferredVectorWidthHalf = queryDeviceInfo<CL_DEVICE_PREFERRED_VECTOR_WIDTH_HALF>(device);
+
+    caps.maxClockFrequency = queryDeviceInfo<CL_DEVICE_MAX_CLOCK_FREQUENCY>(device);
+    caps.maxComputeUnits = queryDeviceInfo<CL_DEVICE_MAX_COMPUTE_UNITS>(device);
+    caps.maxWorkItemDimensions = queryDeviceInfo<CL_DEVICE_MAX_WORK_ITEM_DIMENSIONS>(device);
+    caps.maxWorkGroupSize = queryDeviceInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>(device);
+    caps.maxWorkItemSizes = queryDeviceInfo<CL_DEVICE_MAX_WORK_ITEM_SIZES>(device);
+    caps.maxNumSubGroups = queryDeviceInfo<CL_DEVICE_MAX_NUM_SUB_GROUPS>(device);
+
+    caps.memBaseAddrAlign = queryDeviceInfo<CL_DEVICE_MEM_BASE_ADDR_ALIGN>(device);
+    caps.globalMemSize = queryDeviceInfo<CL_DEVICE_GLOBAL_MEM_SIZE>(device);
+    caps.maxMemAllocSize = queryDeviceInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>(device);
+    caps.maxGlobalVariableSize = queryDeviceInfo<CL_DEVICE_MAX_GLOBAL_VARIABLE_SIZE>(device);
+    caps.globalVariablePreferredTotalSize = queryDeviceInfo<CL_DEVICE_GLOBAL_VARIABLE_PREFERRED_TOTAL_SIZE>(device);
+
+    caps.globalMemCacheType = queryDeviceInfo<CL_DEVICE_GLOBAL_MEM_CACHE_TYPE>(device);
+    caps.globalMemCacheSize = queryDeviceInfo<CL_DEVICE_GLOBAL_MEM_CACHE_SIZE>(device);
+    caps.globalMemCachelineSize = queryDeviceInfo<CL_DEVICE_GLOBAL_MEM_CACHELINE_SIZE>(device);
+
+    caps.localMemType = queryDeviceInfo<CL_DEVICE_LOCAL_MEM_TYPE>(device);
+    caps.localMemSize = queryDeviceInfo<CL_DEVICE_LOCAL_MEM_SIZE>(device);
+
+    caps.maxConstantBufferSize = queryDeviceInfo<CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE>(device);
+    caps.maxConstantArgs = queryDeviceInfo<CL_DEVICE_MAX_CONSTANT_ARGS>(device);
+
+    caps.maxParameterSize = queryDeviceInfo<CL_DEVICE_MAX_PARAMETER_SIZE>(device);
+    caps.printfBufferSize = queryDeviceInfo<CL_DEVICE_PRINTF_BUFFER_SIZE>(device);
+
+    caps.maxOnDeviceQueues = queryDeviceInfo<CL_DEVICE_MAX_ON_DEVICE_QUEUES>(device);
+    caps.maxOnDeviceEvents = queryDeviceInfo<CL_DEVICE_MAX_ON_DEVICE_EVENTS>(device);
+    caps.queueOnDeviceMaxSize = queryDeviceInfo<CL_DEVICE_QUEUE_ON_DEVICE_MAX_SIZE>(device);
+    caps.queueOnDevicePreferredSize = queryDeviceInfo<CL_DEVICE_QUEUE_ON_DEVICE_PREFERRED_SIZE>(device);
+    caps.queueOnDeviceProperties = queryDeviceInfo<CL_DEVICE_QUEUE_ON_DEVICE_PROPERTIES>(device);
+    caps.queueOnHostProperties = queryDeviceInfo<CL_DEVICE_QUEUE_ON_HOST_PROPERTIES>(device);
+
+    caps.svmCapabilities = queryDeviceInfo<CL_DEVICE_SVM_CAPABILITIES>(device);
+
+    caps.imageSupport = queryDeviceInfo<CL_DEVICE_IMAGE_SUPPORT>(device);
+    caps.image2dMaxWidth = queryDeviceInfo<CL_DEVICE_IMAGE2D_MAX_WIDTH>(device);
+    caps.image2dMaxHeight = queryDeviceInfo<CL_DEVICE_IMAGE2D_MAX_HEIGHT>(device);
+
+    caps.partitionMaxSubDevices = queryDeviceInfo<CL_DEVICE_PARTITION_MAX_SUB_DEVICES>(device);
+    caps.partitionProperties = queryDeviceInfo<CL_DEVICE_PARTITION_PROPERTIES>(device);
+    caps.partitionProperties.erase(std::remove(caps.partitionProperties.begin(), caps.partitionProperties.end(), 0), caps.partitionProperties.end());
+    caps.partitionAffinityDomain = queryDeviceInfo<CL_DEVICE_PARTITION_AFFINITY_DOMAIN>(device);
+
+    return caps;
+}
+
+bool DeviceCapabilities::hasExtension(const std::string& extension) const {
+    for(size_t pos = extensions.find(extension); pos != std::string::npos; pos = extensions.find(extension, pos + 1)) {
+        bool startsToken = pos == 0 || extensions[pos - 1] == ' ';
+        bool endsToken = pos + extension.size() == extensions.size() || extensions[pos + extension.size()] == ' ';
+        if(startsToken && endsToken) {
+            return true;
+        }
+    }
+    return false;
+}
+
+namespace {
+
+const char* yesNo(cl_bool value) {
+    return value ? "Yes" : "No";
+}
+
+void printFpConfig(std::ostream& os, cl_device_fp_config config, std::string str) {
+    appendBitfield<cl_device_fp_config>(config, CL_FP_DENORM, "CL_FP_DENORM", str);
+    appendBitfield<cl_device_fp_config>(config, CL_FP_INF_NAN, "CL_FP_INF_NAN", str);
+    appendBitfield<cl_device_fp_config>(config, CL_FP_ROUND_TO_NEAREST, "CL_FP_ROUND_TO_NEAREST", str);
+    appendBitfield<cl_device_fp_config>(config, CL_FP_ROUND_TO_ZERO, "CL_FP_ROUND_TO_ZERO", str);
+    appendBitfield<cl_device_fp_config>(config, CL_FP_ROUND_TO_INF, "CL_FP_ROUND_TO_INF", str);
+    appendBitfield<cl_device_fp_config>(config, CL_FP_FMA, "CL_FP_FMA", str);
+    appendBitfield<cl_device_fp_config>(config, CL_FP_CORRECTLY_ROUNDED_DIVIDE_SQRT, "CL_FP_CORRECTLY_ROUNDED_DIVIDE_SQRT", str);
+    appendBitfield<cl_device_fp_config>(config, CL_FP_SOFT_FLOAT, "CL_FP_SOFT_FLOAT", str);
+
+    os << str << std::endl;
+}
+
+void printQueueProperties(std::ostream& os, cl_command_queue_properties properties, std::string str) {
+    appendBitfield<cl_command_queue_properties>(properties, CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE, "CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE", str);
+    appendBitfield<cl_command_queue_properties>(properties, CL_QUEUE_PROFILING_ENABLE, "CL_QUEUE_PROFILING_ENABLE", str);
+
+    os << str << std::endl;
+}
+
+}
+
+void DeviceCapabilities::print(std::ostream& os) const {
+    std::string str = "Device Type";
+    appendBitfield<cl_device_type>(type, CL_DEVICE_TYPE_CPU, "CL_DEVICE_TYPE_CPU", str);
+    appendBitfield<cl_device_type>(type, CL_DEVICE_TYPE_GPU, "CL_DEVICE_TYPE_GPU", str);
+    appendBitfield<cl_device_type>(type, CL_DEVICE_TYPE_ACCELERATOR, "CL_DEVICE_TYPE_ACCELERATOR", str);
+    appendBitfield<cl_device_type>(type, CL_DEVICE_TYPE_DEFAULT, "CL_DEVICE_TYPE_DEFAULT", str);
+    os << str << std::endl;
+    os << "Device Vendor" << " : " << vendor << std::endl;
+    os << "Device Vendor ID" << " : " << vendorId << std::endl;
+    os << "Device Name" << " : " << name << std::endl;
+    os << "Device Driver Version" << " : " << driverVersion << std::endl;
+    os << "Device Supported OpenCL Version" << " : " << version << std::endl;
+    os << "Device Supported OpenCL Profile" << " : " << profile << std::endl;
+    os << "Device Compiler Supported OpenCL C Version" << " : " << openclCVersion << std::endl;
+    os << "Device Supported OpenCL Extensions" << " : " << extensions << std::endl;
+    os << "...\n";
+
+    os << "Device Associated OpenCL Platform Name" << " : " << platformName << std::endl;
+    os << "Device Command Queues Supported" << " : " << yesNo(available) << std::endl;
+    os << "Device Address Space Bits" << " : " << addressBits << "-bit device address space" << std::endl;
+    os << "Device Timer Resolution" << " : " << profilingTimerResolution << " nanoseconds" << std::endl;
+    os << "Device Reference Count" << " : " << referenceCount << std::endl;
+    os << "Device Endian Little" << " : " << yesNo(endianLittle) << std::endl;
+    os << "Device Error Correction Support" << " : " << yesNo(errorCorrectionSupport) << std::endl;
+    os << "Device Host Unified Memory" << " : " << yesNo(hostUnifiedMemory) << std::endl;
+    os << "...\n";
+
+    os << "Device Program Compiler Exist" << " : " << yesNo(compilerAvailable) << std::endl;
+    os << "Device Program Linker Exist" << " : " << yesNo(linkerAvailable) << std::endl;
+    str = "Device Kernel Type Supported";
+    appendBitfield<cl_device_exec_capabilities>(executionCapabilities, CL_EXEC_KERNEL, "CL_EXEC_KERNEL", str);
+    appendBitfield<cl_device_exec_capabilities>(executionCapabilities, CL_EXEC_NATIVE_KERNEL, "CL_EXEC_NATIVE_KERNEL", str);
+    os << str << std::endl;
+    os << "Device Supported Built-in Kernels" << " : " << (builtInKernels.empty() ? "None" : builtInKernels) << std::endl;
+    os << "...\n";
+
+    printFpConfig(os, singleFpConfig, "Device Single FP Capabilities");
+    printFpConfig(os, doubleFpConfig, "Device Double FP Capabilities");
+    os << "Device Native Vector Width float/double/half" << " : " << nativeVectorWidthFloat << " / " << nativeVectorWidthDouble << " / " << nativeVectorWidthHalf << std::endl;
+    os << "Device Preferred Vector Width float/double/half" << " : " << preferredVectorWidthFloat << " / " << preferredVectorWidthDouble << " / " << preferredVectorWidthHalf << std::endl;
+    os << "...\n";
+
+    os << "Device Max Clock Frequency" << " : " << maxClockFrequency << " Mhz" << std::endl;
+    os << "Device Compute Units Count" << " : " << maxComputeUnits << std::endl;
+    os << "Device Work-Item Global/Local ID Dimension Rank" << " : " << maxWorkItemDimensions << std::endl;
+    os << "Device Work-Item Max Number in Work-Group" << " : " << maxWorkGroupSize << std::endl;
+    os << "Device Work-Item Max Number in Work-Group in Each Dimension" << " : ";
+    for(size_t idx = 0; idx < maxWorkItemSizes.size(); ++idx) {
+        os << (idx == 0 ? "( " : ", ") << maxWorkItemSizes[idx];
+    }
+    os << " )" << std::endl;
+    os << "Device Max Sub-Groups Number in Work-Group" << " : " << maxNumSubGroups << std::endl;
+    os << "...\n";
+
+    os << "Device Sub-Buffer Offset Required Alignment" << " : " << memBaseAddrAlign << " bits" << std::endl;
+    os << "Device Global Memory Size" << " : " << globalMemSize << " bytes" << " | " << std::round(static_cast<double>(globalMemSize)/1024/1024) << " megabytes" << " | "
+       << std::round(static_cast<double>(globalMemSize)/1024/1024/1024) << " gigabytes" << std::endl;
+    os << "Device Max Global Memory Allocation" << " : " << maxMemAllocSize << " bytes" << " | " << std::round(static_cast<double>(maxMemAllocSize)/1024/1024) << " megabytes" << " | "
+       << std::round(static_cast<double>(maxMemAllocSize)/1024/1024/1024) << " gigabytes" << std::endl;
+    os << "Device Single Global Variable Max Storage" << " : " << maxGlobalVariableSize << " bytes" << " | " << std::round(static_cast<double>(maxGlobalVariableSize)/1024/1024) << " megabytes" << " | "
+       << std::round(static_cast<double>(maxGlobalVariableSize)/1024/1024/1024) << " gigabytes" << std::endl;
+    os << "Device All Program Variables Maximum Preferred Global Memory Total Size" << " : " << globalVariablePreferredTotalSize << " bytes" << " | "
+       << std::round(static_cast<double>(globalVariablePreferredTotalSize)/1024) << " kilobytes" << std::endl;
+    os << "...\n";
+
+    str = "Device Global L2-Cache Type";
+    appendBitfield<cl_device_mem_cache_type>(globalMemCacheType, CL_READ_ONLY_CACHE, "CL_READ_ONLY_CACHE", str);
+    appendBitfield<cl_device_mem_cache_type>(globalMemCacheType, CL_READ_WRITE_CACHE, "CL_READ_WRITE_CACHE", str);
+    os << (globalMemCacheType == CL_NONE ? str + " : CL_NONE" : str) << std::endl;
+    os << "Device Global L2-Cache Size" << " : " << globalMemCacheSize << " bytes" << " | " << static_cast<float>(globalMemCacheSize)/1024 << " kilobytes"
+       << " | " << static_cast<float>(globalMemCacheSize)/1024/1024 << " megabytes" << std::endl;
+    os << "Device Global L2-Cache-Line Size" << " : " << globalMemCachelineSize << " bytes" << std::endl;
+    os << "...\n";
+
+    str = "Device Local Memory Type";
+    appendBitfield<cl_device_local_mem_type>(localMemType, CL_LOCAL, "CL_LOCAL", str);
+    appendBitfield<cl_device_local_mem_type>(localMemType, CL_GLOBAL, "CL_GLOBAL", str);
+    os << (localMemType == CL_NONE ? str + " : CL_NONE" : str) << std::endl;
+    os << "Device Local Memory Size" << " : " << localMemSize << " bytes" << " | " << static_cast<float>(localMemSize)/1024 << " kilobytes" << std::endl;
+    os << "...\n";
+
+    os << "Device Single Constant Buffer Max Allocation" << " : " << maxConstantBufferSize << " bytes" << " | " << std::round(static_cast<double>(maxConstantBufferSize)/1024) << " kilobytes" << std::endl;
+    os << "Device Constant Arguments Max Supported Count" << " : " << maxConstantArgs << std::endl;
+    os << "...\n";
+
+    os << "Device Single Kernel Parameters Max Total Memory Size" << " : " << maxParameterSize << " bytes" << " | " << std::round(static_cast<double>(maxParameterSize)/1024) << " kilobytes" << std::endl;
+    os << "Device Kernel Internal Printf Buffer Size" << " : " << printfBufferSize << " bytes" << " | " << std::round(static_cast<double>(printfBufferSize)/1024/1024) << " megabytes" << std::endl;
+    os << "...\n";
+
+    // What we normally use is the host command queue. Nvidia seems not support device command queue.
+    os << "Device Queue Max Count per OpenCL Context" << " : " << maxOnDeviceQueues << std::endl;
+    os << "Device Queue Max Event Count" << " : " << maxOnDeviceEvents << std::endl;
+    os << "Device Queue Max Size" << " : " << queueOnDeviceMaxSize << " bytes" << " | " << static_cast<float>(queueOnDeviceMaxSize)/1024 << " kilobytes" << std::endl;
+    os << "Device Queue Preferred Size" << " : " << queueOnDevicePreferredSize << " bytes" << " | " << static_cast<float>(queueOnDevicePreferredSize)/1024 << " kilobytes" << std::endl;
+    printQueueProperties(os, queueOnDeviceProperties, "Device Queue Properties");
+    printQueueProperties(os, queueOnHostProperties, "Host Command Queue Properties");
+    os << "...\n";
+
+    str = "Device Shared Virtual Memory Capabilities";
+    appendBitfield<cl_device_svm_capabilities>(svmCapabilities, CL_DEVICE_SVM_COARSE_GRAIN_BUFFER, "CL_DEVICE_SVM_COARSE_GRAIN_BUFFER", str);
+    appendBitfield<cl_device_svm_capabilities>(svmCapabilities, CL_DEVICE_SVM_FINE_GRAIN_BUFFER, "CL_DEVICE_SVM_FINE_GRAIN_BUFFER", str);
+    appendBitfield<cl_device_svm_capabilities>(svmCapabilities, CL_DEVICE_SVM_FINE_GRAIN_SYSTEM, "CL_DEVICE_SVM_FINE_GRAIN_SYSTEM", str);
+    appendBitfield<cl_device_svm_capabilities>(svmCapabilities, CL_DEVICE_SVM_ATOMICS, "CL_DEVICE_SVM_ATOMICS", str);
+    os << str << std::endl;
+    os << "...\n";
+
+    os << "Device Image Memory Object Support" << " : " << yesNo(imageSupport) << std::endl;
+    os << "Device Image2D Max Size" << " : " << image2dMaxWidth << " x " << image2dMaxHeight << " pixels" << std::endl;
+    os << "...\n";
+
+    os << "Device Partition Max Sub-Devices" << " : " << partitionMaxSubDevices << std::endl;
+    str = "Device Partition Types";
+    if(partitionProperties.empty()) {
+        str += " : None";
+    }
+    // The properties are enumerants, not bits.
+    for(auto property : partitionProperties) {
+        str += " : ";
+        str += property == CL_DEVICE_PARTITION_EQUALLY ? "CL_DEVICE_PARTITION_EQUALLY"
+             : property == CL_DEVICE_PARTITION_BY_COUNTS ? "CL_DEVICE_PARTITION_BY_COUNTS"
+             : property == CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN ? "CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN" : "unknown";
+    }
+    os << str << std::endl;
+    str = "Device Partition Affinity Domains";
+    appendBitfield<cl_device_affinity_domain>(partitionAffinityDomain, CL_DEVICE_AFFINITY_DOMAIN_NUMA, "CL_DEVICE_AFFINITY_DOMAIN_NUMA", str);
+    appendBitfield<cl_device_affinity_domain>(partitionAffinityDomain, CL_DEVICE_AFFINITY_DOMAIN_L4_CACHE, "CL_DEVICE_AFFINITY_DOMAIN_L4_CACHE", str);
+    appendBitfield<cl_device_affinity_domain>(partitionAffinityDomain, CL_DEVICE_AFFINITY_DOMAIN_L3_CACHE, "CL_DEVICE_AFFINITY_DOMAIN_L3_CACHE", str);
+    appendBitfield<cl_device_affinity_domain>(partitionAffinityDomain, CL_DEVICE_AFFINITY_DOMAIN_L2_CACHE, "CL_DEVICE_AFFINITY_DOMAIN_L2_CACHE", str);
+    appendBitfield<cl_device_affinity_domain>(partitionAffinityDomain, CL_DEVICE_AFFINITY_DOMAIN_L1_CACHE, "CL_DEVICE_AFFINITY_DOMAIN_L1_CACHE", str);
+    appendBitfield<cl_device_affinity_domain>(partitionAffinityDomain, CL_DEVICE_AFFINITY_DOMAIN_NEXT_PARTITIONABLE, "CL_DEVICE_AFFINITY_DOMAIN_NEXT_PARTITIONABLE", str);
+    os << (partitionAffinityDomain == 0 ? str + " : None" : str) << std::endl;
+}
@@ -0,0 +1,155 @@
+#ifndef DEVICE_CAPABILITIES_H
+#define DEVICE_CAPABILITIES_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <CL/cl.h>
+
+// Snapshot of every device parameter the tool reports, collected once into typed fields.
+// The snapshot is plain data so it can be cached on disk (see capability_cache.h) and handed to the probes without touching the driver again.
+struct DeviceCapabilities {
+    // Identification. The key of the on-disk cache is (platformName, name, driverVersion).
+    std::string platformName;
+    cl_device_type type = 0;
+    std::string vendor;
+    cl_uint vendorId = 0;
+    std::string name;
+    // OpenCL's software driver version string in the form major_number.minor_number.
+    std::string driverVersion;
+    // OpenCL<space><major_version.minor_version><space><vendor-specific information>
+    std::string version;
+    // FULL_PROFILE or EMBEDDED_PROFILE.
+    std::string profile;
+    // OpenCL<space>C<space><major_version.minor_version><space><vendor-specific information>
+    std::string openclCVersion;
+    // Space separated list of extension names.
+    std::string extensions;
+
+    cl_bool available = CL_FALSE;
+    cl_uint addressBits = 0;
+    size_t profilingTimerResolution = 0;
+    cl_uint referenceCount = 0;
+    cl_bool endianLittle = CL_FALSE;
+    cl_bool errorCorrectionSupport = CL_FALSE;
+    // Device and host share one memory (integrated GPUs, CPUs), so mapping a buffer needs no copy.
+    cl_bool hostUnifiedMemory = CL_FALSE;
+
+    cl_bool compilerAvailable = CL_FALSE;
+    cl_bool linkerAvailable = CL_FALSE;
+    cl_device_exec_capabilities executionCapabilities = 0;
+    // Semi-colon separated list of built-in kernels, empty if none.
+    std::string builtInKernels;
+
+    cl_device_fp_config singleFpConfig = 0;
+    // Double precision is optional, 0 means no fp64 support.
+    cl_device_fp_config doubleFpConfig = 0;
+    // Native ISA vector width, i.e. the number of scalar elements that fit in a vector register. 0 if the type is unsupported.
+    cl_uint nativeVectorWidthFloat = 0;
+    cl_uint nativeVectorWidthDouble = 0;
+    cl_uint nativeVectorWidthHalf = 0;
+    // Vector width the OpenCL C compiler prefers for the type, may differ from the native width (e.g. 1 on GPUs that scalarize every vector).
+    cl_uint preferredVectorWidthFloat = 0;
+    cl_uint preferredVectorWidthDouble = 0;
+    cl_uint preferredVectorWidthHalf = 0;
+
+    cl_uint maxClockFrequency = 0;
+    cl_uint maxComputeUnits = 0;
+    cl_uint maxWorkItemDimensions = 0;
+    size_t maxWorkGroupSize = 0;
+    // maxWorkItemDimensions entries.
+    std::vector<size_t> maxWorkItemSizes;
+    // OpenCL 2.1, 0 when the driver does not know the query.
+    cl_uint maxNumSubGroups = 0;
+
+    // Alignment requirement (in bits) for sub-buffer offsets.
+    cl_uint memBaseAddrAlign = 0;
+    cl_ulong globalMemSize = 0;
+    cl_ulong maxMemAllocSize = 0;
+    size_t maxGlobalVariableSize = 0;
+    size_t globalVariablePreferredTotalSize = 0;
+
+    cl_device_mem_cache_type globalMemCacheType = CL_NONE;
+    cl_ulong globalMemCacheSize = 0;
+    cl_uint globalMemCachelineSize = 0;
+
+    // CL_LOCAL: dedicated local memory storage such as SRAM. CL_GLOBAL: global memory is treated as local memory.
+    cl_device_local_mem_type localMemType = CL_NONE;
+    cl_ulong localMemSize = 0;
+
+    cl_ulong maxConstantBufferSize = 0;
+    cl_uint maxConstantArgs = 0;
+
+    size_t maxParameterSize = 0;
+    size_t printfBufferSize = 0;
+
+    // Device side command queues, OpenCL 2.0.
+    cl_uint maxOnDeviceQueues = 0;
+    cl_uint maxOnDeviceEvents = 0;
+    cl_uint queueOnDeviceMaxSize = 0;
+    cl_uint queueOnDevicePreferredSize = 0;
+    cl_command_queue_properties queueOnDeviceProperties = 0;
+    cl_command_queue_properties queueOnHostProperties = 0;
+
+    // Shared virtual memory, OpenCL 2.0. 0 if the device has none.
+    cl_device_svm_capabilities svmCapabilities = 0;
+
+    cl_bool imageSupport = CL_FALSE;
+    // 0 without image support.
+    size_t image2dMaxWidth = 0;
+    size_t image2dMaxHeight = 0;
+
+    // Sub-device partitioning, OpenCL 1.2. The partition properties list drops the terminating 0, empty if the device cannot be partitioned.
+    cl_uint partitionMaxSubDevices = 0;
+    std::vector<cl_device_partition_property> partitionProperties;
+    cl_device_affinity_domain partitionAffinityDomain = 0;
+
+    // Collect every parameter of the device through queryDeviceInfo, whose result types come from the trait table in device_info_traits.h.
+    // Scalars take a single clGetDeviceInfo call each, strings share one reusable buffer.
+    static DeviceCapabilities query(cl_device_id device);
+
+    // True if the space separated CL_DEVICE_EXTENSIONS list contains the extension name.
+    bool hasExtension(const std::string& extension) const;
+
+    // Print the snapshot in the same layout as the per-parameter report.
+    void print(std::ostream& os) const;
+};
+
+// Every field of the snapshot with its machine-readable name, in a fixed order. The on-disk cache stores the fields in this order
+// (bump its format version when the list changes) and the JSON inventory uses the names as keys.
+template <typename Visitor, typename Caps>
+void visitCapabilityFields(Visitor&& visit, Caps& caps) {
+    visit("platform_name", caps.platformName); visit("type", caps.type); visit("vendor", caps.vendor); visit("vendor_id", caps.vendorId);
+    visit("name", caps.name); visit("driver_version", caps.driverVersion);
+    visit("version", caps.version); visit("profile", caps.profile); visit("opencl_c_version", caps.openclCVersion); visit("extensions", caps.extensions);
+    visit("available", caps.available); visit("address_bits", caps.addressBits); visit("profiling_timer_resolution", caps.profilingTimerResolution);
+    visit("reference_count", caps.referenceCount);
+    visit("endian_little", caps.endianLittle); visit("error_correction_support", caps.errorCorrectionSupport); visit("host_unified_memory", caps.hostUnifiedMemory);
+    visit("compiler_available", caps.compilerAvailable); visit("linker_available", caps.linkerAvailable);
+    visit("execution_capabilities", caps.executionCapabilities); visit("built_in_kernels", caps.builtInKernels);
+    visit("single_fp_config", caps.singleFpConfig); visit("double_fp_config", caps.doubleFpConfig);
+    visit("native_vector_width_float", caps.nativeVectorWidthFloat); visit("native_vector_width_double", caps.nativeVectorWidthDouble);
+    visit("native_vector_width_half", caps.nativeVectorWidthHalf);
+    visit("preferred_vector_width_float", caps.preferredVectorWidthFloat); visit("preferred_vector_width_double", caps.preferredVectorWidthDouble);
+    visit("preferred_vector_width_half", caps.preferredVectorWidthHalf);
+    visit("max_clock_frequency", caps.maxClockFrequency); visit("max_compute_units", caps.maxComputeUnits);
+    visit("max_work_item_dimensions", caps.maxWorkItemDimensions); visit("max_work_group_size", caps.maxWorkGroupSize);
+    visit("max_work_item_sizes", caps.maxWorkItemSizes); visit("max_num_sub_groups", caps.maxNumSubGroups);
+    visit("mem_base_addr_align", caps.memBaseAddrAlign); visit("global_mem_size", caps.globalMemSize); visit("max_mem_alloc_size", caps.maxMemAllocSize);
+    visit("max_global_variable_size", caps.maxGlobalVariableSize); visit("global_variable_preferred_total_size", caps.globalVariablePreferredTotalSize);
+    visit("global_mem_cache_type", caps.globalMemCacheType); visit("global_mem_cache_size", caps.globalMemCacheSize);
+    visit("global_mem_cacheline_size", caps.globalMemCachelineSize);
+    visit("local_mem_type", caps.localMemType); visit("local_mem_size", caps.localMemSize);
+    visit("max_constant_buffer_size", caps.maxConstantBufferSize); visit("max_constant_args", caps.maxConstantArgs);
+    visit("max_parameter_size", caps.maxParameterSize); visit("printf_buffer_size", caps.printfBufferSize);
+    visit("max_on_device_queues", caps.maxOnDeviceQueues); visit("max_on_device_events", caps.maxOnDeviceEvents);
+    visit("queue_on_device_max_size", caps.queueOnDeviceMaxSize); visit("queue_on_device_preferred_size", caps.queueOnDevicePreferredSize);
+    visit("queue_on_device_properties", caps.queueOnDeviceProperties); visit("queue_on_host_properties", caps.queueOnHostProperties);
+    visit("svm_capabilities", caps.svmCapabilities);
+    visit("image_support", caps.imageSupport); visit("image2d_max_width", caps.image2dMaxWidth); visit("image2d_max_height", caps.image2dMaxHeight);
+    visit("partition_max_sub_devices", caps.partitionMaxSubDevices); visit("partition_properties", caps.partitionProperties);
+    visit("partition_affinity_domain", caps.partitionAffinityDomain);
+}
+
+#endif //DEVICE_CAPABILITIES_H
@@ -0,0 +1,149 @@
+#include "device_info_traits.h"
+
+#include <algorithm>
+
+namespace {
+
+template <cl_device_info Param>
+void printDeviceInfo(std::ostream& os, cl_device_id device) {
+    DeviceInfoTraits<Param>::format(os, queryDeviceInfo<Param>(device));
+}
+
+#define OPENCL_DEVICE_INFO_ENTRY(param, Type, formatter, presence) {param, #param, &printDeviceInfo<param>},
+constexpr DeviceInfoEntry kDeviceInfoTable[] = {
+    OPENCL_DEVICE_INFO_TABLE(OPENCL_DEVICE_INFO_ENTRY)
+};
+#undef OPENCL_DEVICE_INFO_ENTRY
+
+// Writes the names of the set flags separated by " | ", or "none".
+template <typename T, size_t N>
+void printFlags(std::ostream& os, T value, const std::pair<T, const char*> (&flags)[N]) {
+    bool any = false;
+    for(const auto& flag : flags) {
+        if(value & flag.first) {
+            os << (any ? " | " : "") << flag.second;
+            any = true;
+        }
+    }
+    if(!any) {
+        os << "none";
+    }
+}
+
+}
+
+namespace device_info_format {
+
+void boolean(std::ostream& os, const cl_bool& value) {
+    os << (value ? "Yes" : "No");
+}
+
+void string(std::ostream& os, const std::string& value) {
+    os << value;
+}
+
+void platform(std::ostream& os, const cl_platform_id& value) {
+    os << getPlatformInfoString(value, CL_PLATFORM_NAME);
+}
+
+void deviceType(std::ostream& os, const cl_device_type& value) {
+    static const std::pair<cl_device_type, const char*> flags[] = {
+            {CL_DEVICE_TYPE_CPU, "CL_DEVICE_TYPE_CPU"},
+            {CL_DEVICE_TYPE_GPU, "CL_DEVICE_TYPE_GPU"},
+            {CL_DEVICE_TYPE_ACCELERATOR, "CL_DEVICE_TYPE_ACCELERATOR"},
+            {CL_DEVICE_TYPE_DEFAULT, "CL_DEVICE_TYPE_DEFAULT"},
+    };
+    printFlags(os, value, flags);
+}
+
+void execCapabilities(std::ostream& os, const cl_device_exec_capabilities& value) {
+    static const std::pair<cl_device_exec_capabilities, const char*> flags[] = {
+            {CL_EXEC_KERNEL, "CL_EXEC_KERNEL"},
+            {CL_EXEC_NATIVE_KERNEL, "CL_EXEC_NATIVE_KERNEL"},
+    };
+    printFlags(os, value, flags);
+}
+
+void fpConfig(std::ostream& os, const cl_device_fp_config& value) {
+    static const std::pair<cl_device_fp_config, const char*> flags[] = {
+            {CL_FP_DENORM, "CL_FP_DENORM"},
+            {CL_FP_INF_NAN, "CL_FP_INF_NAN"},
+            {CL_FP_ROUND_TO_NEAREST, "CL_FP_ROUND_TO_NEAREST"},
+            {CL_FP_ROUND_TO_ZERO, "CL_FP_ROUND_TO_ZERO"},
+            {CL_FP_ROUND_TO_INF, "CL_FP_ROUND_TO_INF"},
+            {CL_FP_FMA, "CL_FP_FMA"},
+            {CL_FP_CORRECTLY_ROUNDED_DIVIDE_SQRT, "CL_FP_CORRECTLY_ROUNDED_DIVIDE_SQRT"},
+            {CL_FP_SOFT_FLOAT, "CL_FP_SOFT_FLOAT"},
+    };
+    printFlags(os, value, flags);
+}
+
+void cacheType(std::ostream& os, const cl_device_mem_cache_type& value) {
+    os << (value == CL_READ_ONLY_CACHE ? "CL_READ_ONLY_CACHE" : value == CL_READ_WRITE_CACHE ? "CL_READ_WRITE_CACHE" : "CL_NONE");
+}
+
+void localMemType(std::ostream& os, const cl_device_local_mem_type& value) {
+    os << (value == CL_LOCAL ? "CL_LOCAL" : value == CL_GLOBAL ? "CL_GLOBAL" : "CL_NONE");
+}
+
+void queueProperties(std::ostream& os, const cl_command_queue_properties& value) {
+    static const std::pair<cl_command_queue_properties, const char*> flags[] = {
+            {CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE, "CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE"},
+            {CL_QUEUE_PROFILING_ENABLE, "CL_QUEUE_PROFILING_ENABLE"},
+    };
+    printFlags(os, value, flags);
+}
+
+void partitionProperties(std::ostream& os, const std::vector<cl_device_partition_property>& value) {
+    bool any = false;
+    for(auto property : value) {
+        if(property == 0) {
+            continue;
+        }
+        os << (any ? " | " : "")
+           << (property == CL_DEVICE_PARTITION_EQUALLY ? "CL_DEVICE_PARTITION_EQUALLY"
+               : property == CL_DEVICE_PARTITION_BY_COUNTS ? "CL_DEVICE_PARTITION_BY_COUNTS"
+               : property == CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN ? "CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN" : "unknown");
+        any = true;
+    }
+    if(!any) {
+        os << "none";
+    }
+}
+
+void affinityDomain(std::ostream& os, const cl_device_affinity_domain& value) {
+    static const std::pair<cl_device_affinity_domain, const char*> flags[] = {
+            {CL_DEVICE_AFFINITY_DOMAIN_NUMA, "CL_DEVICE_AFFINITY_DOMAIN_NUMA"},
+            {CL_DEVICE_AFFINITY_DOMAIN_L4_CACHE, "CL_DEVICE_AFFINITY_DOMAIN_L4_CACHE"},
+            {CL_DEVICE_AFFINITY_DOMAIN_L3_CACHE, "CL_DEVICE_AFFINITY_DOMAIN_L3_CACHE"},
+            {CL_DEVICE_AFFINITY_DOMAIN_L2_CACHE, "CL_DEVICE_AFFINITY_DOMAIN_L2_CACHE"},
+            {CL_DEVICE_AFFINITY_DOMAIN_L1_CACHE, "CL_DEVICE_AFFINITY_DOMAIN_L1_CACHE"},
+            {CL_DEVICE_AFFINITY_DOMAIN_NEXT_PARTITIONABLE, "CL_DEVICE_AFFINITY_DOMAIN_NEXT_PARTITIONABLE"},
+    };
+    printFlags(os, value, flags);
+}
+
+void svmCapabilities(std::ostream& os, const cl_device_svm_capabilities& value) {
+    static const std::pair<cl_device_svm_capabilities, const char*> flags[] = {
+            {CL_DEVICE_SVM_COARSE_GRAIN_BUFFER, "CL_DEVICE_SVM_COARSE_GRAIN_BUFFER"},
+            {CL_DEVICE_SVM_FINE_GRAIN_BUFFER, "CL_DEVICE_SVM_FINE_GRAIN_BUFFER"},
+            {CL_DEVICE_SVM_FINE_GRAIN_SYSTEM, "CL_DEVICE_SVM_FINE_GRAIN_SYSTEM"},
+            {CL_DEVICE_SVM_ATOMICS, "CL_DEVICE_SVM_ATOMICS"},
+    };
+    printFlags(os, value, flags);
+}
+
+}
+
+const DeviceInfoEntry* findDeviceInfo(cl_device_info param) {
+    auto it = std::find_if(std::begin(kDeviceInfoTable), std::end(kDeviceInfoTable), [param](const DeviceInfoEntry& entry) { return entry.param == param; });
+    return it == std::end(kDeviceInfoTable) ? nullptr : it;
+}
+
+void printAllDeviceInfo(std::ostream& os, cl_device_id device) {
+    for(const auto& entry : kDeviceInfoTable) {
+        os << entry.name << " : ";
+        entry.print(os, device);
+        os << '\n';
+    }
+}
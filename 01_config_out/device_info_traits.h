@@ -0,0 +1,176 @@
+#ifndef DEVICE_INFO_TRAITS_H
+#define DEVICE_INFO_TRAITS_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <CL/cl.h>
+
+#include "opencl_utils.h"
+
+// Formatters for the trait table. Bitfields and enumerants share their C type with plain numbers (cl_device_type is a cl_ulong),
+// so every table entry names its formatter explicitly.
+namespace device_info_format {
+
+template <typename T>
+void number(std::ostream& os, const T& value) {
+    os << value;
+}
+template <typename T>
+void bytes(std::ostream& os, const T& value) {
+    os << value << " bytes";
+}
+template <typename T>
+void list(std::ostream& os, const std::vector<T>& values) {
+    for(size_t idx = 0; idx < values.size(); ++idx) {
+        os << (idx ? ", " : "") << values[idx];
+    }
+}
+void boolean(std::ostream& os, const cl_bool& value);
+void string(std::ostream& os, const std::string& value);
+void platform(std::ostream& os, const cl_platform_id& value);
+void deviceType(std::ostream& os, const cl_device_type& value);
+void execCapabilities(std::ostream& os, const cl_device_exec_capabilities& value);
+void fpConfig(std::ostream& os, const cl_device_fp_config& value);
+void cacheType(std::ostream& os, const cl_device_mem_cache_type& value);
+void localMemType(std::ostream& os, const cl_device_local_mem_type& value);
+void queueProperties(std::ostream& os, const cl_command_queue_properties& value);
+void partitionProperties(std::ostream& os, const std::vector<cl_device_partition_property>& value);
+void affinityDomain(std::ostream& os, const cl_device_affinity_domain& value);
+void svmCapabilities(std::ostream& os, const cl_device_svm_capabilities& value);
+
+}
+
+// The table: parameter, result type, formatter, and whether drivers older than the parameter reject it (Optional) rather than
+// that being an error (Required). Adding a parameter is one line here, nothing else has to change.
+#define OPENCL_DEVICE_INFO_TABLE(X) \
+    X(CL_DEVICE_TYPE, cl_device_type, deviceType, Required) \
+    X(CL_DEVICE_VENDOR, std::string, string, Required) \
+    X(CL_DEVICE_VENDOR_ID, cl_uint, number, Required) \
+    X(CL_DEVICE_NAME, std::string, string, Required) \
+    X(CL_DRIVER_VERSION, std::string, string, Required) \
+    X(CL_DEVICE_VERSION, std::string, string, Required) \
+    X(CL_DEVICE_PROFILE, std::string, string, Required) \
+    X(CL_DEVICE_OPENCL_C_VERSION, std::string, string, Required) \
+    X(CL_DEVICE_EXTENSIONS, std::string, string, Required) \
+    X(CL_DEVICE_PLATFORM, cl_platform_id, platform, Required) \
+    X(CL_DEVICE_AVAILABLE, cl_bool, boolean, Required) \
+    X(CL_DEVICE_ADDRESS_BITS, cl_uint, number, Required) \
+    X(CL_DEVICE_PROFILING_TIMER_RESOLUTION, size_t, number, Required) \
+    X(CL_DEVICE_REFERENCE_COUNT, cl_uint, number, Required) \
+    X(CL_DEVICE_ENDIAN_LITTLE, cl_bool, boolean, Required) \
+    X(CL_DEVICE_ERROR_CORRECTION_SUPPORT, cl_bool, boolean, Required) \
+    X(CL_DEVICE_HOST_UNIFIED_MEMORY, cl_bool, boolean, Optional) \
+    X(CL_DEVICE_COMPILER_AVAILABLE, cl_bool, boolean, Required) \
+    X(CL_DEVICE_LINKER_AVAILABLE, cl_bool, boolean, Required) \
+    X(CL_DEVICE_EXECUTION_CAPABILITIES, cl_device_exec_capabilities, execCapabilities, Required) \
+    X(CL_DEVICE_BUILT_IN_KERNELS, std::string, string, Required) \
+    X(CL_DEVICE_SINGLE_FP_CONFIG, cl_device_fp_config, fpConfig, Required) \
+    X(CL_DEVICE_DOUBLE_FP_CONFIG, cl_device_fp_config, fpConfig, Required) \
+    X(CL_DEVICE_NATIVE_VECTOR_WIDTH_FLOAT, cl_uint, number, Required) \
+    X(CL_DEVICE_NATIVE_VECTOR_WIDTH_DOUBLE, cl_uint, number, Required) \
+    X(CL_DEVICE_NATIVE_VECTOR_WIDTH_HALF, cl_uint, number, Required) \
+    X(CL_DEVICE_PREFERRED_VECTOR_WIDTH_FLOAT, cl_uint, number, Required) \
+    X(CL_DEVICE_PREFERRED_VECTOR_WIDTH_DOUBLE, cl_uint, number, Required) \
+    X(CL_DEVICE_PREFERRED_VECTOR_WIDTH_HALF, cl_uint, number, Required) \
+    X(CL_DEVICE_MAX_CLOCK_FREQUENCY, cl_uint, number, Required) \
+    X(CL_DEVICE_MAX_COMPUTE_UNITS, cl_uint, number, Required) \
+    X(CL_DEVICE_MAX_WORK_ITEM_DIMENSIONS, cl_uint, number, Required) \
+    X(CL_DEVICE_MAX_WORK_GROUP_SIZE, size_t, number, Required) \
+    X(CL_DEVICE_MAX_WORK_ITEM_SIZES, std::vector<size_t>, list, Required) \
+    X(CL_DEVICE_MAX_NUM_SUB_GROUPS, cl_uint, number, Optional) \
+    X(CL_DEVICE_MEM_BASE_ADDR_ALIGN, cl_uint, number, Required) \
+    X(CL_DEVICE_GLOBAL_MEM_SIZE, cl_ulong, bytes, Required) \
+    X(CL_DEVICE_MAX_MEM_ALLOC_SIZE, cl_ulong, bytes, Required) \
+    X(CL_DEVICE_MAX_GLOBAL_VARIABLE_SIZE, size_t, bytes, Optional) \
+    X(CL_DEVICE_GLOBAL_VARIABLE_PREFERRED_TOTAL_SIZE, size_t, bytes, Optional) \
+    X(CL_DEVICE_GLOBAL_MEM_CACHE_TYPE, cl_device_mem_cache_type, cacheType, Required) \
+    X(CL_DEVICE_GLOBAL_MEM_CACHE_SIZE, cl_ulong, bytes, Required) \
+    X(CL_DEVICE_GLOBAL_MEM_CACHELINE_SIZE, cl_uint, bytes, Required) \
+    X(CL_DEVICE_LOCAL_MEM_TYPE, cl_device_local_mem_type, localMemType, Required) \
+    X(CL_DEVICE_LOCAL_MEM_SIZE, cl_ulong, bytes, Required) \
+    X(CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE, cl_ulong, bytes, Required) \
+    X(CL_DEVICE_MAX_CONSTANT_ARGS, cl_uint, number, Required) \
+    X(CL_DEVICE_MAX_PARAMETER_SIZE, size_t, bytes, Required) \
+    X(CL_DEVICE_PRINTF_BUFFER_SIZE, size_t, bytes, Required) \
+    X(CL_DEVICE_MAX_ON_DEVICE_QUEUES, cl_uint, number, Optional) \
+    X(CL_DEVICE_MAX_ON_DEVICE_EVENTS, cl_uint, number, Optional) \
+    X(CL_DEVICE_QUEUE_ON_DEVICE_MAX_SIZE, cl_uint, bytes, Optional) \
+    X(CL_DEVICE_QUEUE_ON_DEVICE_PREFERRED_SIZE, cl_uint, bytes, Optional) \
+    X(CL_DEVICE_QUEUE_ON_DEVICE_PROPERTIES, cl_command_queue_properties, queueProperties, Optional) \
+    X(CL_DEVICE_QUEUE_ON_HOST_PROPERTIES, cl_command_queue_properties, queueProperties, Required) \
+    X(CL_DEVICE_SVM_CAPABILITIES, cl_device_svm_capabilities, svmCapabilities, Optional) \
+    X(CL_DEVICE_IMAGE_SUPPORT, cl_bool, boolean, Required) \
+    X(CL_DEVICE_IMAGE2D_MAX_WIDTH, size_t, number, Required) \
+    X(CL_DEVICE_IMAGE2D_MAX_HEIGHT, size_t, number, Required) \
+    X(CL_DEVICE_PARTITION_MAX_SUB_DEVICES, cl_uint, number, Required) \
+    X(CL_DEVICE_PARTITION_PROPERTIES, std::vector<cl_device_partition_property>, partitionProperties, Required) \
+    X(CL_DEVICE_PARTITION_AFFINITY_DOMAIN, cl_device_affinity_domain, affinityDomain, Required)
+
+enum class DeviceInfoPresence {
+    Required,
+    Optional,
+};
+
+// Result type, name and formatter of one parameter. Only the parameters of the table are specialized,
+// querying anything else is a compile error instead of a wrongly sized read.
+template <cl_device_info Param>
+struct DeviceInfoTraits;
+
+#define OPENCL_DEVICE_INFO_TRAIT(param, Type, formatter, presence) \
+    template <> \
+    struct DeviceInfoTraits<param> { \
+        using type = Type; \
+        static constexpr DeviceInfoPresence presence_ = DeviceInfoPresence::presence; \
+        static constexpr const char* name() { return #param; } \
+        static void format(std::ostream& os, const type& value) { device_info_format::formatter(os, value); } \
+    };
+OPENCL_DEVICE_INFO_TABLE(OPENCL_DEVICE_INFO_TRAIT)
+#undef OPENCL_DEVICE_INFO_TRAIT
+
+// How a result type is read: scalars straight into a stack variable with one call, strings through the reusable buffer of
+// getDeviceInfoString, arrays with a size query.
+template <typename T>
+struct DeviceInfoReader {
+    static T read(cl_device_id device, cl_device_info param, DeviceInfoPresence presence) {
+        return presence == DeviceInfoPresence::Optional ? getOptionalDeviceInfoScalar<T>(device, param) : getDeviceInfoScalar<T>(device, param);
+    }
+};
+
+template <>
+struct DeviceInfoReader<std::string> {
+    static std::string read(cl_device_id device, cl_device_info param, DeviceInfoPresence) {
+        return getDeviceInfoString(device, param);
+    }
+};
+
+template <typename T>
+struct DeviceInfoReader<std::vector<T>> {
+    static std::vector<T> read(cl_device_id device, cl_device_info param, DeviceInfoPresence) {
+        return getDeviceInfoArray<T>(device, param);
+    }
+};
+
+// Typed query, the result type comes from the table: auto units = queryDeviceInfo<CL_DEVICE_MAX_COMPUTE_UNITS>(device);
+template <cl_device_info Param>
+typename DeviceInfoTraits<Param>::type queryDeviceInfo(cl_device_id device) {
+    using Traits = DeviceInfoTraits<Param>;
+    return DeviceInfoReader<typename Traits::type>::read(device, Param, Traits::presence_);
+}
+
+// One row of the runtime view of the table.
+struct DeviceInfoEntry {
+    cl_device_info param;
+    const char* name;
+    // Query the parameter and write it through its formatter.
+    void (*print)(std::ostream& os, cl_device_id device);
+};
+
+// nullptr if the parameter is not in the table.
+const DeviceInfoEntry* findDeviceInfo(cl_device_info param);
+
+// "<name> : <formatted value>" for every parameter of the table, straight from the driver.
+void printAllDeviceInfo(std::ostream& os, cl_device_id device);
+
+#endif //DEVICE_INFO_TRAITS_H
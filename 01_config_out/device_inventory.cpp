@@ -0,0 +1,89 @@
+#include "device_inventory.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include <CL/cl_ext.h>
+
+#include "cl_trace.h"
+#include "opencl_utils.h"
+#include "thread_pool.h"
+
+DeviceInventory DeviceInventory::enumerate(CapabilityCache& cache, bool refresh, size_t threadCount) {
+    DeviceInventory inventory;
+
+    cl_uint numPlatforms = 0;
+    cl_int err = clGetPlatformIDs(0, nullptr, &numPlatforms);
+    // The ICD loader reports CL_PLATFORM_NOT_FOUND_KHR when no vendor driver is installed, which is an empty inventory rather than an error.
+    if(err == CL_PLATFORM_NOT_FOUND_KHR || numPlatforms == 0) {
+        return inventory;
+    }
+    checkOpenCLError(err);
+    std::vector<cl_platform_id> platforms(numPlatforms);
+    checkOpenCLError(clGetPlatformIDs(numPlatforms, platforms.data(), nullptr));
+
+    for(size_t idx = 0; idx < platforms.size(); ++idx) {
+        PlatformRecord platform;
+        platform.id = platforms[idx];
+        platform.name = getPlatformInfoString(platforms[idx], CL_PLATFORM_NAME);
+        platform.vendor = getPlatformInfoString(platforms[idx], CL_PLATFORM_VENDOR);
+        platform.version = getPlatformInfoString(platforms[idx], CL_PLATFORM_VERSION);
+        inventory.platforms.push_back(platform);
+
+        // CPU, GPU and accelerator devices alike. A platform without devices answers CL_DEVICE_NOT_FOUND.
+        cl_uint numDevices = 0;
+        err = clGetDeviceIDs(platforms[idx], CL_DEVICE_TYPE_ALL, 0, nullptr, &numDevices);
+        if(err == CL_DEVICE_NOT_FOUND || numDevices == 0) {
+            continue;
+        }
+        checkOpenCLError(err);
+        std::vector<cl_device_id> devices(numDevices);
+        checkOpenCLError(clGetDeviceIDs(platforms[idx], CL_DEVICE_TYPE_ALL, numDevices, devices.data(), nullptr));
+
+        for(auto device : devices) {
+            DeviceRecord record;
+            record.platformIndex = idx;
+            record.platform = platforms[idx];
+            record.device = device;
+            inventory.devices.push_back(record);
+        }
+    }
+
+    if(inventory.devices.empty()) {
+        return inventory;
+    }
+
+    if(threadCount == 0) {
+        threadCount = std::min<size_t>(inventory.devices.size(), std::max(1u, std::thread::hardware_concurrency()));
+    }
+    inventory.workerCount = threadCount;
+
+    // Each task writes only its own slot, so the report keeps the device order no matter which query finishes first.
+    auto start = std::chrono::steady_clock::now();
+    {
+        ThreadPool pool(threadCount);
+        for(auto& record : inventory.devices) {
+            pool.submit([&cache, &record, refresh] {
+                TraceScope scope("device capabilities");
+                record.caps = cache.get(record.device, &record.source, refresh);
+            });
+        }
+        pool.wait();
+    }
+    inventory.wallNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    for(const auto& record : inventory.devices) {
+        inventory.serialNanoseconds += record.source.elapsedNanoseconds;
+    }
+
+    return inventory;
+}
+
+std::string deviceTypeName(cl_device_type type) {
+    std::string str;
+    appendBitfield<cl_device_type>(type, CL_DEVICE_TYPE_CPU, "CPU", str);
+    appendBitfield<cl_device_type>(type, CL_DEVICE_TYPE_GPU, "GPU", str);
+    appendBitfield<cl_device_type>(type, CL_DEVICE_TYPE_ACCELERATOR, "ACCELERATOR", str);
+    appendBitfield<cl_device_type>(type, CL_DEVICE_TYPE_CUSTOM, "CUSTOM", str);
+    return str.empty() ? "UNKNOWN" : str;
+}
@@ -0,0 +1,48 @@
+#ifndef DEVICE_INVENTORY_H
+#define DEVICE_INVENTORY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <CL/cl.h>
+
+#include "capability_cache.h"
+#include "device_capabilities.h"
+
+struct PlatformRecord {
+    cl_platform_id id = nullptr;
+    std::string name;
+    std::string vendor;
+    std::string version;
+};
+
+struct DeviceRecord {
+    // Index into DeviceInventory::platforms.
+    size_t platformIndex = 0;
+    cl_platform_id platform = nullptr;
+    cl_device_id device = nullptr;
+    DeviceCapabilities caps;
+    CapabilitySource source;
+};
+
+// Every device of every platform (CL_DEVICE_TYPE_ALL), in platform order then driver order.
+struct DeviceInventory {
+    std::vector<PlatformRecord> platforms;
+    std::vector<DeviceRecord> devices;
+    // Wall clock time of the per-device queries, and their sum as if they had run one after another.
+    uint64_t wallNanoseconds = 0;
+    uint64_t serialNanoseconds = 0;
+    size_t workerCount = 0;
+
+    // The platform/device ID enumeration is cheap and done inline. The per-device capability queries are spread over a
+    // worker pool (threadCount == 0: one worker per device, capped at the hardware concurrency).
+    static DeviceInventory enumerate(CapabilityCache& cache, bool refresh = false, size_t threadCount = 0);
+
+    const PlatformRecord& platformOf(const DeviceRecord& record) const { return platforms[record.platformIndex]; }
+};
+
+// Short human readable device type, e.g. "GPU" or "CPU".
+std::string deviceTypeName(cl_device_type type);
+
+#endif //DEVICE_INVENTORY_H
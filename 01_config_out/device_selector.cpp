@@ -0,0 +1,311 @@
+#include "device_selector.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "device_session.h"
+#include "opencl_utils.h"
+#include "units.h"
+
+namespace {
+
+const char* kProbeSource = R"CLC(
+__kernel void probe_copy(__global const float4* src, __global float4* dst) {
+    size_t i = get_global_id(0);
+    dst[i] = src[i];
+}
+
+// Two independent FMA chains per work-item, 2 flops per mad.
+__kernel void probe_fma(__global float* out, float a, float b) {
+    float x = (float)get_global_id(0);
+    float y = x * 0.5f;
+    for(int i = 0; i < PROBE_FMA_ITERATIONS; ++i) {
+        x = mad(x, a, b);
+        y = mad(y, a, b);
+    }
+    out[get_global_id(0)] = x + y;
+}
+)CLC";
+
+const int kProbeFmaIterations = 256;
+const int kProbeRepetitions = 3;
+
+bool parseWeight(const std::string& token, const std::string& name, double& weight, std::string& error) {
+    if(token == name) {
+        weight = 1.0;
+        return true;
+    }
+    if(token.compare(0, name.size() + 1, name + "=") == 0) {
+        char* end = nullptr;
+        auto text = token.substr(name.size() + 1);
+        weight = std::strtod(text.c_str(), &end);
+        if(text.empty() || *end != '\0' || weight < 0) {
+            error = "invalid weight in \"" + token + "\"";
+        }
+        return true;
+    }
+    return false;
+}
+
+bool parseMinimum(const std::string& token, const std::string& name, cl_ulong& bytes, std::string& error) {
+    if(token.compare(0, name.size() + 1, name + "=") != 0) {
+        return false;
+    }
+    uint64_t value = 0;
+    if(!parseByteSize(token.substr(name.size() + 1), value)) {
+        error = "invalid byte size in \"" + token + "\"";
+    }
+    bytes = value;
+    return true;
+}
+
+// Fill eligibility and the raw metrics of one device, without normalizing.
+void evaluate(const DeviceCapabilities& caps, const SelectionProfile& profile, DeviceScore& score) {
+    if(!caps.available) {
+        score.eligible = false;
+        score.reason = "not available";
+    }
+    else if(!(caps.type & profile.allowedTypes)) {
+        score.eligible = false;
+        score.reason = "device type excluded";
+    }
+    else if(profile.requireFp64 && caps.doubleFpConfig == 0) {
+        score.eligible = false;
+        score.reason = "no fp64";
+    }
+    else if(profile.requireImages && !caps.imageSupport) {
+        score.eligible = false;
+        score.reason = "no image support";
+    }
+    else if(caps.globalMemSize < profile.minGlobalMemSize) {
+        score.eligible = false;
+        score.reason = "global memory " + formatBytes(caps.globalMemSize) + " < " + formatBytes(profile.minGlobalMemSize);
+    }
+    else if(caps.localMemSize < profile.minLocalMemSize) {
+        score.eligible = false;
+        score.reason = "local memory " + formatBytes(caps.localMemSize) + " < " + formatBytes(profile.minLocalMemSize);
+    }
+
+    score.computeEstimate = static_cast<double>(caps.maxComputeUnits) * caps.maxClockFrequency;
+}
+
+// Normalize every metric by its maximum over the eligible devices, combine with the weights and sort best first.
+void scoreAndSort(const DeviceInventory& inventory, const SelectionProfile& profile, std::vector<DeviceScore>& scores) {
+    auto computeOf = [](const DeviceScore& s) { return s.measuredGflops > 0 ? s.measuredGflops : s.computeEstimate; };
+    // Unprobed devices contribute nothing to a bandwidth weight rather than a guess (profile.needsProbe()).
+    auto bandwidthOf = [](const DeviceScore& s) { return s.measuredBandwidthGBs; };
+    auto memoryOf = [&](const DeviceScore& s) { return static_cast<double>(inventory.devices[s.deviceIndex].caps.globalMemSize); };
+    auto localMemoryOf = [&](const DeviceScore& s) {
+        const auto& caps = inventory.devices[s.deviceIndex].caps;
+        // Local memory emulated in global memory (CL_GLOBAL) gives none of the bandwidth benefit, count it half.
+        return static_cast<double>(caps.localMemSize) * (caps.localMemType == CL_LOCAL ? 1.0 : 0.5);
+    };
+    auto doubleOf = [&](const DeviceScore& s) {
+        auto config = inventory.devices[s.deviceIndex].caps.doubleFpConfig;
+        return config == 0 ? 0.0 : ((config & CL_FP_FMA) ? 1.0 : 0.5);
+    };
+
+    double maxCompute = 0, maxBandwidth = 0, maxMemory = 0, maxLocalMemory = 0, maxDouble = 0;
+    for(const auto& s : scores) {
+        if(!s.eligible) {
+            continue;
+        }
+        maxCompute = std::max(maxCompute, computeOf(s));
+        maxBandwidth = std::max(maxBandwidth, bandwidthOf(s));
+        maxMemory = std::max(maxMemory, memoryOf(s));
+        maxLocalMemory = std::max(maxLocalMemory, localMemoryOf(s));
+        maxDouble = std::max(maxDouble, doubleOf(s));
+    }
+    auto normalized = [](double value, double maximum) { return maximum > 0 ? value / maximum : 0.0; };
+
+    double totalWeight = profile.computeWeight + profile.bandwidthWeight + profile.memoryWeight + profile.localMemoryWeight + profile.doubleWeight;
+    for(auto& s : scores) {
+        if(!s.eligible || totalWeight <= 0) {
+            s.score = 0.0;
+            continue;
+        }
+        s.score = (profile.computeWeight * normalized(computeOf(s), maxCompute)
+                   + profile.bandwidthWeight * normalized(bandwidthOf(s), maxBandwidth)
+                   + profile.memoryWeight * normalized(memoryOf(s), maxMemory)
+                   + profile.localMemoryWeight * normalized(localMemoryOf(s), maxLocalMemory)
+                   + profile.doubleWeight * normalized(doubleOf(s), maxDouble)) / totalWeight;
+    }
+
+    std::stable_sort(scores.begin(), scores.end(), [](const DeviceScore& a, const DeviceScore& b) {
+        if(a.eligible != b.eligible) {
+            return a.eligible;
+        }
+        return a.score > b.score;
+    });
+}
+
+// Short measurement of copy bandwidth and FMA throughput. Returns false if the device cannot build the probe.
+bool probeDevice(const DeviceRecord& record, double& bandwidthGBs, double& gflops) {
+    const auto& caps = record.caps;
+    if(!caps.compilerAvailable) {
+        return false;
+    }
+
+    auto session = DeviceSession::create(record.device);
+    std::string buildLog;
+    cl_program program = tryBuildProgram(session.context, record.device, kProbeSource, "-DPROBE_FMA_ITERATIONS=" + std::to_string(kProbeFmaIterations), buildLog);
+    if(!program) {
+        session.release();
+        return false;
+    }
+    cl_kernel copyKernel = createKernel(program, "probe_copy");
+    cl_kernel fmaKernel = createKernel(program, "probe_fma");
+    cl_int err;
+
+    // 32 MiB, or a quarter of the largest allocation on small devices.
+    size_t copyBytes = static_cast<size_t>(std::min<cl_ulong>(32u << 20, caps.maxMemAllocSize / 4)) & ~static_cast<size_t>(15);
+    cl_mem src = clCreateBuffer(session.context, CL_MEM_READ_ONLY, copyBytes, nullptr, &err);
+    checkOpenCLError(err);
+    cl_mem dst = clCreateBuffer(session.context, CL_MEM_WRITE_ONLY, copyBytes, nullptr, &err);
+    checkOpenCLError(err);
+    checkOpenCLError( clSetKernelArg(copyKernel, 0, sizeof(cl_mem), &src) );
+    checkOpenCLError( clSetKernelArg(copyKernel, 1, sizeof(cl_mem), &dst) );
+
+    size_t fmaItems = std::max<size_t>(1, caps.maxComputeUnits) * std::max<size_t>(1, caps.maxWorkGroupSize) * 4;
+    cl_mem fmaOut = clCreateBuffer(session.context, CL_MEM_WRITE_ONLY, fmaItems * sizeof(float), nullptr, &err);
+    checkOpenCLError(err);
+    float a = 0.999f, b = 0.001f;
+    checkOpenCLError( clSetKernelArg(fmaKernel, 0, sizeof(cl_mem), &fmaOut) );
+    checkOpenCLError( clSetKernelArg(fmaKernel, 1, sizeof(float), &a) );
+    checkOpenCLError( clSetKernelArg(fmaKernel, 2, sizeof(float), &b) );
+
+    // One warm-up launch each, then keep the best of the timed repetitions.
+    size_t copyItems = copyBytes / 16;
+    cl_ulong bestCopy = 0, bestFma = 0;
+    for(int rep = 0; rep <= kProbeRepetitions; ++rep) {
+        cl_event events[2];
+        checkOpenCLError( clEnqueueNDRangeKernel(session.queue, copyKernel, 1, nullptr, &copyItems, nullptr, 0, nullptr, &events[0]) );
+        checkOpenCLError( clEnqueueNDRangeKernel(session.queue, fmaKernel, 1, nullptr, &fmaItems, nullptr, 0, nullptr, &events[1]) );
+        checkOpenCLError( clWaitForEvents(2, events) );
+        if(rep > 0) {
+            auto copyNs = eventElapsedNanoseconds(events[0]);
+            auto fmaNs = eventElapsedNanoseconds(events[1]);
+            bestCopy = bestCopy == 0 ? copyNs : std::min(bestCopy, copyNs);
+            bestFma = bestFma == 0 ? fmaNs : std::min(bestFma, fmaNs);
+        }
+        clReleaseEvent(events[0]);
+        clReleaseEvent(events[1]);
+    }
+
+    // Bytes read plus bytes written, per nanosecond is GB/s.
+    bandwidthGBs = bestCopy ? 2.0 * copyBytes / bestCopy : 0.0;
+    gflops = bestFma ? static_cast<double>(fmaItems) * kProbeFmaIterations * 2 * 2 / bestFma : 0.0;
+
+    clReleaseMemObject(fmaOut);
+    clReleaseMemObject(dst);
+    clReleaseMemObject(src);
+    clReleaseKernel(fmaKernel);
+    clReleaseKernel(copyKernel);
+    clReleaseProgram(program);
+    session.release();
+    return true;
+}
+
+}
+
+bool SelectionProfile::parse(const std::string& spec, SelectionProfile& profile, std::string& error) {
+    profile = SelectionProfile();
+    profile.allowedTypes = 0;
+    bool anyWeight = false;
+
+    std::stringstream stream(spec);
+    std::string token;
+    while(std::getline(stream, token, ',')) {
+        if(token.empty()) {
+            continue;
+        }
+        error.clear();
+        if(token == "fp64") {
+            profile.requireFp64 = true;
+        }
+        else if(token == "images") {
+            profile.requireImages = true;
+        }
+        else if(token == "cpu") {
+            profile.allowedTypes |= CL_DEVICE_TYPE_CPU;
+        }
+        else if(token == "gpu") {
+            profile.allowedTypes |= CL_DEVICE_TYPE_GPU;
+        }
+        else if(token == "accelerator") {
+            profile.allowedTypes |= CL_DEVICE_TYPE_ACCELERATOR;
+        }
+        else if(parseMinimum(token, "min-global-mem", profile.minGlobalMemSize, error)
+                || parseMinimum(token, "min-local-mem", profile.minLocalMemSize, error)) {
+        }
+        else if(parseWeight(token, "compute", profile.computeWeight, error)
+                || parseWeight(token, "bandwidth", profile.bandwidthWeight, error)
+                || parseWeight(token, "memory", profile.memoryWeight, error)
+                || parseWeight(token, "local-memory", profile.localMemoryWeight, error)
+                || parseWeight(token, "double", profile.doubleWeight, error)) {
+            anyWeight = true;
+        }
+        else {
+            error = "unknown selection token \"" + token + "\"";
+        }
+        if(!error.empty()) {
+            return false;
+        }
+    }
+
+    if(profile.allowedTypes == 0) {
+        profile.allowedTypes = CL_DEVICE_TYPE_ALL;
+    }
+    if(!anyWeight) {
+        profile.computeWeight = 1.0;
+    }
+    return true;
+}
+
+std::vector<DeviceScore> rankDevices(const DeviceInventory& inventory, const SelectionProfile& profile) {
+    std::vector<DeviceScore> scores(inventory.devices.size());
+    for(size_t idx = 0; idx < inventory.devices.size(); ++idx) {
+        scores[idx].deviceIndex = idx;
+        evaluate(inventory.devices[idx].caps, profile, scores[idx]);
+    }
+    scoreAndSort(inventory, profile, scores);
+    return scores;
+}
+
+void refineWithProbe(const DeviceInventory& inventory, const SelectionProfile& profile, std::vector<DeviceScore>& scores) {
+    for(auto& s : scores) {
+        if(!s.eligible) {
+            continue;
+        }
+        if(!probeDevice(inventory.devices[s.deviceIndex], s.measuredBandwidthGBs, s.measuredGflops)) {
+            // Mixing measured and estimated numbers in one normalization would be meaningless, so a device that cannot be probed drops out.
+            s.eligible = false;
+            s.reason = "probe failed to build";
+        }
+    }
+    scoreAndSort(inventory, profile, scores);
+}
+
+void printRanking(const DeviceInventory& inventory, const std::vector<DeviceScore>& scores) {
+    std::cout << "Rank | Score  | Device" << std::endl;
+    for(size_t rank = 0; rank < scores.size(); ++rank) {
+        const auto& s = scores[rank];
+        const auto& record = inventory.devices[s.deviceIndex];
+        std::cout << std::setw(4) << (s.eligible ? std::to_string(rank + 1) : std::string("-")) << " | "
+                  << std::fixed << std::setprecision(3) << std::setw(6) << s.score << " | "
+                  << "#" << s.deviceIndex << " " << record.caps.name << " [" << deviceTypeName(record.caps.type) << "] on " << inventory.platformOf(record).name;
+        if(!s.eligible) {
+            std::cout << " (rejected: " << s.reason << ")";
+        }
+        else if(s.measuredBandwidthGBs > 0 || s.measuredGflops > 0) {
+            std::cout << std::setprecision(1) << " (measured " << s.measuredBandwidthGBs << " GB/s copy, " << s.measuredGflops << " GFLOPS fp32)";
+        }
+        else {
+            std::cout << std::setprecision(0) << " (" << record.caps.maxComputeUnits << " CUs x " << record.caps.maxClockFrequency << " MHz)";
+        }
+        std::cout << std::defaultfloat << std::endl;
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef DEVICE_SELECTOR_H
+#define DEVICE_SELECTOR_H
+
+#include <string>
+#include <vector>
+
+#include <CL/cl.h>
+
+#include "device_inventory.h"
+
+// Requirements a device must meet, and weights of the properties the ranking maximizes.
+//
+// Parsed from a comma separated list, e.g. "fp64,bandwidth" or "gpu,min-global-mem=4G,compute=2,local-memory":
+//      fp64, images                        require double precision / image support
+//      cpu, gpu, accelerator               only consider these device types (any of them)
+//      min-global-mem=N, min-local-mem=N   require at least N bytes, K/M/G suffixes accepted
+//      compute[=w]                         CL_DEVICE_MAX_COMPUTE_UNITS x CL_DEVICE_MAX_CLOCK_FREQUENCY
+//      bandwidth[=w]                       measured memory throughput, see needsProbe
+//      memory[=w]                          CL_DEVICE_GLOBAL_MEM_SIZE
+//      local-memory[=w]                    CL_DEVICE_LOCAL_MEM_SIZE
+//      double[=w]                          CL_DEVICE_DOUBLE_FP_CONFIG (fp64 with FMA scores highest)
+// Without any weight token the profile maximizes compute.
+struct SelectionProfile {
+    bool requireFp64 = false;
+    bool requireImages = false;
+    cl_device_type allowedTypes = CL_DEVICE_TYPE_ALL;
+    cl_ulong minGlobalMemSize = 0;
+    cl_ulong minLocalMemSize = 0;
+
+    double computeWeight = 0.0;
+    double bandwidthWeight = 0.0;
+    double memoryWeight = 0.0;
+    double localMemoryWeight = 0.0;
+    double doubleWeight = 0.0;
+
+    // No capability reports memory bandwidth, so a bandwidth weight can only be honored with refineWithProbe.
+    bool needsProbe() const { return bandwidthWeight > 0; }
+
+    // Returns false and fills error for an unknown token or a malformed value.
+    static bool parse(const std::string& spec, SelectionProfile& profile, std::string& error);
+};
+
+struct DeviceScore {
+    // Index into DeviceInventory::devices.
+    size_t deviceIndex = 0;
+    bool eligible = true;
+    // Why the device was rejected, empty when eligible.
+    std::string reason;
+    // Weighted sum of the normalized metrics, in [0, 1]. Ineligible devices score 0.
+    double score = 0.0;
+
+    // Raw metrics the score was computed from.
+    double computeEstimate = 0.0;
+    // Filled by refineWithProbe, 0 if the device was not probed.
+    double measuredBandwidthGBs = 0.0;
+    double measuredGflops = 0.0;
+};
+
+// Score every device of the inventory from its cached capabilities. Best device first, ineligible devices last.
+std::vector<DeviceScore> rankDevices(const DeviceInventory& inventory, const SelectionProfile& profile);
+
+// Run a short streaming copy and FMA kernel on every eligible device and re-rank with the measured numbers
+// in place of the compute units x clock estimates.
+void refineWithProbe(const DeviceInventory& inventory, const SelectionProfile& profile, std::vector<DeviceScore>& scores);
+
+// Print the ranking as a table, one line per device.
+void printRanking(const DeviceInventory& inventory, const std::vector<DeviceScore>& scores);
+
+#endif //DEVICE_SELECTOR_H
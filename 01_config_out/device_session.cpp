@@ -0,0 +1,113 @@
+#include "device_session.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "opencl_utils.h"
+
+DeviceSession DeviceSession::create(cl_device_id device, cl_command_queue_properties properties) {
+    DeviceSession session;
+    cl_int err;
+
+    session.device = device;
+    session.context = clCreateContext(nullptr, 1, &device, nullptr, nullptr, &err);
+    checkOpenCLError(err);
+
+    cl_queue_properties queueProperties[] = {CL_QUEUE_PROPERTIES, properties, 0};
+    session.queue = clCreateCommandQueueWithProperties(session.context, device, properties ? queueProperties : nullptr, &err);
+    checkOpenCLError(err);
+
+    return session;
+}
+
+bool DeviceSession::tryCreate(cl_device_id device, DeviceSession& session, std::string& error, cl_command_queue_properties properties) {
+    cl_int err;
+    session = DeviceSession();
+    session.device = device;
+    session.context = clCreateContext(nullptr, 1, &device, nullptr, nullptr, &err);
+    if(err != CL_SUCCESS) {
+        error = std::string("clCreateContext: ") + getOpenCLErrorString(err);
+        session.context = nullptr;
+        return false;
+    }
+
+    cl_queue_properties queueProperties[] = {CL_QUEUE_PROPERTIES, properties, 0};
+    session.queue = clCreateCommandQueueWithProperties(session.context, device, properties ? queueProperties : nullptr, &err);
+    if(err != CL_SUCCESS) {
+        error = std::string("clCreateCommandQueueWithProperties: ") + getOpenCLErrorString(err);
+        session.queue = nullptr;
+        session.release();
+        return false;
+    }
+    return true;
+}
+
+void DeviceSession::release() {
+    if(queue) {
+        clReleaseCommandQueue(queue);
+        queue = nullptr;
+    }
+    if(context) {
+        clReleaseContext(context);
+        context = nullptr;
+    }
+}
+
+cl_program tryBuildProgram(cl_context context, cl_device_id device, const std::string& source, const std::string& options, std::string& buildLog) {
+    cl_int err;
+    const char* sources[] = {source.c_str()};
+    const size_t lengths[] = {source.size()};
+    cl_program program = clCreateProgramWithSource(context, 1, sources, lengths, &err);
+    if(err != CL_SUCCESS) {
+        buildLog = std::string("clCreateProgramWithSource: ") + getOpenCLErrorString(err);
+        return nullptr;
+    }
+
+    err = clBuildProgram(program, 1, &device, options.c_str(), nullptr, nullptr);
+    if(err != CL_SUCCESS) {
+        size_t size = 0;
+        clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, 0, nullptr, &size);
+        buildLog.assign(size, '\0');
+        if(size > 0) {
+            clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, size, &buildLog[0], nullptr);
+        }
+        clReleaseProgram(program);
+        return nullptr;
+    }
+    return program;
+}
+
+cl_program buildProgram(cl_context context, cl_device_id device, const std::string& source, const std::string& options) {
+    std::string buildLog;
+    cl_program program = tryBuildProgram(context, device, source, options, buildLog);
+    if(!program) {
+        fprintf(stderr, "Program build failed (options \"%s\"):\n%s\n", options.c_str(), buildLog.c_str());
+        exit(1);
+    }
+    return program;
+}
+
+cl_kernel createKernel(cl_program program, const char* name) {
+    cl_int err;
+    cl_kernel kernel = clCreateKernel(program, name, &err);
+    checkOpenCLError(err);
+    return kernel;
+}
+
+cl_ulong eventElapsedNanoseconds(cl_event event) {
+    cl_ulong nanoseconds = 0;
+    checkOpenCLError( tryEventElapsedNanoseconds(event, nanoseconds) );
+    return nanoseconds;
+}
+
+cl_int tryEventElapsedNanoseconds(cl_event event, cl_ulong& nanoseconds) {
+    cl_ulong start, end;
+    cl_int err = clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(start), &start, nullptr);
+    if(err == CL_SUCCESS) {
+        err = clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(end), &end, nullptr);
+    }
+    if(err == CL_SUCCESS) {
+        nanoseconds = end - start;
+    }
+    return err;
+}
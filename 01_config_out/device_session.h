@@ -0,0 +1,36 @@
+#ifndef DEVICE_SESSION_H
+#define DEVICE_SESSION_H
+
+#include <string>
+
+#include <CL/cl.h>
+
+// A context with one command queue on a single device, the starting point of every probe.
+struct DeviceSession {
+    cl_device_id device = nullptr;
+    cl_context context = nullptr;
+    cl_command_queue queue = nullptr;
+
+    // Profiling is enabled by default, the probes time their commands with event timestamps.
+    static DeviceSession create(cl_device_id device, cl_command_queue_properties properties = CL_QUEUE_PROFILING_ENABLE);
+    // Same as create, but returns false with the failing call in error instead of exiting. Nothing is left to release on failure.
+    static bool tryCreate(cl_device_id device, DeviceSession& session, std::string& error,
+                          cl_command_queue_properties properties = CL_QUEUE_PROFILING_ENABLE);
+    void release();
+};
+
+// Build the program for a single device. On a build failure the build log is printed and the process exits, like checkOpenCLError.
+cl_program buildProgram(cl_context context, cl_device_id device, const std::string& source, const std::string& options = "");
+
+// Same as buildProgram, but returns nullptr and leaves the build log in buildLog instead of exiting.
+cl_program tryBuildProgram(cl_context context, cl_device_id device, const std::string& source, const std::string& options, std::string& buildLog);
+
+cl_kernel createKernel(cl_program program, const char* name);
+
+// Device side duration of a finished command (CL_PROFILING_COMMAND_END - CL_PROFILING_COMMAND_START), the queue needs CL_QUEUE_PROFILING_ENABLE.
+cl_ulong eventElapsedNanoseconds(cl_event event);
+
+// Same as eventElapsedNanoseconds, but returns the error code of the failing query instead of exiting.
+cl_int tryEventElapsedNanoseconds(cl_event event, cl_ulong& nanoseconds);
+
+#endif //DEVICE_SESSION_H
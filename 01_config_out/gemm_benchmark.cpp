@@ -0,0 +1,292 @@
+#include "gemm_benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+#include "device_session.h"
+#include "opencl_utils.h"
+
+namespace {
+
+// Row-major n x n matrices, C = A * B. TS and WPT come from the build options, the naive kernel ignores them.
+const char* kGemmSource = R"CLC(
+__kernel void gemm_naive(int n, __global const float* A, __global const float* B, __global float* C) {
+    int col = get_global_id(0);
+    int row = get_global_id(1);
+    float acc = 0.0f;
+    for(int k = 0; k < n; ++k) {
+        acc += A[row * n + k] * B[k * n + col];
+    }
+    C[row * n + col] = acc;
+}
+
+__kernel void gemm_tiled(int n, __global const float* A, __global const float* B, __global float* C) {
+    __local float As[TS][TS];
+    __local float Bs[TS][TS];
+    int lc = get_local_id(0);
+    int lr = get_local_id(1);
+    int col = get_group_id(0) * TS + lc;
+    int row = get_group_id(1) * TS + lr;
+    float acc = 0.0f;
+    for(int t = 0; t < n; t += TS) {
+        As[lr][lc] = A[row * n + t + lc];
+        Bs[lr][lc] = B[(t + lr) * n + col];
+        barrier(CLK_LOCAL_MEM_FENCE);
+        for(int k = 0; k < TS; ++k) {
+            acc += As[lr][k] * Bs[k][lc];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    C[row * n + col] = acc;
+}
+
+// Work-item (lc, lr) computes rows lr, lr + RTS, ... of column lc of the tile, RTS = TS / WPT work-items per column.
+#define RTS (TS / WPT)
+__kernel void gemm_blocked(int n, __global const float* A, __global const float* B, __global float* C) {
+    __local float As[TS][TS];
+    __local float Bs[TS][TS];
+    int lc = get_local_id(0);
+    int lr = get_local_id(1);
+    int col = get_group_id(0) * TS + lc;
+    int rowBase = get_group_id(1) * TS;
+    float acc[WPT];
+    for(int w = 0; w < WPT; ++w) {
+        acc[w] = 0.0f;
+    }
+    for(int t = 0; t < n; t += TS) {
+        for(int w = 0; w < WPT; ++w) {
+            int r = lr + w * RTS;
+            As[r][lc] = A[(rowBase + r) * n + t + lc];
+            Bs[r][lc] = B[(t + r) * n + col];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+        for(int k = 0; k < TS; ++k) {
+            float b = Bs[k][lc];
+            for(int w = 0; w < WPT; ++w) {
+                acc[w] += As[lr + w * RTS][k] * b;
+            }
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    for(int w = 0; w < WPT; ++w) {
+        C[(rowBase + lr + w * RTS) * n + col] = acc[w];
+    }
+}
+)CLC";
+
+const size_t kMaxTile = 64;
+const size_t kMaxRowsPerItem = 8;
+// Entries of C checked against the host.
+const size_t kCheckedEntries = 64;
+const GemmVariant kVariants[] = {GemmVariant::Naive, GemmVariant::LocalTiled, GemmVariant::RegisterBlocked};
+
+const char* kernelNameOf(GemmVariant variant) {
+    switch(variant) {
+        case GemmVariant::Naive:
+            return "gemm_naive";
+        case GemmVariant::LocalTiled:
+            return "gemm_tiled";
+        case GemmVariant::RegisterBlocked:
+            return "gemm_blocked";
+    }
+    return "gemm_naive";
+}
+
+std::vector<size_t> localSizeOf(GemmVariant variant, const GemmTiling& tiling) {
+    if(variant == GemmVariant::Naive) {
+        return {};
+    }
+    return {tiling.tile, tiling.tile / tiling.rowsPerItem};
+}
+
+// Small integers, so every product and partial sum is exact in float and the device result must match the host bit for bit.
+float matrixValue(size_t row, size_t col, size_t seed) {
+    return static_cast<float>(static_cast<int>((row * 7 + col * 3 + seed) % 5) - 2);
+}
+
+}
+
+const char* gemmVariantName(GemmVariant variant) {
+    switch(variant) {
+        case GemmVariant::Naive:
+            return "naive";
+        case GemmVariant::LocalTiled:
+            return "local-tiled";
+        case GemmVariant::RegisterBlocked:
+            return "register-blocked";
+    }
+    return "unknown";
+}
+
+GemmTiling chooseGemmTiling(const DeviceCapabilities& caps, GemmVariant variant) {
+    GemmTiling tiling;
+    if(variant == GemmVariant::Naive) {
+        return tiling;
+    }
+    size_t maxX = caps.maxWorkItemSizes.size() > 0 ? caps.maxWorkItemSizes[0] : caps.maxWorkGroupSize;
+    size_t maxY = caps.maxWorkItemSizes.size() > 1 ? caps.maxWorkItemSizes[1] : caps.maxWorkGroupSize;
+    for(size_t tile = kMaxTile; tile >= 1; tile /= 2) {
+        size_t rowsPerItem = variant == GemmVariant::RegisterBlocked ? std::min(kMaxRowsPerItem, tile) : 1;
+        size_t itemsY = tile / rowsPerItem;
+        // An A and a B tile per work-group, two work-groups resident per compute unit.
+        bool fitsLocal = 2 * 2 * tile * tile * sizeof(float) <= caps.localMemSize;
+        if(tile * itemsY <= caps.maxWorkGroupSize && tile <= maxX && itemsY <= maxY && fitsLocal) {
+            tiling.tile = tile;
+            tiling.rowsPerItem = rowsPerItem;
+            return tiling;
+        }
+    }
+    return tiling;
+}
+
+GemmReport measureGemm(const DeviceRecord& record, size_t n, TuningDatabase& database, int repetitions) {
+    GemmReport report;
+    const auto& caps = record.caps;
+    report.n = n = std::max<size_t>(kMaxTile, n / kMaxTile * kMaxTile);
+    report.emulatedLocalMemory = caps.localMemType == CL_GLOBAL;
+
+    std::vector<float> a(n * n), b(n * n), c(n * n);
+    for(size_t row = 0; row < n; ++row) {
+        for(size_t col = 0; col < n; ++col) {
+            a[row * n + col] = matrixValue(row, col, 0);
+            b[row * n + col] = matrixValue(row, col, 1);
+        }
+    }
+
+    auto session = DeviceSession::create(record.device);
+    cl_int err;
+    size_t bytes = n * n * sizeof(float);
+    cl_mem bufferA = clCreateBuffer(session.context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, bytes, a.data(), &err);
+    checkOpenCLError(err);
+    cl_mem bufferB = clCreateBuffer(session.context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, bytes, b.data(), &err);
+    checkOpenCLError(err);
+    cl_mem bufferC = clCreateBuffer(session.context, CL_MEM_WRITE_ONLY, bytes, nullptr, &err);
+    checkOpenCLError(err);
+    cl_int argN = static_cast<cl_int>(n);
+
+    report.previousWinner = recordedGemmVariant(database, caps, n, GemmVariant::Naive);
+    TuningRecord best;
+    for(auto variant : kVariants) {
+        GemmSample sample;
+        sample.variant = variant;
+        sample.tiling = chooseGemmTiling(caps, variant);
+
+        // The built kernel may allow fewer work-items than the device (CL_KERNEL_WORK_GROUP_SIZE), halve the tile until it launches.
+        cl_program program = nullptr;
+        cl_kernel kernel = nullptr;
+        for(;;) {
+            auto options = "-DTS=" + std::to_string(sample.tiling.tile) + " -DWPT=" + std::to_string(sample.tiling.rowsPerItem);
+            program = buildProgram(session.context, record.device, kGemmSource, options);
+            kernel = createKernel(program, kernelNameOf(variant));
+            size_t kernelGroupSize = 0;
+            checkOpenCLError( clGetKernelWorkGroupInfo(kernel, record.device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(kernelGroupSize), &kernelGroupSize, nullptr) );
+            auto local = localSizeOf(variant, sample.tiling);
+            if(local.empty() || local[0] * local[1] <= kernelGroupSize || sample.tiling.tile == 1) {
+                break;
+            }
+            clReleaseKernel(kernel);
+            clReleaseProgram(program);
+            sample.tiling.tile /= 2;
+            sample.tiling.rowsPerItem = std::min(sample.tiling.rowsPerItem, sample.tiling.tile);
+        }
+        checkOpenCLError( clSetKernelArg(kernel, 0, sizeof(cl_int), &argN) );
+        checkOpenCLError( clSetKernelArg(kernel, 1, sizeof(cl_mem), &bufferA) );
+        checkOpenCLError( clSetKernelArg(kernel, 2, sizeof(cl_mem), &bufferB) );
+        checkOpenCLError( clSetKernelArg(kernel, 3, sizeof(cl_mem), &bufferC) );
+
+        size_t global[] = {n, n};
+        auto local = localSizeOf(variant, sample.tiling);
+        if(variant == GemmVariant::RegisterBlocked) {
+            global[1] = n / sample.tiling.rowsPerItem;
+        }
+        std::vector<double> nanoseconds;
+        // One untimed warm-up launch.
+        for(int rep = 0; rep <= repetitions; ++rep) {
+            cl_event event;
+            checkOpenCLError( clEnqueueNDRangeKernel(session.queue, kernel, 2, nullptr, global, local.empty() ? nullptr : local.data(), 0, nullptr, &event) );
+            checkOpenCLError( clWaitForEvents(1, &event) );
+            auto elapsed = eventElapsedNanoseconds(event);
+            clReleaseEvent(event);
+            if(rep > 0 && elapsed > 0) {
+                nanoseconds.push_back(static_cast<double>(elapsed));
+            }
+        }
+        sample.nanoseconds = summarize(nanoseconds);
+        sample.gflops = sample.nanoseconds.median > 0 ? 2.0 * n * n * n / sample.nanoseconds.median : 0.0;
+
+        checkOpenCLError( clEnqueueReadBuffer(session.queue, bufferC, CL_TRUE, 0, bytes, c.data(), 0, nullptr, nullptr) );
+        for(size_t check = 0; check < kCheckedEntries; ++check) {
+            size_t row = (check * 2654435761u) % n, col = (check * 40503u + 17) % n;
+            double expected = 0.0;
+            for(size_t k = 0; k < n; ++k) {
+                expected += static_cast<double>(a[row * n + k]) * b[k * n + col];
+            }
+            sample.maxError = std::max(sample.maxError, std::fabs(expected - c[row * n + col]));
+        }
+        std::fill(c.begin(), c.end(), 0.0f);
+
+        // The inputs make the product exact, so any error means the variant is broken (e.g. at the tile of the halving retry) and cannot win.
+        bool correct = sample.maxError == 0.0;
+        if(correct && (best.variant.empty() || (sample.nanoseconds.median > 0 && sample.nanoseconds.median < best.nanoseconds))) {
+            best.variant = gemmVariantName(variant);
+            best.localSize = local;
+            best.nanoseconds = sample.nanoseconds.median;
+            report.winner = variant;
+        }
+        report.samples.push_back(sample);
+
+        clReleaseKernel(kernel);
+        clReleaseProgram(program);
+    }
+    if(!best.variant.empty()) {
+        database.store(TuningDatabase::makeKey(caps, "gemm", {n, n}), best);
+        report.recorded = true;
+    }
+
+    clReleaseMemObject(bufferC);
+    clReleaseMemObject(bufferB);
+    clReleaseMemObject(bufferA);
+    session.release();
+    return report;
+}
+
+GemmVariant recordedGemmVariant(const TuningDatabase& database, const DeviceCapabilities& caps, size_t n, GemmVariant fallback) {
+    TuningRecord record;
+    if(!database.find(TuningDatabase::makeKey(caps, "gemm", {n, n}), record)) {
+        return fallback;
+    }
+    for(auto variant : kVariants) {
+        if(record.variant == gemmVariantName(variant)) {
+            return variant;
+        }
+    }
+    return fallback;
+}
+
+void printGemmReport(const GemmReport& report) {
+    std::cout << "GEMM " << report.n << " x " << report.n << " float" << std::endl;
+    if(report.emulatedLocalMemory) {
+        std::cout << "Local memory is CL_GLOBAL (emulated in global memory), tiling through __local may not pay off" << std::endl;
+    }
+    std::cout << std::left << std::setw(18) << "Variant" << std::setw(14) << "tile" << std::right << std::setw(12) << "median ms"
+              << std::setw(10) << "GFLOPS" << std::setw(12) << "max error" << std::endl;
+    for(const auto& sample : report.samples) {
+        std::string tile = sample.variant == GemmVariant::Naive ? "-" : std::to_string(sample.tiling.tile) + "x" + std::to_string(sample.tiling.tile);
+        if(sample.variant == GemmVariant::RegisterBlocked) {
+            tile += " /" + std::to_string(sample.tiling.rowsPerItem);
+        }
+        std::cout << std::left << std::setw(18) << gemmVariantName(sample.variant) << std::setw(14) << tile << std::right
+                  << std::fixed << std::setprecision(2) << std::setw(12) << sample.nanoseconds.median / 1e6
+                  << std::setprecision(1) << std::setw(10) << sample.gflops
+                  << std::setprecision(0) << std::setw(12) << sample.maxError
+                  << std::defaultfloat << std::endl;
+    }
+    if(!report.recorded) {
+        std::cout << "No variant matched the host reference, nothing recorded" << std::endl;
+        return;
+    }
+    std::cout << "Winner: " << gemmVariantName(report.winner) << " (recorded in the tuning database, previously "
+              << gemmVariantName(report.previousWinner) << ")" << std::endl;
+}
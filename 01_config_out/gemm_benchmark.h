@@ -0,0 +1,62 @@
+#ifndef GEMM_BENCHMARK_H
+#define GEMM_BENCHMARK_H
+
+#include <string>
+#include <vector>
+
+#include "device_inventory.h"
+#include "statistics.h"
+#include "tuning_database.h"
+
+enum class GemmVariant {
+    // One work-item per element of C, every operand read from global memory.
+    Naive,
+    // TS x TS work-groups stage TS x TS tiles of A and B through __local memory.
+    LocalTiled,
+    // Like LocalTiled, but each work-item keeps WPT rows of C in registers, so a TS x TS tile needs only TS x TS/WPT work-items.
+    RegisterBlocked,
+};
+
+const char* gemmVariantName(GemmVariant variant);
+
+// Tile edge (TS) and rows per work-item (WPT) of the tiled variants.
+struct GemmTiling {
+    size_t tile = 1;
+    size_t rowsPerItem = 1;
+};
+
+// Largest power-of-two tile whose A and B tiles leave room for two resident work-groups in CL_DEVICE_LOCAL_MEM_SIZE and whose work-group
+// (TS x TS/WPT work-items) fits CL_DEVICE_MAX_WORK_GROUP_SIZE and CL_DEVICE_MAX_WORK_ITEM_SIZES. WPT is 1 for LocalTiled.
+GemmTiling chooseGemmTiling(const DeviceCapabilities& caps, GemmVariant variant);
+
+struct GemmSample {
+    GemmVariant variant = GemmVariant::Naive;
+    GemmTiling tiling;
+    Summary nanoseconds;
+    double gflops = 0.0;
+    // Largest absolute difference to a host reference over a sample of C entries.
+    double maxError = 0.0;
+};
+
+struct GemmReport {
+    size_t n = 0;
+    std::vector<GemmSample> samples;
+    GemmVariant winner = GemmVariant::Naive;
+    // False if no variant matched the host reference, then the database is left alone.
+    bool recorded = false;
+    // What recordedGemmVariant returned before this run, Naive if the device was never measured.
+    GemmVariant previousWinner = GemmVariant::Naive;
+    // CL_DEVICE_LOCAL_MEM_TYPE is CL_GLOBAL: __local is emulated in global memory and tiling through it may not pay off.
+    bool emulatedLocalMemory = false;
+};
+
+// Multiply two n x n float matrices (n a multiple of 64) with every variant and store the fastest one with an exact result in the tuning
+// database under the kernel name "gemm", with its variant name and local size.
+GemmReport measureGemm(const DeviceRecord& record, size_t n, TuningDatabase& database, int repetitions);
+
+// The variant recorded by measureGemm for the device and size, fallback if it was never measured.
+GemmVariant recordedGemmVariant(const TuningDatabase& database, const DeviceCapabilities& caps, size_t n, GemmVariant fallback);
+
+void printGemmReport(const GemmReport& report);
+
+#endif //GEMM_BENCHMARK_H
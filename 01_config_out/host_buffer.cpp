@@ -0,0 +1,186 @@
+#include "host_buffer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+#include "device_session.h"
+#include "opencl_utils.h"
+#include "units.h"
+
+namespace {
+
+const char* kScaleSource = R"CLC(
+__kernel void scale(__global float* data, float factor) {
+    size_t i = get_global_id(0);
+    data[i] = data[i] * factor;
+}
+)CLC";
+
+// One entry per device and driver: the comparison only runs at one size, the largest of the bandwidth sweep.
+std::string transferTuningKey(const DeviceCapabilities& caps) {
+    return TuningDatabase::makeKey(caps, "host-transfer", {});
+}
+
+}
+
+const char* transferStrategyName(TransferStrategy strategy) {
+    switch(strategy) {
+        case TransferStrategy::Auto:
+            return "auto";
+        case TransferStrategy::ZeroCopy:
+            return "zero-copy (map)";
+        case TransferStrategy::ExplicitCopy:
+            return "explicit copy";
+    }
+    return "unknown";
+}
+
+TransferStrategy autoTransferStrategy(const DeviceCapabilities& caps, const TuningDatabase* database) {
+    TuningRecord record;
+    if(database && database->find(transferTuningKey(caps), record)) {
+        for(auto strategy : {TransferStrategy::ZeroCopy, TransferStrategy::ExplicitCopy}) {
+            if(record.variant == transferStrategyName(strategy)) {
+                return strategy;
+            }
+        }
+    }
+    return caps.hostUnifiedMemory ? TransferStrategy::ZeroCopy : TransferStrategy::ExplicitCopy;
+}
+
+HostVisibleBuffer::HostVisibleBuffer(cl_context context, cl_command_queue queue, const DeviceCapabilities& caps, size_t size,
+                                     TransferStrategy strategy, void* hostPtr, const TuningDatabase* database)
+        : queue_(queue), size_(size), strategy_(strategy) {
+    if(strategy_ == TransferStrategy::Auto) {
+        strategy_ = autoTransferStrategy(caps, database);
+    }
+
+    cl_int err;
+    if(strategy_ == TransferStrategy::ZeroCopy) {
+        cl_mem_flags flags = CL_MEM_READ_WRITE | (hostPtr ? CL_MEM_USE_HOST_PTR : CL_MEM_ALLOC_HOST_PTR);
+        buffer_ = clCreateBuffer(context, flags, size_, hostPtr, &err);
+    }
+    else {
+        buffer_ = clCreateBuffer(context, CL_MEM_READ_WRITE, size_, nullptr, &err);
+        if(!hostPtr) {
+            shadowStorage_.resize(size_);
+            hostPtr = shadowStorage_.data();
+        }
+        shadow_ = hostPtr;
+    }
+    checkOpenCLError(err);
+}
+
+HostVisibleBuffer::~HostVisibleBuffer() {
+    if(mapped_) {
+        unmap();
+    }
+    clReleaseMemObject(buffer_);
+}
+
+void* HostVisibleBuffer::map(cl_map_flags flags) {
+    mapFlags_ = flags;
+    if(strategy_ == TransferStrategy::ZeroCopy) {
+        cl_int err;
+        mapped_ = clEnqueueMapBuffer(queue_, buffer_, CL_TRUE, flags, 0, size_, 0, nullptr, nullptr, &err);
+        checkOpenCLError(err);
+        return mapped_;
+    }
+
+    if(flags & CL_MAP_READ) {
+        checkOpenCLError( clEnqueueReadBuffer(queue_, buffer_, CL_TRUE, 0, size_, shadow_, 0, nullptr, nullptr) );
+    }
+    mapped_ = shadow_;
+    return mapped_;
+}
+
+void HostVisibleBuffer::unmap() {
+    if(strategy_ == TransferStrategy::ZeroCopy) {
+        checkOpenCLError( clEnqueueUnmapMemObject(queue_, buffer_, mapped_, 0, nullptr, nullptr) );
+        checkOpenCLError( clFinish(queue_) );
+    }
+    else if(mapFlags_ & (CL_MAP_WRITE | CL_MAP_WRITE_INVALIDATE_REGION)) {
+        checkOpenCLError( clEnqueueWriteBuffer(queue_, buffer_, CL_TRUE, 0, size_, shadow_, 0, nullptr, nullptr) );
+    }
+    mapped_ = nullptr;
+}
+
+TransferComparison compareTransferStrategies(const DeviceRecord& record, size_t bytes, int repetitions, TuningDatabase& database) {
+    TransferComparison comparison;
+    comparison.hostUnifiedMemory = record.caps.hostUnifiedMemory == CL_TRUE;
+    comparison.autoChoice = autoTransferStrategy(record.caps, &database);
+
+    bytes = std::min<size_t>(bytes, record.caps.maxMemAllocSize / 4);
+    size_t elements = std::max<size_t>(bytes / sizeof(float), 1);
+    comparison.bytes = elements * sizeof(float);
+
+    auto session = DeviceSession::create(record.device, 0);
+    cl_program program = buildProgram(session.context, record.device, kScaleSource);
+    cl_kernel kernel = createKernel(program, "scale");
+    float factor = 2.0f;
+    checkOpenCLError( clSetKernelArg(kernel, 1, sizeof(float), &factor) );
+
+    for(auto strategy : {TransferStrategy::ZeroCopy, TransferStrategy::ExplicitCopy}) {
+        HostVisibleBuffer buffer(session.context, session.queue, record.caps, comparison.bytes, strategy);
+        cl_mem mem = buffer.buffer();
+        checkOpenCLError( clSetKernelArg(kernel, 0, sizeof(cl_mem), &mem) );
+
+        std::vector<double> milliseconds;
+        volatile double checksum = 0.0;
+        // The first round is a warm-up, it pays for first touch of the pages.
+        for(int rep = 0; rep <= repetitions; ++rep) {
+            auto start = std::chrono::steady_clock::now();
+            auto data = static_cast<float*>(buffer.map(CL_MAP_WRITE_INVALIDATE_REGION));
+            std::fill(data, data + elements, 1.0f);
+            buffer.unmap();
+
+            checkOpenCLError( clEnqueueNDRangeKernel(session.queue, kernel, 1, nullptr, &elements, nullptr, 0, nullptr, nullptr) );
+
+            data = static_cast<float*>(buffer.map(CL_MAP_READ));
+            double sum = 0.0;
+            for(size_t idx = 0; idx < elements; idx += 1024) {
+                sum += data[idx];
+            }
+            buffer.unmap();
+            auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if(rep > 0) {
+                milliseconds.push_back(elapsed);
+            }
+            // Keeps the read-back from being optimized away.
+            checksum = checksum + sum;
+        }
+        comparison.samples.push_back({strategy, summarize(milliseconds)});
+    }
+
+    const TransferSample* fastest = nullptr;
+    for(const auto& sample : comparison.samples) {
+        if(!fastest || sample.milliseconds.median < fastest->milliseconds.median) {
+            fastest = &sample;
+        }
+    }
+    comparison.winner = fastest->strategy;
+    TuningRecord best;
+    best.variant = transferStrategyName(fastest->strategy);
+    best.nanoseconds = fastest->milliseconds.median * 1e6;
+    database.store(transferTuningKey(record.caps), best);
+
+    clReleaseKernel(kernel);
+    clReleaseProgram(program);
+    session.release();
+    return comparison;
+}
+
+void printTransferComparison(const TransferComparison& comparison) {
+    std::cout << "Host unified memory: " << (comparison.hostUnifiedMemory ? "yes" : "no")
+              << ", auto strategy so far: " << transferStrategyName(comparison.autoChoice) << std::endl;
+    std::cout << "Round trip of " << formatBytes(comparison.bytes) << " (host fill, kernel, host read):" << std::endl;
+
+    for(const auto& sample : comparison.samples) {
+        std::cout << "    " << std::left << std::setw(18) << transferStrategyName(sample.strategy) << std::right << std::fixed << std::setprecision(3)
+                  << " min " << sample.milliseconds.min << " ms | median " << sample.milliseconds.median << " ms | max " << sample.milliseconds.max << " ms"
+                  << std::defaultfloat << std::endl;
+    }
+    std::cout << "Measured faster: " << transferStrategyName(comparison.winner)
+              << (comparison.winner == comparison.autoChoice ? " (unchanged auto choice)" : " (now the auto choice)") << std::endl;
+}
@@ -0,0 +1,82 @@
+#ifndef HOST_BUFFER_H
+#define HOST_BUFFER_H
+
+#include <string>
+#include <vector>
+
+#include <CL/cl.h>
+
+#include "device_inventory.h"
+#include "statistics.h"
+#include "tuning_database.h"
+
+enum class TransferStrategy {
+    // The strategy compareTransferStrategies measured faster on the device, see autoTransferStrategy.
+    Auto,
+    // CL_MEM_ALLOC_HOST_PTR (or CL_MEM_USE_HOST_PTR for caller memory), host access through clEnqueueMapBuffer.
+    ZeroCopy,
+    // Plain device buffer plus a host shadow, moved with clEnqueueWriteBuffer/clEnqueueReadBuffer.
+    ExplicitCopy,
+};
+
+const char* transferStrategyName(TransferStrategy strategy);
+
+// What Auto resolves to: the winner compareTransferStrategies recorded in database for this device and driver, if any, otherwise
+// ZeroCopy when CL_DEVICE_HOST_UNIFIED_MEMORY is set and ExplicitCopy when not. database may be null.
+TransferStrategy autoTransferStrategy(const DeviceCapabilities& caps, const TuningDatabase* database);
+
+// Device buffer the host reads and writes through map()/unmap() whatever the strategy, so callers never branch on the memory architecture.
+class HostVisibleBuffer {
+public:
+    // hostPtr is optional caller memory of at least size bytes. ZeroCopy wraps it with CL_MEM_USE_HOST_PTR (page aligned memory lets
+    // the driver avoid a copy), ExplicitCopy uses it as the shadow. database is where Auto looks up the measured strategy.
+    HostVisibleBuffer(cl_context context, cl_command_queue queue, const DeviceCapabilities& caps, size_t size,
+                      TransferStrategy strategy = TransferStrategy::Auto, void* hostPtr = nullptr, const TuningDatabase* database = nullptr);
+    ~HostVisibleBuffer();
+
+    HostVisibleBuffer(const HostVisibleBuffer&) = delete;
+    HostVisibleBuffer& operator=(const HostVisibleBuffer&) = delete;
+
+    // Blocking. CL_MAP_READ makes the device contents visible, CL_MAP_WRITE_INVALIDATE_REGION skips that for a full overwrite.
+    void* map(cl_map_flags flags);
+    // Blocking. Makes host writes visible to the device.
+    void unmap();
+
+    cl_mem buffer() const { return buffer_; }
+    size_t size() const { return size_; }
+    TransferStrategy strategy() const { return strategy_; }
+
+private:
+    cl_command_queue queue_;
+    cl_mem buffer_ = nullptr;
+    size_t size_;
+    TransferStrategy strategy_;
+    // ExplicitCopy only: the caller's memory or shadowStorage_.
+    void* shadow_ = nullptr;
+    std::vector<char> shadowStorage_;
+    void* mapped_ = nullptr;
+    cl_map_flags mapFlags_ = 0;
+};
+
+struct TransferSample {
+    TransferStrategy strategy = TransferStrategy::Auto;
+    // Host fill, kernel pass and host read-back of the whole buffer, in milliseconds.
+    Summary milliseconds;
+};
+
+struct TransferComparison {
+    bool hostUnifiedMemory = false;
+    size_t bytes = 0;
+    // What Auto resolved to before this measurement.
+    TransferStrategy autoChoice = TransferStrategy::Auto;
+    TransferStrategy winner = TransferStrategy::Auto;
+    std::vector<TransferSample> samples;
+};
+
+// Run the same host -> kernel -> host round trip with each strategy. The faster one (by median) goes to database and is what
+// TransferStrategy::Auto picks on this device from then on.
+TransferComparison compareTransferStrategies(const DeviceRecord& record, size_t bytes, int repetitions, TuningDatabase& database);
+
+void printTransferComparison(const TransferComparison& comparison);
+
+#endif //HOST_BUFFER_H
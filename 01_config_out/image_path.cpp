@@ -0,0 +1,345 @@
+#include "image_path.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+#include "device_session.h"
+#include "opencl_utils.h"
+
+namespace {
+
+// pixel is float or float4 (CHANNELS). The image kernels are only compiled with IMAGES, devices without image support may reject
+// image2d_t altogether.
+const char* kImage2DSource = R"CLC(
+#if CHANNELS == 1
+typedef float pixel;
+#define FROM_IMAGE(v) ((v).x)
+#else
+typedef float4 pixel;
+#define FROM_IMAGE(v) (v)
+#endif
+
+__kernel void stencil_buffer(__global const pixel* in, __global pixel* out, int w, int h) {
+    int x = get_global_id(0);
+    int y = get_global_id(1);
+    if(x >= w || y >= h) {
+        return;
+    }
+    int xl = max(x - 1, 0), xr = min(x + 1, w - 1);
+    int yu = max(y - 1, 0), yd = min(y + 1, h - 1);
+    out[y * w + x] = 0.5f * in[y * w + x] + 0.125f * (in[y * w + xl] + in[y * w + xr] + in[yu * w + x] + in[yd * w + x]);
+}
+
+__kernel void resample_buffer(__global const pixel* in, __global pixel* out, int w, int h, float scale) {
+    int x = get_global_id(0);
+    int y = get_global_id(1);
+    if(x >= w || y >= h) {
+        return;
+    }
+    // Same convention as a linear sampler with unnormalized coordinates: pixel centers at +0.5.
+    float fx = (x + 0.5f) * scale - 0.5f;
+    float fy = (y + 0.5f) * scale - 0.5f;
+    float x0f = floor(fx), y0f = floor(fy);
+    int x0 = clamp((int)x0f, 0, w - 1), x1 = clamp((int)x0f + 1, 0, w - 1);
+    int y0 = clamp((int)y0f, 0, h - 1), y1 = clamp((int)y0f + 1, 0, h - 1);
+    pixel top = mix(in[y0 * w + x0], in[y0 * w + x1], fx - x0f);
+    pixel bottom = mix(in[y1 * w + x0], in[y1 * w + x1], fx - x0f);
+    out[y * w + x] = mix(top, bottom, fy - y0f);
+}
+
+#if IMAGES
+__constant sampler_t nearestSampler = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_NEAREST;
+__constant sampler_t linearSampler = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_LINEAR;
+
+__kernel void stencil_image(__read_only image2d_t in, __global pixel* out, int w, int h) {
+    int x = get_global_id(0);
+    int y = get_global_id(1);
+    if(x >= w || y >= h) {
+        return;
+    }
+    out[y * w + x] = 0.5f * FROM_IMAGE(read_imagef(in, nearestSampler, (int2)(x, y)))
+                   + 0.125f * (FROM_IMAGE(read_imagef(in, nearestSampler, (int2)(x - 1, y))) + FROM_IMAGE(read_imagef(in, nearestSampler, (int2)(x + 1, y)))
+                             + FROM_IMAGE(read_imagef(in, nearestSampler, (int2)(x, y - 1))) + FROM_IMAGE(read_imagef(in, nearestSampler, (int2)(x, y + 1))));
+}
+
+__kernel void resample_image(__read_only image2d_t in, __global pixel* out, int w, int h, float scale) {
+    int x = get_global_id(0);
+    int y = get_global_id(1);
+    if(x >= w || y >= h) {
+        return;
+    }
+    out[y * w + x] = FROM_IMAGE(read_imagef(in, linearSampler, (float2)((x + 0.5f) * scale, (y + 0.5f) * scale)));
+}
+#endif
+)CLC";
+
+// Source pixels per output pixel of the resample, below 1 so most output pixels fall between source pixels.
+const float kResampleScale = 0.75f;
+const size_t kCheckedPixels = 256;
+// The pixel values span [0, 1]. The filtering hardware may use 8 bit interpolation weights, beyond that a path computes wrong results.
+const double kMaxPathError = 1.0 / 256;
+const Image2DWorkload kWorkloads[] = {Image2DWorkload::Stencil, Image2DWorkload::Resample};
+const Image2DPath kPaths[] = {Image2DPath::Buffer, Image2DPath::Image};
+
+const char* kernelNameOf(Image2DWorkload workload, Image2DPath path) {
+    if(workload == Image2DWorkload::Stencil) {
+        return path == Image2DPath::Image ? "stencil_image" : "stencil_buffer";
+    }
+    return path == Image2DPath::Image ? "resample_image" : "resample_buffer";
+}
+
+const char* tuningNameOf(Image2DWorkload workload) {
+    return workload == Image2DWorkload::Stencil ? "stencil2d" : "resample2d";
+}
+
+// A value in [0, 1] that changes from pixel to pixel, so both filters have something to average.
+float pixelValue(size_t x, size_t y, size_t channel) {
+    return static_cast<float>((x * 7 + y * 13 + channel * 29) % 256) / 255.0f;
+}
+
+struct HostImage {
+    const std::vector<float>& data;
+    long width;
+    long height;
+    size_t channels;
+
+    double at(long x, long y, size_t channel) const {
+        x = std::min(std::max(x, 0L), width - 1);
+        y = std::min(std::max(y, 0L), height - 1);
+        return data[(static_cast<size_t>(y) * width + x) * channels + channel];
+    }
+
+    double reference(Image2DWorkload workload, long x, long y, size_t channel) const {
+        if(workload == Image2DWorkload::Stencil) {
+            return 0.5 * at(x, y, channel) + 0.125 * (at(x - 1, y, channel) + at(x + 1, y, channel) + at(x, y - 1, channel) + at(x, y + 1, channel));
+        }
+        double fx = (x + 0.5) * kResampleScale - 0.5, fy = (y + 0.5) * kResampleScale - 0.5;
+        double x0 = std::floor(fx), y0 = std::floor(fy);
+        double ax = fx - x0, ay = fy - y0;
+        long ix = static_cast<long>(x0), iy = static_cast<long>(y0);
+        double top = at(ix, iy, channel) * (1 - ax) + at(ix + 1, iy, channel) * ax;
+        double bottom = at(ix, iy + 1, channel) * (1 - ax) + at(ix + 1, iy + 1, channel) * ax;
+        return top * (1 - ay) + bottom * ay;
+    }
+};
+
+bool hasFormat(const std::vector<cl_image_format>& formats, cl_channel_order order, cl_channel_type type) {
+    return std::any_of(formats.begin(), formats.end(), [order, type](const cl_image_format& format) {
+        return format.image_channel_order == order && format.image_channel_data_type == type;
+    });
+}
+
+}
+
+const char* image2DPathName(Image2DPath path) {
+    switch(path) {
+        case Image2DPath::Buffer:
+            return "buffer";
+        case Image2DPath::Image:
+            return "image";
+    }
+    return "unknown";
+}
+
+const char* image2DWorkloadName(Image2DWorkload workload) {
+    switch(workload) {
+        case Image2DWorkload::Stencil:
+            return "stencil";
+        case Image2DWorkload::Resample:
+            return "resample";
+    }
+    return "unknown";
+}
+
+std::vector<cl_image_format> supportedImage2DFormats(cl_context context, cl_mem_flags flags) {
+    cl_uint count = 0;
+    if(clGetSupportedImageFormats(context, flags, CL_MEM_OBJECT_IMAGE2D, 0, nullptr, &count) != CL_SUCCESS || count == 0) {
+        return {};
+    }
+    std::vector<cl_image_format> formats(count);
+    checkOpenCLError( clGetSupportedImageFormats(context, flags, CL_MEM_OBJECT_IMAGE2D, count, formats.data(), nullptr) );
+    return formats;
+}
+
+Image2DReport measureImage2DPaths(const DeviceRecord& record, size_t width, size_t height, TuningDatabase& database, int repetitions) {
+    Image2DReport report;
+    const auto& caps = record.caps;
+    auto session = DeviceSession::create(record.device);
+
+    cl_image_format format = {CL_R, CL_FLOAT};
+    if(!caps.imageSupport) {
+        report.imageSkipReason = "no image support";
+    }
+    else {
+        auto formats = supportedImage2DFormats(session.context, CL_MEM_READ_ONLY);
+        report.supportedFormats = formats.size();
+        if(!hasFormat(formats, CL_R, CL_FLOAT)) {
+            format = {CL_RGBA, CL_FLOAT};
+            report.channels = 4;
+            if(!hasFormat(formats, CL_RGBA, CL_FLOAT)) {
+                report.imageSkipReason = "neither CL_R nor CL_RGBA CL_FLOAT is supported";
+                report.channels = 1;
+            }
+        }
+        width = std::min(width, caps.image2dMaxWidth);
+        height = std::min(height, caps.image2dMaxHeight);
+    }
+    bool images = report.imageSkipReason.empty();
+    size_t pixelBytes = report.channels * sizeof(float);
+    while(width * height * pixelBytes > caps.maxMemAllocSize && (width > 1 || height > 1)) {
+        (width >= height ? width : height) /= 2;
+    }
+    report.width = width = std::max<size_t>(width, 1);
+    report.height = height = std::max<size_t>(height, 1);
+
+    std::vector<float> input(width * height * report.channels), output(input.size());
+    for(size_t y = 0; y < height; ++y) {
+        for(size_t x = 0; x < width; ++x) {
+            for(size_t c = 0; c < report.channels; ++c) {
+                input[(y * width + x) * report.channels + c] = pixelValue(x, y, c);
+            }
+        }
+    }
+    HostImage host{input, static_cast<long>(width), static_cast<long>(height), report.channels};
+
+    cl_int err;
+    size_t bytes = input.size() * sizeof(float);
+    cl_mem inputBuffer = clCreateBuffer(session.context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, bytes, input.data(), &err);
+    checkOpenCLError(err);
+    cl_mem outputBuffer = clCreateBuffer(session.context, CL_MEM_WRITE_ONLY, bytes, nullptr, &err);
+    checkOpenCLError(err);
+    cl_mem inputImage = nullptr;
+    if(images) {
+        cl_image_desc desc = {};
+        desc.image_type = CL_MEM_OBJECT_IMAGE2D;
+        desc.image_width = width;
+        desc.image_height = height;
+        inputImage = clCreateImage(session.context, CL_MEM_READ_ONLY, &format, &desc, nullptr, &err);
+        checkOpenCLError(err);
+        size_t origin[] = {0, 0, 0};
+        size_t region[] = {width, height, 1};
+        checkOpenCLError( clEnqueueWriteImage(session.queue, inputImage, CL_TRUE, origin, region, 0, 0, input.data(), 0, nullptr, nullptr) );
+    }
+
+    auto options = "-DCHANNELS=" + std::to_string(report.channels) + (images ? " -DIMAGES=1" : " -DIMAGES=0");
+    cl_program program = buildProgram(session.context, record.device, kImage2DSource, options);
+    cl_int argWidth = static_cast<cl_int>(width), argHeight = static_cast<cl_int>(height);
+    cl_float argScale = kResampleScale;
+    size_t global[] = {width, height};
+
+    for(auto workload : kWorkloads) {
+        Image2DSelection selection;
+        selection.workload = workload;
+        selection.previous = recordedImage2DPath(database, caps, workload, width, height, Image2DPath::Buffer);
+        TuningRecord best;
+        for(auto path : kPaths) {
+            if(path == Image2DPath::Image && !images) {
+                continue;
+            }
+            Image2DSample sample;
+            sample.workload = workload;
+            sample.path = path;
+            cl_kernel kernel = createKernel(program, kernelNameOf(workload, path));
+            checkOpenCLError( clSetKernelArg(kernel, 0, sizeof(cl_mem), path == Image2DPath::Image ? &inputImage : &inputBuffer) );
+            checkOpenCLError( clSetKernelArg(kernel, 1, sizeof(cl_mem), &outputBuffer) );
+            checkOpenCLError( clSetKernelArg(kernel, 2, sizeof(cl_int), &argWidth) );
+            checkOpenCLError( clSetKernelArg(kernel, 3, sizeof(cl_int), &argHeight) );
+            if(workload == Image2DWorkload::Resample) {
+                checkOpenCLError( clSetKernelArg(kernel, 4, sizeof(cl_float), &argScale) );
+            }
+
+            std::vector<double> nanoseconds;
+            // One untimed warm-up launch, which also fills the texture cache path of the image.
+            for(int rep = 0; rep <= repetitions; ++rep) {
+                cl_event event;
+                checkOpenCLError( clEnqueueNDRangeKernel(session.queue, kernel, 2, nullptr, global, nullptr, 0, nullptr, &event) );
+                checkOpenCLError( clWaitForEvents(1, &event) );
+                auto elapsed = eventElapsedNanoseconds(event);
+                clReleaseEvent(event);
+                if(rep > 0 && elapsed > 0) {
+                    nanoseconds.push_back(static_cast<double>(elapsed));
+                }
+            }
+            sample.nanoseconds = summarize(nanoseconds);
+            sample.gigapixelsPerSecond = sample.nanoseconds.median > 0 ? static_cast<double>(width * height) / sample.nanoseconds.median : 0.0;
+
+            checkOpenCLError( clEnqueueReadBuffer(session.queue, outputBuffer, CL_TRUE, 0, bytes, output.data(), 0, nullptr, nullptr) );
+            for(size_t check = 0; check < kCheckedPixels; ++check) {
+                // Include the corners, where the clamping of both paths has to agree.
+                long x = check < 4 ? static_cast<long>(check & 1) * (host.width - 1) : static_cast<long>((check * 2654435761u) % width);
+                long y = check < 4 ? static_cast<long>(check >> 1) * (host.height - 1) : static_cast<long>((check * 40503u + 17) % height);
+                for(size_t c = 0; c < report.channels; ++c) {
+                    double actual = output[(static_cast<size_t>(y) * width + x) * report.channels + c];
+                    sample.maxError = std::max(sample.maxError, std::fabs(host.reference(workload, x, y, c) - actual));
+                }
+            }
+            std::fill(output.begin(), output.end(), 0.0f);
+
+            bool correct = sample.maxError <= kMaxPathError;
+            if(correct && (best.variant.empty() || (sample.nanoseconds.median > 0 && sample.nanoseconds.median < best.nanoseconds))) {
+                best.variant = image2DPathName(path);
+                best.nanoseconds = sample.nanoseconds.median;
+            }
+            report.samples.push_back(sample);
+            clReleaseKernel(kernel);
+        }
+        if(!best.variant.empty()) {
+            database.store(TuningDatabase::makeKey(caps, tuningNameOf(workload), {width, height}), best);
+            selection.recorded = true;
+        }
+        // What a caller of the 2D workload picks from now on.
+        selection.selected = recordedImage2DPath(database, caps, workload, width, height, Image2DPath::Buffer);
+        report.selections.push_back(selection);
+    }
+
+    clReleaseProgram(program);
+    if(inputImage) {
+        clReleaseMemObject(inputImage);
+    }
+    clReleaseMemObject(outputBuffer);
+    clReleaseMemObject(inputBuffer);
+    session.release();
+    return report;
+}
+
+Image2DPath recordedImage2DPath(const TuningDatabase& database, const DeviceCapabilities& caps, Image2DWorkload workload, size_t width,
+                                size_t height, Image2DPath fallback) {
+    TuningRecord record;
+    if(!database.find(TuningDatabase::makeKey(caps, tuningNameOf(workload), {width, height}), record)) {
+        return fallback;
+    }
+    for(auto path : kPaths) {
+        if(record.variant == image2DPathName(path)) {
+            return path;
+        }
+    }
+    return fallback;
+}
+
+void printImage2DReport(const Image2DReport& report) {
+    std::cout << "2D data path " << report.width << " x " << report.height << " " << (report.channels == 1 ? "CL_R" : "CL_RGBA") << " CL_FLOAT, "
+              << report.supportedFormats << " read-only image formats supported" << std::endl;
+    if(!report.imageSkipReason.empty()) {
+        std::cout << "Image path skipped: " << report.imageSkipReason << std::endl;
+    }
+    std::cout << std::left << std::setw(12) << "Workload" << std::setw(10) << "path" << std::right << std::setw(12) << "median ms"
+              << std::setw(10) << "GPix/s" << std::setw(12) << "max error" << std::endl;
+    for(const auto& sample : report.samples) {
+        std::cout << std::left << std::setw(12) << image2DWorkloadName(sample.workload) << std::setw(10) << image2DPathName(sample.path) << std::right
+                  << std::fixed << std::setprecision(3) << std::setw(12) << sample.nanoseconds.median / 1e6
+                  << std::setprecision(2) << std::setw(10) << sample.gigapixelsPerSecond
+                  << std::scientific << std::setprecision(1) << std::setw(12) << sample.maxError
+                  << std::defaultfloat << std::endl;
+    }
+    for(const auto& selection : report.selections) {
+        std::cout << "Selected for " << image2DWorkloadName(selection.workload) << ": " << image2DPathName(selection.selected);
+        if(selection.recorded) {
+            std::cout << " (recorded in the tuning database, previously " << image2DPathName(selection.previous) << ")" << std::endl;
+        }
+        else {
+            std::cout << " (no path within the error tolerance, database unchanged)" << std::endl;
+        }
+    }
+}
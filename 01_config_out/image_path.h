@@ -0,0 +1,76 @@
+#ifndef IMAGE_PATH_H
+#define IMAGE_PATH_H
+
+#include <string>
+#include <vector>
+
+#include <CL/cl.h>
+
+#include "device_inventory.h"
+#include "statistics.h"
+#include "tuning_database.h"
+
+enum class Image2DPath {
+    // Plain __global float buffer, edge clamping and bilinear weights computed in the kernel.
+    Buffer,
+    // read-only image2d_t through a sampler: clamping in the addressing mode, bilinear weights from the filtering hardware.
+    Image,
+};
+
+enum class Image2DWorkload {
+    // 5-point weighted average with clamp-to-edge.
+    Stencil,
+    // Bilinear zoom by 1/kResampleScale around the origin, same output size as the input.
+    Resample,
+};
+
+const char* image2DPathName(Image2DPath path);
+const char* image2DWorkloadName(Image2DWorkload workload);
+
+// The 2D image formats of the context for the given access flags, from clGetSupportedImageFormats. Empty without image support.
+std::vector<cl_image_format> supportedImage2DFormats(cl_context context, cl_mem_flags flags);
+
+struct Image2DSample {
+    Image2DWorkload workload = Image2DWorkload::Stencil;
+    Image2DPath path = Image2DPath::Buffer;
+    Summary nanoseconds;
+    double gigapixelsPerSecond = 0.0;
+    // Largest absolute difference to a host reference over a sample of output pixels. The filtering hardware may interpolate with
+    // reduced weight precision, so the image path of the resample may differ by about 1/256 of the value range.
+    double maxError = 0.0;
+};
+
+// The path choice of one workload: what recordedImage2DPath returned before the run (buffer if never measured) and what it returns now.
+struct Image2DSelection {
+    Image2DWorkload workload = Image2DWorkload::Stencil;
+    Image2DPath previous = Image2DPath::Buffer;
+    Image2DPath selected = Image2DPath::Buffer;
+    // False if no path stayed within the error tolerance, then the database entry is left alone.
+    bool recorded = false;
+};
+
+struct Image2DReport {
+    size_t width = 0;
+    size_t height = 0;
+    // Pixel format both paths use: CL_R/CL_FLOAT if supported, else the CL_RGBA/CL_FLOAT every image capable device supports.
+    size_t channels = 1;
+    size_t supportedFormats = 0;
+    // Why the image path was not measured, empty if it was.
+    std::string imageSkipReason;
+    std::vector<Image2DSample> samples;
+    std::vector<Image2DSelection> selections;
+};
+
+// Run both workloads through both paths on a width x height image, clamped to CL_DEVICE_IMAGE2D_MAX_WIDTH/HEIGHT and
+// CL_DEVICE_MAX_MEM_ALLOC_SIZE, and store the faster path of each workload in the tuning database under the kernel names
+// "stencil2d" and "resample2d". Only a path whose max error is within 1/256 of the value range can win. Devices without image
+// support record the buffer path.
+Image2DReport measureImage2DPaths(const DeviceRecord& record, size_t width, size_t height, TuningDatabase& database, int repetitions);
+
+// The path recorded by measureImage2DPaths for the device, workload and size, fallback if it was never measured.
+Image2DPath recordedImage2DPath(const TuningDatabase& database, const DeviceCapabilities& caps, Image2DWorkload workload, size_t width,
+                                size_t height, Image2DPath fallback);
+
+void printImage2DReport(const Image2DReport& report);
+
+#endif //IMAGE_PATH_H
@@ -0,0 +1,127 @@
+#include "inventory_json.h"
+
+#include <iostream>
+#include <map>
+
+namespace {
+
+const int kInventoryFormat = 1;
+
+// Device identity within a document, see InventoryChange::device.
+std::map<std::string, const JsonValue*> devicesByIdentity(const JsonValue& document) {
+    std::map<std::string, const JsonValue*> devices;
+    std::map<std::string, int> ordinals;
+    auto list = document.find("devices");
+    if(!list) {
+        return devices;
+    }
+    for(const auto& device : list->items) {
+        auto platform = device.find("platform_name");
+        auto name = device.find("name");
+        auto base = (platform ? platform->text : std::string("?")) + "/" + (name ? name->text : std::string("?"));
+        devices[base + "#" + std::to_string(ordinals[base]++)] = &device;
+    }
+    return devices;
+}
+
+}
+
+std::string inventoryToJson(const DeviceInventory& inventory) {
+    JsonWriter json;
+    json.beginObject();
+    json.key("format");
+    json.value(kInventoryFormat);
+
+    json.key("platforms");
+    json.beginArray();
+    for(const auto& platform : inventory.platforms) {
+        json.beginObject();
+        json.key("name");
+        json.value(platform.name);
+        json.key("vendor");
+        json.value(platform.vendor);
+        json.key("version");
+        json.value(platform.version);
+        json.endObject();
+    }
+    json.endArray();
+
+    json.key("devices");
+    json.beginArray();
+    for(const auto& record : inventory.devices) {
+        json.beginObject();
+        json.key("platform_index");
+        json.value(record.platformIndex);
+        visitCapabilityFields([&json](const char* name, const auto& field) {
+            json.key(name);
+            json.value(field);
+        }, record.caps);
+        json.endObject();
+    }
+    json.endArray();
+    json.endObject();
+
+    auto text = json.str();
+    text += '\n';
+    return text;
+}
+
+bool diffInventories(const JsonValue& baseline, const JsonValue& current, std::vector<InventoryChange>& changes, std::string& error) {
+    auto format = baseline.find("format");
+    if(baseline.type != JsonValue::Type::Object || !format || format->text != std::to_string(kInventoryFormat) || !baseline.find("devices")) {
+        error = "not an inventory document of format " + std::to_string(kInventoryFormat);
+        return false;
+    }
+
+    auto before = devicesByIdentity(baseline);
+    auto after = devicesByIdentity(current);
+    for(const auto& entry : before) {
+        auto it = after.find(entry.first);
+        if(it == after.end()) {
+            changes.push_back({entry.first, "", "present", "missing"});
+            continue;
+        }
+        // Every field of the baseline, then fields only the current snapshot has (a newer tool version).
+        for(const auto& member : entry.second->members) {
+            if(member.first == "platform_index") {
+                continue;
+            }
+            auto now = it->second->find(member.first);
+            auto was = member.second.toString();
+            auto is = now ? now->toString() : std::string("missing");
+            if(was != is) {
+                changes.push_back({entry.first, member.first, was, is});
+            }
+        }
+        for(const auto& member : it->second->members) {
+            if(!entry.second->find(member.first)) {
+                changes.push_back({entry.first, member.first, "missing", member.second.toString()});
+            }
+        }
+    }
+    for(const auto& entry : after) {
+        if(!before.count(entry.first)) {
+            changes.push_back({entry.first, "", "missing", "present"});
+        }
+    }
+    return true;
+}
+
+void printInventoryChanges(const std::vector<InventoryChange>& changes, const std::string& baselinePath) {
+    std::string out;
+    if(changes.empty()) {
+        out = "No changes against " + baselinePath + "\n";
+    }
+    else {
+        out = std::to_string(changes.size()) + " change(s) against " + baselinePath + ":\n";
+    }
+    for(const auto& change : changes) {
+        if(change.field.empty()) {
+            out += "  " + change.device + ": device " + (change.after == "present" ? "added" : "removed") + "\n";
+        }
+        else {
+            out += "  " + change.device + ": " + change.field + ": " + change.before + " -> " + change.after + "\n";
+        }
+    }
+    std::cout << out << std::flush;
+}
@@ -0,0 +1,29 @@
+#ifndef INVENTORY_JSON_H
+#define INVENTORY_JSON_H
+
+#include <string>
+#include <vector>
+
+#include "device_inventory.h"
+#include "json.h"
+
+// The whole inventory as one JSON document:
+// {"format":1,"platforms":[{"name":..,"vendor":..,"version":..}],"devices":[{"platform_index":..,<visitCapabilityFields names>}]}
+std::string inventoryToJson(const DeviceInventory& inventory);
+
+struct InventoryChange {
+    // "<platform name>/<device name>#<ordinal among devices of that name>".
+    std::string device;
+    // Empty when the whole device appeared or disappeared.
+    std::string field;
+    std::string before;
+    std::string after;
+};
+
+// Compare two inventory documents field by field. Devices are matched by platform name, device name and ordinal, so a reordered
+// enumeration is not a change but a driver upgrade, fewer compute units or disabled ECC on any node is.
+bool diffInventories(const JsonValue& baseline, const JsonValue& current, std::vector<InventoryChange>& changes, std::string& error);
+
+void printInventoryChanges(const std::vector<InventoryChange>& changes, const std::string& baselinePath);
+
+#endif //INVENTORY_JSON_H
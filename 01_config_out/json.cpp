@@ -0,0 +1,351 @@
+#include "json.h"
+
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+void appendEscaped(std::string& out, const std::string& text) {
+    out += '"';
+    for(unsigned char c : text) {
+        switch(c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if(c < 0x20) {
+                    char escape[8];
+                    snprintf(escape, sizeof(escape), "\\u%04x", c);
+                    out += escape;
+                }
+                else {
+                    out += static_cast<char>(c);
+                }
+        }
+    }
+    out += '"';
+}
+
+class Parser {
+public:
+    explicit Parser(const std::string& text) : text_(text) {}
+
+    bool parse(JsonValue& value, std::string& error) {
+        if(!parseValue(value) || (skipSpace(), pos_ != text_.size())) {
+            error = error_.empty() ? "unexpected trailing characters" : error_;
+            error += " at offset " + std::to_string(pos_);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    void skipSpace() {
+        while(pos_ < text_.size() && (text_[pos_] == ' ' || text_[pos_] == '\n' || text_[pos_] == '\r' || text_[pos_] == '\t')) {
+            ++pos_;
+        }
+    }
+
+    bool fail(const char* message) {
+        error_ = message;
+        return false;
+    }
+
+    bool literal(const char* word) {
+        size_t length = std::char_traits<char>::length(word);
+        if(text_.compare(pos_, length, word) != 0) {
+            return fail("invalid literal");
+        }
+        pos_ += length;
+        return true;
+    }
+
+    bool parseString(std::string& out) {
+        ++pos_;
+        while(pos_ < text_.size() && text_[pos_] != '"') {
+            char c = text_[pos_++];
+            if(c != '\\') {
+                out += c;
+                continue;
+            }
+            if(pos_ >= text_.size()) {
+                break;
+            }
+            char escape = text_[pos_++];
+            switch(escape) {
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'u': {
+                    if(pos_ + 4 > text_.size()) {
+                        return fail("truncated escape");
+                    }
+                    // Only the control characters JsonWriter escapes are decoded, anything else is kept as UTF-8 for code points below 0x800.
+                    unsigned code = std::strtoul(text_.substr(pos_, 4).c_str(), nullptr, 16);
+                    pos_ += 4;
+                    if(code < 0x80) {
+                        out += static_cast<char>(code);
+                    }
+                    else if(code < 0x800) {
+                        out += static_cast<char>(0xC0 | (code >> 6));
+                        out += static_cast<char>(0x80 | (code & 0x3F));
+                    }
+                    else {
+                        out += '?';
+                    }
+                }
+                    break;
+                default: out += escape;
+            }
+        }
+        if(pos_ >= text_.size()) {
+            return fail("unterminated string");
+        }
+        ++pos_;
+        return true;
+    }
+
+    bool parseValue(JsonValue& value) {
+        skipSpace();
+        if(pos_ >= text_.size()) {
+            return fail("unexpected end of input");
+        }
+        char c = text_[pos_];
+        if(c == '{') {
+            value.type = JsonValue::Type::Object;
+            ++pos_;
+            skipSpace();
+            if(pos_ < text_.size() && text_[pos_] == '}') {
+                ++pos_;
+                return true;
+            }
+            while(true) {
+                skipSpace();
+                if(pos_ >= text_.size() || text_[pos_] != '"') {
+                    return fail("expected member name");
+                }
+                std::pair<std::string, JsonValue> member;
+                if(!parseString(member.first)) {
+                    return false;
+                }
+                skipSpace();
+                if(pos_ >= text_.size() || text_[pos_] != ':') {
+                    return fail("expected ':'");
+                }
+                ++pos_;
+                if(!parseValue(member.second)) {
+                    return false;
+                }
+                value.members.push_back(std::move(member));
+                skipSpace();
+                if(pos_ < text_.size() && text_[pos_] == ',') {
+                    ++pos_;
+                    continue;
+                }
+                if(pos_ < text_.size() && text_[pos_] == '}') {
+                    ++pos_;
+                    return true;
+                }
+                return fail("expected ',' or '}'");
+            }
+        }
+        if(c == '[') {
+            value.type = JsonValue::Type::Array;
+            ++pos_;
+            skipSpace();
+            if(pos_ < text_.size() && text_[pos_] == ']') {
+                ++pos_;
+                return true;
+            }
+            while(true) {
+                value.items.emplace_back();
+                if(!parseValue(value.items.back())) {
+                    return false;
+                }
+                skipSpace();
+                if(pos_ < text_.size() && text_[pos_] == ',') {
+                    ++pos_;
+                    continue;
+                }
+                if(pos_ < text_.size() && text_[pos_] == ']') {
+                    ++pos_;
+                    return true;
+                }
+                return fail("expected ',' or ']'");
+            }
+        }
+        if(c == '"') {
+            value.type = JsonValue::Type::String;
+            return parseString(value.text);
+        }
+        if(c == 't' || c == 'f') {
+            value.type = JsonValue::Type::Bool;
+            value.text = c == 't' ? "true" : "false";
+            return literal(value.text.c_str());
+        }
+        if(c == 'n') {
+            value.type = JsonValue::Type::Null;
+            return literal("null");
+        }
+        size_t start = pos_;
+        while(pos_ < text_.size() && (std::isdigit(static_cast<unsigned char>(text_[pos_])) || text_[pos_] == '-' || text_[pos_] == '+'
+                                      || text_[pos_] == '.' || text_[pos_] == 'e' || text_[pos_] == 'E')) {
+            ++pos_;
+        }
+        if(start == pos_) {
+            return fail("unexpected character");
+        }
+        value.type = JsonValue::Type::Number;
+        value.text = text_.substr(start, pos_ - start);
+        return true;
+    }
+
+    const std::string& text_;
+    size_t pos_ = 0;
+    std::string error_;
+};
+
+}
+
+void JsonWriter::separate() {
+    if(afterKey_) {
+        afterKey_ = false;
+        return;
+    }
+    if(!first_.empty()) {
+        if(!first_.back()) {
+            out_ += ',';
+        }
+        first_.back() = false;
+    }
+}
+
+void JsonWriter::open(char bracket) {
+    separate();
+    out_ += bracket;
+    first_.push_back(true);
+}
+
+void JsonWriter::close(char bracket) {
+    out_ += bracket;
+    first_.pop_back();
+}
+
+void JsonWriter::beginObject() {
+    open('{');
+}
+
+void JsonWriter::endObject() {
+    close('}');
+}
+
+void JsonWriter::beginArray() {
+    open('[');
+}
+
+void JsonWriter::endArray() {
+    close(']');
+}
+
+void JsonWriter::key(const std::string& name) {
+    separate();
+    appendEscaped(out_, name);
+    out_ += ':';
+    afterKey_ = true;
+}
+
+void JsonWriter::value(const std::string& text) {
+    separate();
+    appendEscaped(out_, text);
+}
+
+void JsonWriter::value(const char* text) {
+    value(std::string(text));
+}
+
+void JsonWriter::value(bool flag) {
+    separate();
+    out_ += flag ? "true" : "false";
+}
+
+void JsonWriter::value(double number) {
+    separate();
+    char text[32];
+    snprintf(text, sizeof(text), "%.9g", number);
+    out_ += text;
+}
+
+const JsonValue* JsonValue::find(const std::string& name) const {
+    for(const auto& member : members) {
+        if(member.first == name) {
+            return &member.second;
+        }
+    }
+    return nullptr;
+}
+
+double JsonValue::number() const {
+    return std::strtod(text.c_str(), nullptr);
+}
+
+std::string JsonValue::toString() const {
+    switch(type) {
+        case Type::Null:
+            return "null";
+        case Type::Bool:
+        case Type::Number:
+        case Type::String:
+            return text;
+        case Type::Array: {
+            std::string out = "[";
+            for(size_t idx = 0; idx < items.size(); ++idx) {
+                out += (idx ? "," : "") + items[idx].toString();
+            }
+            return out + "]";
+        }
+        case Type::Object: {
+            std::string out = "{";
+            for(size_t idx = 0; idx < members.size(); ++idx) {
+                out += (idx ? "," : "") + members[idx].first + ":" + members[idx].second.toString();
+            }
+            return out + "}";
+        }
+    }
+    return std::string();
+}
+
+bool parseJson(const std::string& text, JsonValue& value, std::string& error) {
+    value = JsonValue();
+    return Parser(text).parse(value, error);
+}
+
+bool writeWholeFile(const std::string& path, const std::string& data) {
+    int fd = path == "-" ? STDOUT_FILENO : open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) {
+        return false;
+    }
+    size_t written = 0;
+    while(written < data.size()) {
+        ssize_t count = write(fd, data.data() + written, data.size() - written);
+        if(count < 0 && errno == EINTR) {
+            continue;
+        }
+        if(count <= 0) {
+            break;
+        }
+        written += static_cast<size_t>(count);
+    }
+    if(fd != STDOUT_FILENO) {
+        close(fd);
+    }
+    return written == data.size();
+}
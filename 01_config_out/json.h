@@ -0,0 +1,79 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Builds a compact JSON document in one string, so the whole document can be written with a single write().
+// Commas are inserted automatically, the caller only pairs begin/end calls and puts key() before every value inside an object.
+class JsonWriter {
+public:
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+    void key(const std::string& name);
+
+    void value(const std::string& text);
+    void value(const char* text);
+    void value(bool flag);
+    void value(double number);
+    template <typename T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+    void value(T number) {
+        separate();
+        out_ += std::to_string(number);
+    }
+    template <typename T>
+    void value(const std::vector<T>& values) {
+        beginArray();
+        for(const auto& v : values) {
+            value(v);
+        }
+        endArray();
+    }
+
+    const std::string& str() const { return out_; }
+
+private:
+    void separate();
+    void open(char bracket);
+    void close(char bracket);
+
+    std::string out_;
+    // One entry per open object/array: true until its first element was written.
+    std::vector<bool> first_;
+    bool afterKey_ = false;
+};
+
+// Parsed JSON document. Numbers keep their text so values written by JsonWriter compare exactly.
+struct JsonValue {
+    enum class Type {
+        Null,
+        Bool,
+        Number,
+        String,
+        Array,
+        Object,
+    };
+
+    Type type = Type::Null;
+    // Number text, string contents, or "true"/"false".
+    std::string text;
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue>> members;
+
+    // Member of an object, nullptr if missing.
+    const JsonValue* find(const std::string& name) const;
+    double number() const;
+    // Scalars as text, arrays and objects re-serialized compactly.
+    std::string toString() const;
+};
+
+bool parseJson(const std::string& text, JsonValue& value, std::string& error);
+
+// Write the whole buffer with write(2), "-" is standard output. Only short writes are repeated.
+bool writeWholeFile(const std::string& path, const std::string& data);
+
+#endif //JSON_H
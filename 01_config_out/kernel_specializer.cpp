@@ -0,0 +1,290 @@
+#include "kernel_specializer.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+#include "device_session.h"
+#include "opencl_utils.h"
+#include "units.h"
+
+namespace {
+
+// Every kernel is written against the defines only, the same source serves the generic and the specialized build.
+const char* kSampleSource = R"CLC(
+#ifdef USE_FP64
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+#endif
+
+// Work-item i handles vectors i, i + stride, ... so neighbouring work-items stay on neighbouring addresses.
+__kernel void saxpy(__global REALV* y, __global const REALV* x, REAL a) {
+    size_t stride = get_global_size(0);
+    size_t i = get_global_id(0);
+    for(int u = 0; u < UNROLL; ++u) {
+        y[i + u * stride] = mad((REALV)(a), x[i + u * stride], y[i + u * stride]);
+    }
+}
+
+__kernel void horner(__global REALV* out, __global const REALV* x) {
+    size_t stride = get_global_size(0);
+    size_t i = get_global_id(0);
+    for(int u = 0; u < UNROLL; ++u) {
+        REALV v = x[i + u * stride];
+        REALV acc = (REALV)(1);
+        for(int k = 0; k < 32; ++k) {
+            acc = mad(acc, v, (REALV)(0.5));
+        }
+        out[i + u * stride] = acc;
+    }
+}
+
+// The tile is padded by one column so the transposed read does not hit the same local memory bank.
+__kernel void transpose(__global REAL* out, __global const REAL* in, uint width, uint height) {
+    __local REAL tile[TILE][TILE + 1];
+    size_t x = get_group_id(0) * TILE + get_local_id(0);
+    size_t y = get_group_id(1) * TILE + get_local_id(1);
+    tile[get_local_id(1)][get_local_id(0)] = in[y * width + x];
+    barrier(CLK_LOCAL_MEM_FENCE);
+    x = get_group_id(1) * TILE + get_local_id(0);
+    y = get_group_id(0) * TILE + get_local_id(1);
+    out[y * height + x] = tile[get_local_id(0)][get_local_id(1)];
+}
+)CLC";
+
+const cl_uint kMaxVectorWidth = 16;
+const size_t kMaxTile = 32;
+// Elements a work-item should cover when its sub-group is too narrow to hide latency across lanes.
+const cl_uint kElementsPerWorkItem = 16;
+// Sub-groups at least this wide are SIMT hardware with many lanes in flight.
+const size_t kWideSubGroup = 16;
+
+size_t typeSize(const std::string& type) {
+    return type == "double" ? sizeof(cl_double) : sizeof(cl_float);
+}
+
+cl_uint floorPowerOfTwo(cl_uint value) {
+    cl_uint power = 1;
+    while(power * 2 <= value) {
+        power *= 2;
+    }
+    return power;
+}
+
+// Largest tile edge the device can launch as a tile x tile work-group.
+size_t tileLimit(const DeviceCapabilities& caps) {
+    size_t limit = kMaxTile;
+    while(limit > 1 && limit * limit > caps.maxWorkGroupSize) {
+        limit /= 2;
+    }
+    for(size_t dim = 0; dim < std::min<size_t>(2, caps.maxWorkItemSizes.size()); ++dim) {
+        while(limit > 1 && limit > caps.maxWorkItemSizes[dim]) {
+            limit /= 2;
+        }
+    }
+    return limit;
+}
+
+// Sub-group width implied by the largest work-group, 0 when CL_DEVICE_MAX_NUM_SUB_GROUPS is not reported.
+size_t subGroupWidth(const DeviceCapabilities& caps) {
+    return caps.maxNumSubGroups > 0 ? caps.maxWorkGroupSize / caps.maxNumSubGroups : 0;
+}
+
+struct SampleBuffers {
+    cl_mem a = nullptr;
+    cl_mem b = nullptr;
+    // Square side of the transpose, side * side elements per buffer.
+    size_t side = 0;
+};
+
+// Device side time of launches of one kernel, after an untimed warm-up launch.
+Summary timeKernel(cl_command_queue queue, cl_kernel kernel, cl_uint dims, const size_t* global, const size_t* local, int repetitions) {
+    std::vector<double> nanoseconds;
+    for(int rep = 0; rep <= repetitions; ++rep) {
+        cl_event event;
+        checkOpenCLError( clEnqueueNDRangeKernel(queue, kernel, dims, nullptr, global, local, 0, nullptr, &event) );
+        checkOpenCLError( clWaitForEvents(1, &event) );
+        auto elapsed = eventElapsedNanoseconds(event);
+        clReleaseEvent(event);
+        if(rep > 0 && elapsed > 0) {
+            nanoseconds.push_back(static_cast<double>(elapsed));
+        }
+    }
+    return summarize(nanoseconds);
+}
+
+// Time one kernel of the sample program built with the specialization. The transpose tile shrinks if the built kernel cannot
+// launch tile x tile work-items (CL_KERNEL_WORK_GROUP_SIZE may be below the device maximum), the specialization is updated to match.
+Summary runSample(const DeviceSession& session, const SampleBuffers& buffers, const std::string& kernelName, KernelSpecialization& specialization,
+                  int repetitions) {
+    const bool fp64 = specialization.type == "double";
+    for(;;) {
+        cl_program program = buildSpecialized(session.context, session.device, kSampleSource, specialization, fp64 ? "-DUSE_FP64" : "");
+        cl_kernel kernel = createKernel(program, kernelName.c_str());
+
+        size_t kernelGroupSize = 0;
+        checkOpenCLError( clGetKernelWorkGroupInfo(kernel, session.device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(kernelGroupSize), &kernelGroupSize, nullptr) );
+        if(kernelName == "transpose" && specialization.tile > 1 && specialization.tile * specialization.tile > kernelGroupSize) {
+            specialization.tile /= 2;
+            clReleaseKernel(kernel);
+            clReleaseProgram(program);
+            continue;
+        }
+
+        Summary summary;
+        size_t elements = buffers.side * buffers.side;
+        if(kernelName == "transpose") {
+            cl_uint side = static_cast<cl_uint>(buffers.side);
+            checkOpenCLError( clSetKernelArg(kernel, 0, sizeof(cl_mem), &buffers.b) );
+            checkOpenCLError( clSetKernelArg(kernel, 1, sizeof(cl_mem), &buffers.a) );
+            checkOpenCLError( clSetKernelArg(kernel, 2, sizeof(cl_uint), &side) );
+            checkOpenCLError( clSetKernelArg(kernel, 3, sizeof(cl_uint), &side) );
+            size_t global[] = {buffers.side, buffers.side};
+            size_t local[] = {specialization.tile, specialization.tile};
+            summary = timeKernel(session.queue, kernel, 2, global, local, repetitions);
+        }
+        else {
+            checkOpenCLError( clSetKernelArg(kernel, 0, sizeof(cl_mem), &buffers.b) );
+            checkOpenCLError( clSetKernelArg(kernel, 1, sizeof(cl_mem), &buffers.a) );
+            if(kernelName == "saxpy") {
+                cl_double a64 = 0.5;
+                cl_float a32 = 0.5f;
+                checkOpenCLError( fp64 ? clSetKernelArg(kernel, 2, sizeof(a64), &a64) : clSetKernelArg(kernel, 2, sizeof(a32), &a32) );
+            }
+            size_t global = elements / (specialization.vectorWidth * specialization.unroll);
+            summary = timeKernel(session.queue, kernel, 1, &global, nullptr, repetitions);
+        }
+
+        clReleaseKernel(kernel);
+        clReleaseProgram(program);
+        return summary;
+    }
+}
+
+}
+
+std::string KernelSpecialization::buildOptions() const {
+    auto vectorType = type + (vectorWidth > 1 ? std::to_string(vectorWidth) : "");
+    return "-DREAL=" + type + " -DREALV=" + vectorType + " -DVECTOR_WIDTH=" + std::to_string(vectorWidth)
+           + " -DUNROLL=" + std::to_string(unroll) + " -DTILE=" + std::to_string(tile);
+}
+
+std::string KernelSpecialization::describe() const {
+    auto vectorType = type + (vectorWidth > 1 ? std::to_string(vectorWidth) : "");
+    auto t = std::to_string(tile);
+    return vectorType + " x" + std::to_string(unroll) + ", tile " + t + "x" + t;
+}
+
+KernelSpecialization genericSpecialization(const DeviceCapabilities& caps, const std::string& type) {
+    KernelSpecialization specialization;
+    specialization.type = type;
+    specialization.tile = std::min<size_t>(8, tileLimit(caps));
+    return specialization;
+}
+
+KernelSpecialization specializeFor(const DeviceCapabilities& caps, const std::string& type) {
+    KernelSpecialization specialization;
+    specialization.type = type;
+
+    cl_uint preferred = type == "double" ? caps.preferredVectorWidthDouble : caps.preferredVectorWidthFloat;
+    cl_uint native = type == "double" ? caps.nativeVectorWidthDouble : caps.nativeVectorWidthFloat;
+    cl_uint width = preferred > 0 ? preferred : native;
+    specialization.vectorWidth = floorPowerOfTwo(std::min(std::max<cl_uint>(width, 1), kMaxVectorWidth));
+
+    auto subGroup = subGroupWidth(caps);
+    bool wideSimt = subGroup >= kWideSubGroup || (subGroup == 0 && (caps.type & CL_DEVICE_TYPE_GPU));
+    if(wideSimt) {
+        specialization.unroll = 2;
+    }
+    else {
+        specialization.unroll = std::min<cl_uint>(8, std::max<cl_uint>(2, kElementsPerWorkItem / specialization.vectorWidth));
+    }
+
+    // Two resident work-groups per compute unit, each with a padded tile x (tile + 1) array.
+    size_t tile = tileLimit(caps);
+    while(tile > 1 && 2 * tile * (tile + 1) * typeSize(type) > caps.localMemSize) {
+        tile /= 2;
+    }
+    specialization.tile = tile;
+    return specialization;
+}
+
+cl_program buildSpecialized(cl_context context, cl_device_id device, const std::string& source, const KernelSpecialization& specialization,
+                            const std::string& extraOptions) {
+    auto options = specialization.buildOptions();
+    if(!extraOptions.empty()) {
+        options += " " + extraOptions;
+    }
+    return buildProgram(context, device, source, options);
+}
+
+double SpecializationSample::speedup() const {
+    return specializedNanoseconds.median > 0 ? genericNanoseconds.median / specializedNanoseconds.median : 0.0;
+}
+
+std::vector<SpecializationSample> measureSpecialization(const DeviceRecord& record, int repetitions) {
+    std::vector<SpecializationSample> samples;
+    const auto& caps = record.caps;
+
+    std::vector<std::string> types = {"float"};
+    if(caps.doubleFpConfig != 0) {
+        types.push_back("double");
+    }
+
+    auto session = DeviceSession::create(record.device);
+    cl_int err;
+
+    // A 2048 x 2048 problem of the widest type, smaller if a buffer of that size cannot be allocated.
+    // Every power-of-two side is a multiple of any vector width x unroll and any tile edge.
+    SampleBuffers buffers;
+    buffers.side = 2048;
+    while(buffers.side > 64 && buffers.side * buffers.side * sizeof(cl_double) > caps.maxMemAllocSize) {
+        buffers.side /= 2;
+    }
+    size_t bytes = buffers.side * buffers.side * sizeof(cl_double);
+    buffers.a = clCreateBuffer(session.context, CL_MEM_READ_WRITE, bytes, nullptr, &err);
+    checkOpenCLError(err);
+    buffers.b = clCreateBuffer(session.context, CL_MEM_READ_WRITE, bytes, nullptr, &err);
+    checkOpenCLError(err);
+    // Zero bits are 0.0 in both precisions, the polynomial stays finite.
+    cl_uchar zero = 0;
+    checkOpenCLError( clEnqueueFillBuffer(session.queue, buffers.a, &zero, sizeof(zero), 0, bytes, 0, nullptr, nullptr) );
+    checkOpenCLError( clEnqueueFillBuffer(session.queue, buffers.b, &zero, sizeof(zero), 0, bytes, 0, nullptr, nullptr) );
+    checkOpenCLError( clFinish(session.queue) );
+
+    for(const auto& type : types) {
+        for(const char* kernelName : {"saxpy", "horner", "transpose"}) {
+            SpecializationSample sample;
+            sample.kernelName = kernelName;
+            sample.generic = genericSpecialization(caps, type);
+            sample.specialized = specializeFor(caps, type);
+            sample.genericNanoseconds = runSample(session, buffers, kernelName, sample.generic, repetitions);
+            sample.specializedNanoseconds = runSample(session, buffers, kernelName, sample.specialized, repetitions);
+            samples.push_back(sample);
+        }
+    }
+
+    clReleaseMemObject(buffers.b);
+    clReleaseMemObject(buffers.a);
+    session.release();
+    return samples;
+}
+
+void printSpecializationReport(const DeviceRecord& record, const std::vector<SpecializationSample>& samples) {
+    const auto& caps = record.caps;
+    auto subGroup = subGroupWidth(caps);
+    std::cout << "Preferred/native vector width float " << caps.preferredVectorWidthFloat << "/" << caps.nativeVectorWidthFloat
+              << ", double " << caps.preferredVectorWidthDouble << "/" << caps.nativeVectorWidthDouble
+              << ", sub-group width " << (subGroup > 0 ? std::to_string(subGroup) : "unknown")
+              << ", local memory " << formatBytes(caps.localMemSize) << std::endl;
+
+    std::cout << std::left << std::setw(11) << "Kernel" << std::setw(24) << "Generic" << std::setw(24) << "Specialized" << std::right
+              << std::setw(13) << "generic us" << std::setw(13) << "special. us" << std::setw(9) << "speedup" << std::endl;
+    for(const auto& sample : samples) {
+        std::cout << std::left << std::setw(11) << sample.kernelName << std::setw(24) << sample.generic.describe()
+                  << std::setw(24) << sample.specialized.describe() << std::right
+                  << std::fixed << std::setprecision(1)
+                  << std::setw(13) << sample.genericNanoseconds.median / 1e3 << std::setw(13) << sample.specializedNanoseconds.median / 1e3
+                  << std::setprecision(2) << std::setw(8) << sample.speedup() << "x"
+                  << std::defaultfloat << std::endl;
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef KERNEL_SPECIALIZER_H
+#define KERNEL_SPECIALIZER_H
+
+#include <string>
+#include <vector>
+
+#include <CL/cl.h>
+
+#include "device_inventory.h"
+#include "statistics.h"
+
+// Compile-time shape of a kernel, passed to the OpenCL C compiler as -D defines:
+// REAL (scalar type), REALV (vector type), VECTOR_WIDTH, UNROLL (vectors per work-item) and TILE (edge of a square local memory tile).
+struct KernelSpecialization {
+    // "float" or "double".
+    std::string type = "float";
+    cl_uint vectorWidth = 1;
+    cl_uint unroll = 1;
+    size_t tile = 8;
+
+    std::string buildOptions() const;
+    // e.g. "float4 x2, tile 16x16".
+    std::string describe() const;
+};
+
+// The neutral build every kernel gets without knowing the device: scalar, no unrolling, an 8x8 tile (smaller only if the device cannot
+// launch 64 work-items in a group).
+KernelSpecialization genericSpecialization(const DeviceCapabilities& caps, const std::string& type);
+
+// Shape the defines to the device:
+// - vector width from CL_DEVICE_PREFERRED_VECTOR_WIDTH_<type>, falling back to the native width when the preferred one is not reported;
+// - unroll from the sub-group width (CL_DEVICE_MAX_WORK_GROUP_SIZE / CL_DEVICE_MAX_NUM_SUB_GROUPS): wide SIMT sub-groups already hide
+//   latency across lanes and only unroll by 2, narrow or unknown sub-groups unroll until a work-item covers 16 elements;
+// - tile as the largest power of two whose padded tile leaves room for two resident work-groups in CL_DEVICE_LOCAL_MEM_SIZE and
+//   whose tile x tile work-items fit CL_DEVICE_MAX_WORK_GROUP_SIZE and CL_DEVICE_MAX_WORK_ITEM_SIZES.
+KernelSpecialization specializeFor(const DeviceCapabilities& caps, const std::string& type);
+
+// Build source with the defines of the specialization prepended to extraOptions. Exits on a build failure, like buildProgram.
+cl_program buildSpecialized(cl_context context, cl_device_id device, const std::string& source, const KernelSpecialization& specialization,
+                            const std::string& extraOptions = "");
+
+struct SpecializationSample {
+    std::string kernelName;
+    KernelSpecialization generic;
+    KernelSpecialization specialized;
+    // Device side time of one launch over the whole problem.
+    Summary genericNanoseconds;
+    Summary specializedNanoseconds;
+
+    // Median generic time over median specialized time, above 1 when the specialized build is faster.
+    double speedup() const;
+};
+
+// Time the sample kernels (vectorized saxpy, a Horner polynomial and a local memory tiled transpose) built generically and specialized
+// for the device, in float and, when CL_DEVICE_DOUBLE_FP_CONFIG is non-zero, in double.
+std::vector<SpecializationSample> measureSpecialization(const DeviceRecord& record, int repetitions);
+
+void printSpecializationReport(const DeviceRecord& record, const std::vector<SpecializationSample>& samples);
+
+#endif //KERNEL_SPECIALIZER_H
@@ -0,0 +1,171 @@
+#include "latency_probe.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+#include "opencl_utils.h"
+#include "statistics.h"
+
+namespace {
+
+const char* kLatencySource = R"CLC(
+__kernel void empty_kernel() {
+}
+
+__kernel void tiny_kernel(__global int* out) {
+    out[get_global_id(0)] = (int)get_global_id(0);
+}
+)CLC";
+
+// Launches per back-to-back burst.
+const int kBurstSize = 64;
+
+double microsecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() / 1000.0;
+}
+
+cl_ulong profilingInfo(cl_event event, cl_profiling_info param) {
+    cl_ulong value;
+    checkOpenCLError( clGetEventProfilingInfo(event, param, sizeof(value), &value, nullptr) );
+    return value;
+}
+
+void measureKernel(const DeviceSession& session, cl_kernel kernel, size_t items, const std::string& label, int iterations, std::vector<LatencySeries>& series) {
+    LatencySeries queuedToSubmit{label + " queued->submit", {}};
+    LatencySeries submitToStart{label + " submit->start", {}};
+    LatencySeries startToEnd{label + " start->end", {}};
+    LatencySeries enqueueCall{label + " enqueue call", {}};
+    LatencySeries backToBack{label + " back-to-back", {}};
+    LatencySeries finishRoundTrip{label + " enqueue+clFinish", {}};
+    LatencySeries waitRoundTrip{label + " enqueue+clWaitForEvents", {}};
+
+    // Warm-up, the first launch of a kernel often pays for lazy code upload.
+    checkOpenCLError( clEnqueueNDRangeKernel(session.queue, kernel, 1, nullptr, &items, nullptr, 0, nullptr, nullptr) );
+    checkOpenCLError( clFinish(session.queue) );
+
+    for(int it = 0; it < iterations; ++it) {
+        cl_event event;
+        checkOpenCLError( clEnqueueNDRangeKernel(session.queue, kernel, 1, nullptr, &items, nullptr, 0, nullptr, &event) );
+        checkOpenCLError( clWaitForEvents(1, &event) );
+        auto queued = profilingInfo(event, CL_PROFILING_COMMAND_QUEUED);
+        auto submit = profilingInfo(event, CL_PROFILING_COMMAND_SUBMIT);
+        auto start = profilingInfo(event, CL_PROFILING_COMMAND_START);
+        auto end = profilingInfo(event, CL_PROFILING_COMMAND_END);
+        clReleaseEvent(event);
+        queuedToSubmit.microseconds.push_back((submit - queued) / 1000.0);
+        submitToStart.microseconds.push_back((start - submit) / 1000.0);
+        startToEnd.microseconds.push_back((end - start) / 1000.0);
+    }
+
+    for(int it = 0; it < std::max(1, iterations / kBurstSize); ++it) {
+        auto burstStart = std::chrono::steady_clock::now();
+        for(int launch = 0; launch < kBurstSize; ++launch) {
+            auto callStart = std::chrono::steady_clock::now();
+            checkOpenCLError( clEnqueueNDRangeKernel(session.queue, kernel, 1, nullptr, &items, nullptr, 0, nullptr, nullptr) );
+            enqueueCall.microseconds.push_back(microsecondsSince(callStart));
+        }
+        checkOpenCLError( clFinish(session.queue) );
+        backToBack.microseconds.push_back(microsecondsSince(burstStart) / kBurstSize);
+    }
+
+    for(int it = 0; it < iterations; ++it) {
+        auto start = std::chrono::steady_clock::now();
+        checkOpenCLError( clEnqueueNDRangeKernel(session.queue, kernel, 1, nullptr, &items, nullptr, 0, nullptr, nullptr) );
+        checkOpenCLError( clFinish(session.queue) );
+        finishRoundTrip.microseconds.push_back(microsecondsSince(start));
+    }
+
+    for(int it = 0; it < iterations; ++it) {
+        waitRoundTrip.microseconds.push_back(launchRoundTripMicroseconds(session, kernel, items));
+    }
+
+    series.push_back(queuedToSubmit);
+    series.push_back(submitToStart);
+    series.push_back(startToEnd);
+    series.push_back(enqueueCall);
+    series.push_back(backToBack);
+    series.push_back(finishRoundTrip);
+    series.push_back(waitRoundTrip);
+}
+
+}
+
+std::vector<LatencySeries> measureLatency(const DeviceRecord& record, int iterations) {
+    std::vector<LatencySeries> series;
+
+    auto session = DeviceSession::create(record.device);
+    cl_program program = buildProgram(session.context, record.device, latencyProbeSource());
+    cl_kernel emptyKernel = createKernel(program, "empty_kernel");
+    cl_kernel tinyKernel = createKernel(program, "tiny_kernel");
+    cl_int err;
+
+    // One work-group worth of stores for the near-empty kernel.
+    size_t tinyItems = std::min<size_t>(64, std::max<size_t>(1, record.caps.maxWorkGroupSize));
+    cl_mem out = clCreateBuffer(session.context, CL_MEM_WRITE_ONLY, tinyItems * sizeof(cl_int), nullptr, &err);
+    checkOpenCLError(err);
+    checkOpenCLError( clSetKernelArg(tinyKernel, 0, sizeof(cl_mem), &out) );
+
+    measureKernel(session, emptyKernel, 1, "empty", iterations, series);
+    measureKernel(session, tinyKernel, tinyItems, "tiny", iterations, series);
+
+    clReleaseMemObject(out);
+    clReleaseKernel(tinyKernel);
+    clReleaseKernel(emptyKernel);
+    clReleaseProgram(program);
+    session.release();
+    return series;
+}
+
+std::string latencyProbeSource() {
+    return kLatencySource;
+}
+
+double launchRoundTripMicroseconds(const DeviceSession& session, cl_kernel kernel, size_t items) {
+    auto start = std::chrono::steady_clock::now();
+    cl_event event;
+    checkOpenCLError( clEnqueueNDRangeKernel(session.queue, kernel, 1, nullptr, &items, nullptr, 0, nullptr, &event) );
+    // clWaitForEvents implicitly flushes the queue the event belongs to.
+    checkOpenCLError( clWaitForEvents(1, &event) );
+    double microseconds = microsecondsSince(start);
+    clReleaseEvent(event);
+    return microseconds;
+}
+
+void printLatencyReport(const std::vector<LatencySeries>& series) {
+    const int barWidth = 40;
+
+    for(const auto& s : series) {
+        auto sorted = s.microseconds;
+        std::sort(sorted.begin(), sorted.end());
+        if(sorted.empty()) {
+            continue;
+        }
+        std::cout << s.name << " (" << sorted.size() << " samples, us): "
+                  << std::fixed << std::setprecision(2)
+                  << "p50 " << percentile(sorted, 50) << " | p90 " << percentile(sorted, 90) << " | p99 " << percentile(sorted, 99)
+                  << " | p99.9 " << percentile(sorted, 99.9) << " | max " << sorted.back() << std::defaultfloat << std::endl;
+
+        // Power of two buckets: [0, 1) us, [1, 2) us, [2, 4) us, ...
+        std::vector<size_t> buckets;
+        for(auto value : sorted) {
+            size_t bucket = value < 1.0 ? 0 : static_cast<size_t>(std::floor(std::log2(value))) + 1;
+            if(bucket >= buckets.size()) {
+                buckets.resize(bucket + 1, 0);
+            }
+            ++buckets[bucket];
+        }
+        size_t largest = *std::max_element(buckets.begin(), buckets.end());
+        for(size_t bucket = 0; bucket < buckets.size(); ++bucket) {
+            if(buckets[bucket] == 0) {
+                continue;
+            }
+            double low = bucket == 0 ? 0.0 : std::ldexp(1.0, static_cast<int>(bucket) - 1);
+            double high = std::ldexp(1.0, static_cast<int>(bucket));
+            std::cout << "    [" << std::setw(8) << low << ", " << std::setw(8) << high << ") us " << std::setw(7) << buckets[bucket] << " "
+                      << std::string(std::max<size_t>(1, buckets[bucket] * barWidth / largest), '#') << std::endl;
+        }
+    }
+}
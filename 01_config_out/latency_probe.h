@@ -0,0 +1,33 @@
+#ifndef LATENCY_PROBE_H
+#define LATENCY_PROBE_H
+
+#include <string>
+#include <vector>
+
+#include "device_inventory.h"
+#include "device_session.h"
+
+// Latencies of one measurement, in microseconds, one entry per launch.
+struct LatencySeries {
+    std::string name;
+    std::vector<double> microseconds;
+};
+
+// Time empty and near-empty (one store) kernel launches on a profiling queue:
+//      queued->submit, submit->start, start->end   CL_QUEUE_PROFILING_ENABLE timestamps of single synchronized launches
+//      enqueue call                                host time spent inside clEnqueueNDRangeKernel while launching back-to-back
+//      back-to-back                                wall clock of a burst of launches divided by the burst size
+//      enqueue+clFinish                            host round trip, synchronized with clFinish
+//      enqueue+clWaitForEvents                     host round trip, synchronized on the launch event
+std::vector<LatencySeries> measureLatency(const DeviceRecord& record, int iterations);
+
+// OpenCL C source of the probe's kernels: empty_kernel() and tiny_kernel(__global int* out), one store per work-item.
+std::string latencyProbeSource();
+
+// Host round trip of one launch of kernel over items work-items, synchronized on the launch event, in microseconds.
+double launchRoundTripMicroseconds(const DeviceSession& session, cl_kernel kernel, size_t items);
+
+// Percentiles and a log2-bucket histogram per series.
+void printLatencyReport(const std::vector<LatencySeries>& series);
+
+#endif //LATENCY_PROBE_H
@@ -0,0 +1,312 @@
+#include "multi_device_scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <thread>
+
+#include "opencl_utils.h"
+
+namespace {
+
+const char* kMandelbrotSource = R"CLC(
+__kernel void mandelbrot(__global uint* out, uint width, uint height, uint maxIterations) {
+    size_t x = get_global_id(0);
+    size_t y = get_global_id(1);
+    float cr = -2.0f + 2.5f * x / width;
+    float ci = -1.25f + 2.5f * y / height;
+    float zr = 0.0f, zi = 0.0f;
+    uint it = 0;
+    while(it < maxIterations && zr * zr + zi * zi < 4.0f) {
+        float t = zr * zr - zi * zi + cr;
+        zi = 2.0f * zr * zi + ci;
+        zr = t;
+        ++it;
+    }
+    out[(y - get_global_offset(1)) * get_global_size(0) + x] = it;
+}
+)CLC";
+
+const cl_uint kMandelbrotIterations = 512;
+
+struct Chunk {
+    size_t begin = 0;
+    size_t end = 0;
+};
+
+size_t unitsOf(const SplitRange& range) {
+    return range.dims == 1 ? range.width : range.height;
+}
+
+// Bytes of output per unit of the split: one item in 1D, one row in 2D.
+size_t unitBytes(const SplitRange& range, size_t elementBytes) {
+    return (range.dims == 1 ? 1 : range.width) * elementBytes;
+}
+
+}
+
+MultiDeviceScheduler::MultiDeviceScheduler(const std::vector<cl_device_id>& devices, const std::string& source, const std::string& kernelName,
+                                           const std::string& options) {
+    cl_int err;
+    context_ = clCreateContext(nullptr, static_cast<cl_uint>(devices.size()), devices.data(), nullptr, nullptr, &err);
+    checkOpenCLError(err);
+    const char* sources[] = {source.c_str()};
+    const size_t lengths[] = {source.size()};
+    program_ = clCreateProgramWithSource(context_, 1, sources, lengths, &err);
+    checkOpenCLError(err);
+    checkOpenCLError( clBuildProgram(program_, static_cast<cl_uint>(devices.size()), devices.data(), options.c_str(), nullptr, nullptr) );
+
+    lanes_.resize(devices.size());
+    for(size_t idx = 0; idx < devices.size(); ++idx) {
+        auto& lane = lanes_[idx];
+        lane.device = devices[idx];
+        lane.name = getDeviceInfoString(lane.device, CL_DEVICE_NAME);
+        lane.queue = clCreateCommandQueueWithProperties(context_, lane.device, nullptr, &err);
+        checkOpenCLError(err);
+        lane.kernel = clCreateKernel(program_, kernelName.c_str(), &err);
+        checkOpenCLError(err);
+    }
+}
+
+MultiDeviceScheduler::~MultiDeviceScheduler() {
+    for(auto& lane : lanes_) {
+        if(lane.scratch) {
+            clReleaseMemObject(lane.scratch);
+        }
+        clReleaseKernel(lane.kernel);
+        clReleaseCommandQueue(lane.queue);
+    }
+    clReleaseProgram(program_);
+    clReleaseContext(context_);
+}
+
+void MultiDeviceScheduler::setArg(cl_uint index, size_t size, const void* value) {
+    for(auto& lane : lanes_) {
+        checkOpenCLError( clSetKernelArg(lane.kernel, index, size, value) );
+    }
+}
+
+void MultiDeviceScheduler::runChunk(Lane& lane, const SplitRange& range, size_t elementBytes, size_t begin, size_t end, char* output) {
+    size_t bytes = (end - begin) * unitBytes(range, elementBytes);
+    if(bytes > lane.scratchBytes) {
+        if(lane.scratch) {
+            clReleaseMemObject(lane.scratch);
+        }
+        cl_int err;
+        lane.scratch = clCreateBuffer(context_, CL_MEM_WRITE_ONLY, bytes, nullptr, &err);
+        checkOpenCLError(err);
+        lane.scratchBytes = bytes;
+    }
+    checkOpenCLError( clSetKernelArg(lane.kernel, 0, sizeof(cl_mem), &lane.scratch) );
+
+    size_t offset[2] = {0, 0};
+    size_t global[2] = {range.width, range.height};
+    if(range.dims == 1) {
+        offset[0] = begin;
+        global[0] = end - begin;
+    }
+    else {
+        offset[1] = begin;
+        global[1] = end - begin;
+    }
+    checkOpenCLError( clEnqueueNDRangeKernel(lane.queue, lane.kernel, range.dims, offset, global, nullptr, 0, nullptr, nullptr) );
+    // The in-order queue runs the read after the kernel, and the blocking read keeps the scratch buffer free for the next chunk.
+    checkOpenCLError( clEnqueueReadBuffer(lane.queue, lane.scratch, CL_TRUE, 0, bytes, output + begin * unitBytes(range, elementBytes), 0, nullptr, nullptr) );
+}
+
+void MultiDeviceScheduler::calibrate(const SplitRange& range, size_t elementBytes) {
+    size_t units = std::max<size_t>(1, unitsOf(range) / 16);
+    std::vector<char> output(units * unitBytes(range, elementBytes));
+    size_t items = units * (range.dims == 1 ? 1 : range.width);
+    for(auto& lane : lanes_) {
+        // The first run is an untimed warm-up which also absorbs lazy compilation and the scratch allocation.
+        runChunk(lane, range, elementBytes, 0, units, output.data());
+        auto start = std::chrono::steady_clock::now();
+        runChunk(lane, range, elementBytes, 0, units, output.data());
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        lane.throughput = seconds > 0 ? items / seconds : 0.0;
+    }
+}
+
+SplitReport MultiDeviceScheduler::run(const SplitRange& range, size_t elementBytes, void* output, size_t chunksPerDevice) {
+    SplitReport report;
+    size_t units = unitsOf(range);
+    size_t chunkCount = std::max<size_t>(1, std::min(units, lanes_.size() * std::max<size_t>(1, chunksPerDevice)));
+    report.chunks = chunkCount;
+    report.devices.resize(lanes_.size());
+
+    // Contiguous runs of chunks, each device's run proportional to its weight. Without calibration every device weighs the same.
+    std::vector<double> weights;
+    for(const auto& lane : lanes_) {
+        weights.push_back(lane.throughput);
+    }
+    double total = std::accumulate(weights.begin(), weights.end(), 0.0);
+    if(total <= 0) {
+        std::fill(weights.begin(), weights.end(), 1.0);
+        total = static_cast<double>(weights.size());
+    }
+    std::vector<std::deque<Chunk>> queues(lanes_.size());
+    double cumulative = 0.0;
+    size_t next = 0;
+    for(size_t idx = 0; idx < lanes_.size(); ++idx) {
+        cumulative += weights[idx];
+        size_t last = idx + 1 == lanes_.size() ? chunkCount : static_cast<size_t>(cumulative / total * chunkCount + 0.5);
+        for(; next < last; ++next) {
+            queues[idx].push_back({next * units / chunkCount, (next + 1) * units / chunkCount});
+        }
+        report.devices[idx].name = lanes_[idx].name;
+        report.devices[idx].throughput = lanes_[idx].throughput;
+        report.devices[idx].assignedChunks = queues[idx].size();
+    }
+
+    // A single lock over every queue: taking a chunk is rare next to running one.
+    std::mutex mutex;
+    auto take = [&](size_t self, Chunk& chunk, bool& stolen) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(!queues[self].empty()) {
+            chunk = queues[self].front();
+            queues[self].pop_front();
+            stolen = false;
+            return true;
+        }
+        size_t victim = self;
+        for(size_t idx = 0; idx < queues.size(); ++idx) {
+            if(queues[idx].size() > queues[victim].size()) {
+                victim = idx;
+            }
+        }
+        if(queues[victim].empty()) {
+            return false;
+        }
+        // The back of the victim's run is the part it would reach last.
+        chunk = queues[victim].back();
+        queues[victim].pop_back();
+        stolen = true;
+        return true;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for(size_t idx = 0; idx < lanes_.size(); ++idx) {
+        workers.emplace_back([&, idx]() {
+            auto& share = report.devices[idx];
+            Chunk chunk;
+            bool stolen = false;
+            while(take(idx, chunk, stolen)) {
+                auto chunkStart = std::chrono::steady_clock::now();
+                runChunk(lanes_[idx], range, elementBytes, chunk.begin, chunk.end, static_cast<char*>(output));
+                share.busySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - chunkStart).count();
+                share.executedChunks += 1;
+                share.stolenChunks += stolen ? 1 : 0;
+                share.items += (chunk.end - chunk.begin) * (range.dims == 1 ? 1 : range.width);
+            }
+        });
+    }
+    for(auto& worker : workers) {
+        worker.join();
+    }
+    report.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return report;
+}
+
+std::vector<ScalingSample> measureMultiDeviceScaling(const DeviceInventory& inventory, size_t platformIndex, size_t width, size_t height,
+                                                     int repetitions) {
+    std::vector<ScalingSample> samples;
+    std::vector<cl_device_id> devices;
+    for(const auto& record : inventory.devices) {
+        if(record.platformIndex == platformIndex) {
+            devices.push_back(record.device);
+        }
+    }
+    if(devices.empty()) {
+        return samples;
+    }
+
+    SplitRange range;
+    range.dims = 2;
+    range.width = width;
+    range.height = height;
+    cl_uint argWidth = static_cast<cl_uint>(width), argHeight = static_cast<cl_uint>(height), iterations = kMandelbrotIterations;
+    std::vector<cl_uint> image(width * height);
+
+    // Order the devices fastest first so every step of the sweep adds the next best device.
+    {
+        MultiDeviceScheduler scheduler(devices, kMandelbrotSource, "mandelbrot");
+        scheduler.setArg(1, sizeof(cl_uint), &argWidth);
+        scheduler.setArg(2, sizeof(cl_uint), &argHeight);
+        scheduler.setArg(3, sizeof(cl_uint), &iterations);
+        scheduler.calibrate(range, sizeof(cl_uint));
+        std::vector<size_t> order(devices.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&scheduler](size_t a, size_t b) { return scheduler.throughput(a) > scheduler.throughput(b); });
+        std::vector<cl_device_id> sorted;
+        for(auto idx : order) {
+            sorted.push_back(devices[idx]);
+        }
+        devices = sorted;
+    }
+
+    for(size_t count = 1; count <= devices.size(); ++count) {
+        std::vector<cl_device_id> subset(devices.begin(), devices.begin() + count);
+        MultiDeviceScheduler scheduler(subset, kMandelbrotSource, "mandelbrot");
+        scheduler.setArg(1, sizeof(cl_uint), &argWidth);
+        scheduler.setArg(2, sizeof(cl_uint), &argHeight);
+        scheduler.setArg(3, sizeof(cl_uint), &iterations);
+        scheduler.calibrate(range, sizeof(cl_uint));
+
+        ScalingSample sample;
+        std::vector<double> seconds;
+        // The first run is an untimed warm-up.
+        for(int rep = 0; rep <= repetitions; ++rep) {
+            auto report = scheduler.run(range, sizeof(cl_uint), image.data());
+            if(rep > 0) {
+                seconds.push_back(report.wallSeconds);
+            }
+            sample.split = report;
+        }
+        sample.seconds = summarize(seconds);
+        for(const auto& share : sample.split.devices) {
+            sample.devices.push_back(share.name);
+        }
+        sample.speedup = sample.seconds.median > 0 && !samples.empty() ? samples.front().seconds.median / sample.seconds.median : 1.0;
+        samples.push_back(sample);
+    }
+    return samples;
+}
+
+void printMultiDeviceReport(const std::vector<ScalingSample>& samples) {
+    if(samples.empty()) {
+        std::cout << "No devices on the platform" << std::endl;
+        return;
+    }
+    std::cout << std::setw(8) << "Devices" << std::setw(12) << "median ms" << std::setw(10) << "min ms" << std::setw(10) << "speedup"
+              << std::setw(12) << "efficiency" << std::endl;
+    for(const auto& sample : samples) {
+        auto count = sample.devices.size();
+        std::cout << std::setw(8) << count << std::fixed << std::setprecision(2)
+                  << std::setw(12) << sample.seconds.median * 1e3 << std::setw(10) << sample.seconds.min * 1e3
+                  << std::setw(9) << sample.speedup << "x" << std::setw(11) << sample.speedup / count * 100 << "%"
+                  << std::defaultfloat << std::endl;
+    }
+
+    const auto& last = samples.back().split;
+    std::cout << "Split of the last run over " << last.chunks << " chunks:" << std::endl;
+    std::cout << std::left << std::setw(24) << "Device" << std::right << std::setw(14) << "Mitems/s" << std::setw(10) << "assigned"
+              << std::setw(10) << "executed" << std::setw(8) << "stolen" << std::setw(10) << "share" << std::setw(10) << "busy" << std::endl;
+    uint64_t totalItems = 0;
+    for(const auto& share : last.devices) {
+        totalItems += share.items;
+    }
+    for(const auto& share : last.devices) {
+        std::cout << std::left << std::setw(24) << share.name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(14) << share.throughput / 1e6 << std::setw(10) << share.assignedChunks << std::setw(10) << share.executedChunks
+                  << std::setw(8) << share.stolenChunks
+                  << std::setw(9) << (totalItems > 0 ? 100.0 * share.items / totalItems : 0.0) << "%"
+                  << std::setw(9) << (last.wallSeconds > 0 ? 100.0 * share.busySeconds / last.wallSeconds : 0.0) << "%"
+                  << std::defaultfloat << std::endl;
+    }
+}
@@ -0,0 +1,107 @@
+#ifndef MULTI_DEVICE_SCHEDULER_H
+#define MULTI_DEVICE_SCHEDULER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <CL/cl.h>
+
+#include "device_inventory.h"
+#include "statistics.h"
+
+// The NDRange to split. 1D ranges are cut into runs of items, 2D ranges into bands of full rows.
+struct SplitRange {
+    cl_uint dims = 1;
+    // Items in dimension 0 and, for 2D, rows in dimension 1.
+    size_t width = 0;
+    size_t height = 1;
+};
+
+struct DeviceShare {
+    std::string name;
+    // Items per second measured by calibrate(), 0 before calibration.
+    double throughput = 0.0;
+    // Chunks dealt to the device up front, chunks it ran in the end and how many of those it stole from other devices.
+    size_t assignedChunks = 0;
+    size_t executedChunks = 0;
+    size_t stolenChunks = 0;
+    uint64_t items = 0;
+    // Time the device's worker spent running chunks, launch to read-back.
+    double busySeconds = 0.0;
+};
+
+struct SplitReport {
+    std::vector<DeviceShare> devices;
+    size_t chunks = 0;
+    double wallSeconds = 0.0;
+};
+
+// Splits one NDRange of a kernel across several devices of a platform.
+// The kernel contract: argument 0 is the output and is bound by the scheduler to a per-device buffer holding exactly one chunk, the kernel is
+// launched with the chunk origin as global work offset and writes out[get_global_id(0) - get_global_offset(0)] (1D) or
+// out[(get_global_id(1) - get_global_offset(1)) * get_global_size(0) + get_global_id(0)] (2D). Every other argument is the same on all devices.
+class MultiDeviceScheduler {
+public:
+    // One context over the devices, which must belong to the same platform, the program built for all of them and one in-order queue each.
+    MultiDeviceScheduler(const std::vector<cl_device_id>& devices, const std::string& source, const std::string& kernelName,
+                         const std::string& options = "");
+    ~MultiDeviceScheduler();
+
+    MultiDeviceScheduler(const MultiDeviceScheduler&) = delete;
+    MultiDeviceScheduler& operator=(const MultiDeviceScheduler&) = delete;
+
+    // Input buffers passed to setArg must be created in this context.
+    cl_context context() const { return context_; }
+    size_t deviceCount() const { return lanes_.size(); }
+    // Items per second of the device measured by calibrate(), 0 before calibration.
+    double throughput(size_t device) const { return lanes_[device].throughput; }
+
+    // Set argument index (1 or above) on the kernel of every device.
+    void setArg(cl_uint index, size_t size, const void* value);
+
+    // Run the first 1/16th of the range on each device in turn, after a warm-up run, and keep the items per second as split weights.
+    void calibrate(const SplitRange& range, size_t elementBytes);
+
+    // Run the whole range into output (width * height elements of elementBytes, row-major). The range is cut into chunksPerDevice chunks per
+    // device, dealt out in contiguous runs proportional to the calibrated throughput (equal shares before calibrate()). A device whose run is
+    // exhausted steals chunks from the back of the device with the most chunks left. Every chunk is read back to its place in output.
+    SplitReport run(const SplitRange& range, size_t elementBytes, void* output, size_t chunksPerDevice = 16);
+
+private:
+    struct Lane {
+        cl_device_id device = nullptr;
+        std::string name;
+        cl_command_queue queue = nullptr;
+        cl_kernel kernel = nullptr;
+        cl_mem scratch = nullptr;
+        size_t scratchBytes = 0;
+        double throughput = 0.0;
+    };
+
+    // Launch rows/items [begin, end) on the lane and read the result back into output. Only ever called from the lane's own thread.
+    void runChunk(Lane& lane, const SplitRange& range, size_t elementBytes, size_t begin, size_t end, char* output);
+
+    cl_context context_ = nullptr;
+    cl_program program_ = nullptr;
+    std::vector<Lane> lanes_;
+};
+
+struct ScalingSample {
+    // Devices in use, fastest first.
+    std::vector<std::string> devices;
+    Summary seconds;
+    // Median time of the fastest single device over the median time of this set.
+    double speedup = 0.0;
+    // Split of the last run.
+    SplitReport split;
+};
+
+// Render a width x height Mandelbrot set (uneven per-row cost, which the work stealing has to even out) on the fastest device of the platform,
+// then on the two fastest and so on up to every device of the platform. Devices of different platforms cannot share a context.
+std::vector<ScalingSample> measureMultiDeviceScaling(const DeviceInventory& inventory, size_t platformIndex, size_t width, size_t height,
+                                                     int repetitions);
+
+void printMultiDeviceReport(const std::vector<ScalingSample>& samples);
+
+#endif //MULTI_DEVICE_SCHEDULER_H
@@ -0,0 +1,62 @@
+#ifndef OPENCL_UTILS_H
+#define OPENCL_UTILS_H
+
+#include <string>
+#include <vector>
+
+#include <CL/cl.h>
+
+// Every OpenCL call below and in the files including this header goes through the tracing wrappers.
+#include "cl_trace.h"
+
+const char* getOpenCLErrorString(cl_int error);
+void checkOpenCLError(cl_int error);
+
+// Append the flag name to str when the flag value is set in the bitfield info, separated by " : ".
+template <typename T>
+void appendBitfield(T info, T value, const std::string& name, std::string& str) {
+    if (info & value) {
+        if (str.length() > 0) {
+            str.append(" : ");
+        }
+        str.append(name);
+    }
+}
+
+// Query a NUL-terminated string parameter of a platform or a device. The value is read into a per-thread buffer that is reused across
+// calls, so the common case is a single query call; only a string longer than any seen before costs an extra size query and a resize.
+std::string getPlatformInfoString(cl_platform_id platform, cl_platform_info param_name);
+std::string getDeviceInfoString(cl_device_id device, cl_device_info param_name);
+
+// Query a fixed-size device parameter with a single clGetDeviceInfo call, the result size is known from the type.
+template <typename T>
+T getDeviceInfoScalar(cl_device_id device, cl_device_info param_name) {
+    T value{};
+    checkOpenCLError( clGetDeviceInfo(device, param_name, sizeof(T), &value, nullptr) );
+    return value;
+}
+
+// Same as getDeviceInfoScalar, but for parameters introduced after OpenCL 1.2 which older drivers reject with CL_INVALID_VALUE.
+// Returns the value-initialized T in that case instead of aborting the whole query.
+template <typename T>
+T getOptionalDeviceInfoScalar(cl_device_id device, cl_device_info param_name) {
+    T value{};
+    if(clGetDeviceInfo(device, param_name, sizeof(T), &value, nullptr) != CL_SUCCESS) {
+        return T{};
+    }
+    return value;
+}
+
+// Query a device parameter returning an array of T (size query + data query).
+template <typename T>
+std::vector<T> getDeviceInfoArray(cl_device_id device, cl_device_info param_name) {
+    size_t size;
+    checkOpenCLError( clGetDeviceInfo(device, param_name, 0, nullptr, &size) );
+    std::vector<T> values(size / sizeof(T));
+    if(!values.empty()) {
+        checkOpenCLError( clGetDeviceInfo(device, param_name, values.size() * sizeof(T), values.data(), nullptr) );
+    }
+    return values;
+}
+
+#endif //OPENCL_UTILS_H
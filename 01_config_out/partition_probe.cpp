@@ -0,0 +1,218 @@
+#include "partition_probe.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+#include "device_session.h"
+#include "opencl_utils.h"
+#include "units.h"
+
+namespace {
+
+const char* kTriadSource = R"CLC(
+__kernel void first_touch(__global float* a, __global float* b, __global float* c) {
+    size_t i = get_global_id(0);
+    a[i] = 0.0f;
+    b[i] = 1.0f;
+    c[i] = 2.0f;
+}
+
+__kernel void triad(__global float* a, __global const float* b, __global const float* c, float scalar) {
+    size_t i = get_global_id(0);
+    a[i] = b[i] + scalar * c[i];
+}
+)CLC";
+
+// Triad reads two arrays and writes one.
+const int kArraysTouched = 3;
+
+// One sub-device (or the whole device) with its own queue and slice of the arrays.
+struct Lane {
+    cl_device_id device = nullptr;
+    cl_command_queue queue = nullptr;
+    cl_kernel triad = nullptr;
+    cl_mem a = nullptr;
+    cl_mem b = nullptr;
+    cl_mem c = nullptr;
+    size_t elements = 0;
+};
+
+// Triad throughput of all lanes running concurrently in one context.
+Summary runLanes(const std::vector<cl_device_id>& devices, size_t totalElements, int repetitions) {
+    cl_int err;
+    cl_context context = clCreateContext(nullptr, static_cast<cl_uint>(devices.size()), devices.data(), nullptr, nullptr, &err);
+    checkOpenCLError(err);
+    const char* sources[] = {kTriadSource};
+    cl_program program = clCreateProgramWithSource(context, 1, sources, nullptr, &err);
+    checkOpenCLError(err);
+    checkOpenCLError( clBuildProgram(program, static_cast<cl_uint>(devices.size()), devices.data(), "", nullptr, nullptr) );
+
+    std::vector<Lane> lanes(devices.size());
+    float scalar = 3.0f;
+    for(size_t idx = 0; idx < lanes.size(); ++idx) {
+        auto& lane = lanes[idx];
+        lane.device = devices[idx];
+        lane.queue = clCreateCommandQueueWithProperties(context, lane.device, nullptr, &err);
+        checkOpenCLError(err);
+        lane.elements = totalElements / lanes.size() + (idx < totalElements % lanes.size() ? 1 : 0);
+        size_t bytes = std::max<size_t>(lane.elements, 1) * sizeof(float);
+        lane.a = clCreateBuffer(context, CL_MEM_READ_WRITE, bytes, nullptr, &err);
+        checkOpenCLError(err);
+        lane.b = clCreateBuffer(context, CL_MEM_READ_WRITE, bytes, nullptr, &err);
+        checkOpenCLError(err);
+        lane.c = clCreateBuffer(context, CL_MEM_READ_WRITE, bytes, nullptr, &err);
+        checkOpenCLError(err);
+
+        // Bind the buffers to this sub-device before first use, then let its own work-items touch every page.
+        cl_mem buffers[] = {lane.a, lane.b, lane.c};
+        checkOpenCLError( clEnqueueMigrateMemObjects(lane.queue, 3, buffers, CL_MIGRATE_MEM_OBJECT_CONTENT_UNDEFINED, 0, nullptr, nullptr) );
+        cl_kernel touch = createKernel(program, "first_touch");
+        checkOpenCLError( clSetKernelArg(touch, 0, sizeof(cl_mem), &lane.a) );
+        checkOpenCLError( clSetKernelArg(touch, 1, sizeof(cl_mem), &lane.b) );
+        checkOpenCLError( clSetKernelArg(touch, 2, sizeof(cl_mem), &lane.c) );
+        checkOpenCLError( clEnqueueNDRangeKernel(lane.queue, touch, 1, nullptr, &lane.elements, nullptr, 0, nullptr, nullptr) );
+        checkOpenCLError( clFinish(lane.queue) );
+        clReleaseKernel(touch);
+
+        lane.triad = createKernel(program, "triad");
+        checkOpenCLError( clSetKernelArg(lane.triad, 0, sizeof(cl_mem), &lane.a) );
+        checkOpenCLError( clSetKernelArg(lane.triad, 1, sizeof(cl_mem), &lane.b) );
+        checkOpenCLError( clSetKernelArg(lane.triad, 2, sizeof(cl_mem), &lane.c) );
+        checkOpenCLError( clSetKernelArg(lane.triad, 3, sizeof(float), &scalar) );
+    }
+
+    std::vector<double> gbs;
+    double bytesPerRun = static_cast<double>(totalElements) * sizeof(float) * kArraysTouched;
+    // The first run is an untimed warm-up.
+    for(int rep = 0; rep <= repetitions; ++rep) {
+        auto start = std::chrono::steady_clock::now();
+        for(auto& lane : lanes) {
+            checkOpenCLError( clEnqueueNDRangeKernel(lane.queue, lane.triad, 1, nullptr, &lane.elements, nullptr, 0, nullptr, nullptr) );
+            checkOpenCLError( clFlush(lane.queue) );
+        }
+        for(auto& lane : lanes) {
+            checkOpenCLError( clFinish(lane.queue) );
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if(rep > 0 && seconds > 0) {
+            gbs.push_back(bytesPerRun / seconds / 1e9);
+        }
+    }
+
+    for(auto& lane : lanes) {
+        clReleaseKernel(lane.triad);
+        clReleaseMemObject(lane.c);
+        clReleaseMemObject(lane.b);
+        clReleaseMemObject(lane.a);
+        clReleaseCommandQueue(lane.queue);
+    }
+    clReleaseProgram(program);
+    clReleaseContext(context);
+    return summarize(gbs);
+}
+
+bool supports(const DeviceCapabilities& caps, cl_device_partition_property property) {
+    return std::find(caps.partitionProperties.begin(), caps.partitionProperties.end(), property) != caps.partitionProperties.end();
+}
+
+}
+
+std::vector<cl_device_id> createSubDevices(cl_device_id device, const std::vector<cl_device_partition_property>& properties, cl_int& err) {
+    std::vector<cl_device_id> subDevices;
+    cl_uint count = 0;
+    err = clCreateSubDevices(device, properties.data(), 0, nullptr, &count);
+    if(err != CL_SUCCESS || count == 0) {
+        return subDevices;
+    }
+    subDevices.resize(count);
+    err = clCreateSubDevices(device, properties.data(), count, subDevices.data(), nullptr);
+    if(err != CL_SUCCESS) {
+        subDevices.clear();
+    }
+    return subDevices;
+}
+
+std::vector<PartitionSample> measurePartitionScaling(const DeviceRecord& record, size_t bytes, int repetitions) {
+    std::vector<PartitionSample> samples;
+    const auto& caps = record.caps;
+    size_t elements = std::max<size_t>(std::min<size_t>(bytes, caps.maxMemAllocSize) / sizeof(float), 1024);
+
+    PartitionSample whole;
+    whole.scheme = "unpartitioned";
+    whole.computeUnits.push_back(caps.maxComputeUnits);
+    whole.gbs = runLanes({record.device}, elements, repetitions);
+    samples.push_back(whole);
+
+    std::vector<std::pair<std::string, std::vector<cl_device_partition_property>>> schemes;
+    if(supports(caps, CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN)) {
+        if(caps.partitionAffinityDomain & CL_DEVICE_AFFINITY_DOMAIN_NUMA) {
+            schemes.push_back({"numa", {CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN, CL_DEVICE_AFFINITY_DOMAIN_NUMA, 0}});
+        }
+        // The outermost cache level the device can split along.
+        const std::pair<cl_device_affinity_domain, const char*> caches[] = {
+                {CL_DEVICE_AFFINITY_DOMAIN_L4_CACHE, "l4-cache"},
+                {CL_DEVICE_AFFINITY_DOMAIN_L3_CACHE, "l3-cache"},
+                {CL_DEVICE_AFFINITY_DOMAIN_L2_CACHE, "l2-cache"},
+        };
+        for(const auto& cache : caches) {
+            if(caps.partitionAffinityDomain & cache.first) {
+                schemes.push_back({cache.second, {CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN, static_cast<cl_device_partition_property>(cache.first), 0}});
+                break;
+            }
+        }
+    }
+    if(supports(caps, CL_DEVICE_PARTITION_EQUALLY)) {
+        // PARTITION_EQUALLY creates as many sub-devices of the given size as fit, e.g. 6 CUs split for 4 parts are 6 one-CU sub-devices,
+        // so the check and the label use the count that really comes out.
+        cl_uint previousCount = 0;
+        for(cl_uint parts : {2u, 4u}) {
+            cl_uint unitsEach = caps.maxComputeUnits / parts;
+            cl_uint count = unitsEach > 0 ? caps.maxComputeUnits / unitsEach : 0;
+            if(count >= 2 && count <= caps.partitionMaxSubDevices && count != previousCount) {
+                schemes.push_back({"equal-" + std::to_string(count), {CL_DEVICE_PARTITION_EQUALLY, unitsEach, 0}});
+                previousCount = count;
+            }
+        }
+    }
+
+    for(const auto& scheme : schemes) {
+        cl_int err;
+        auto subDevices = createSubDevices(record.device, scheme.second, err);
+        if(subDevices.empty()) {
+            std::cerr << scheme.first << ": clCreateSubDevices failed with " << getOpenCLErrorString(err) << std::endl;
+            continue;
+        }
+        PartitionSample sample;
+        sample.scheme = scheme.first;
+        sample.subDevices = subDevices.size();
+        for(auto device : subDevices) {
+            sample.computeUnits.push_back(getDeviceInfoScalar<cl_uint>(device, CL_DEVICE_MAX_COMPUTE_UNITS));
+        }
+        sample.gbs = runLanes(subDevices, elements, repetitions);
+        samples.push_back(sample);
+        for(auto device : subDevices) {
+            clReleaseDevice(device);
+        }
+    }
+    return samples;
+}
+
+void printPartitionReport(const DeviceRecord& record, const std::vector<PartitionSample>& samples) {
+    if(record.caps.partitionProperties.empty()) {
+        std::cout << "Device cannot be partitioned (CL_DEVICE_PARTITION_PROPERTIES is empty)" << std::endl;
+    }
+    std::cout << std::left << std::setw(16) << "Scheme" << std::right << std::setw(6) << "Subs" << std::setw(20) << "CUs each"
+              << std::setw(12) << "min GB/s" << std::setw(10) << "median" << std::setw(10) << "max" << std::setw(10) << "scaling" << std::endl;
+    double baseline = samples.empty() ? 0.0 : samples.front().gbs.median;
+    for(const auto& sample : samples) {
+        std::string units;
+        for(size_t idx = 0; idx < sample.computeUnits.size(); ++idx) {
+            units += (idx ? "," : "") + std::to_string(sample.computeUnits[idx]);
+        }
+        std::cout << std::left << std::setw(16) << sample.scheme << std::right << std::setw(6) << sample.subDevices << std::setw(20) << units
+                  << std::fixed << std::setprecision(2) << std::setw(12) << sample.gbs.min << std::setw(10) << sample.gbs.median << std::setw(10) << sample.gbs.max
+                  << std::setw(9) << (baseline > 0 ? sample.gbs.median / baseline : 0.0) << "x" << std::defaultfloat << std::endl;
+    }
+}
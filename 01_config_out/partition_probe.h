@@ -0,0 +1,32 @@
+#ifndef PARTITION_PROBE_H
+#define PARTITION_PROBE_H
+
+#include <string>
+#include <vector>
+
+#include <CL/cl.h>
+
+#include "device_inventory.h"
+#include "statistics.h"
+
+// Split the device with clCreateSubDevices. properties is the 0-terminated list passed to the driver.
+// Returns an empty list (and the driver error in err) if the device refuses, e.g. CL_DEVICE_PARTITION_FAILED on a single NUMA node.
+std::vector<cl_device_id> createSubDevices(cl_device_id device, const std::vector<cl_device_partition_property>& properties, cl_int& err);
+
+struct PartitionSample {
+    // "unpartitioned", "numa", "l3-cache", "equal-4", ...
+    std::string scheme;
+    size_t subDevices = 1;
+    // Compute units of each sub-device, in creation order.
+    std::vector<cl_uint> computeUnits;
+    Summary gbs;
+};
+
+// Run a stream triad over the same total size on the whole device and on each partitioning it supports (by NUMA node, by the outermost
+// cache domain, equally into 2 and 4 parts). Every sub-device owns its slice of the arrays, first touched by a kernel on that sub-device
+// so a NUMA aware runtime such as POCL places the pages on its node.
+std::vector<PartitionSample> measurePartitionScaling(const DeviceRecord& record, size_t bytes, int repetitions);
+
+void printPartitionReport(const DeviceRecord& record, const std::vector<PartitionSample>& samples);
+
+#endif //PARTITION_PROBE_H
@@ -0,0 +1,314 @@
+#include "persistent_batcher.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#include "opencl_utils.h"
+#include "statistics.h"
+
+namespace {
+
+const char* kBatchSource = R"CLC(
+typedef struct {
+    uint offset;
+    uint length;
+    float scale;
+    uint reserved;
+} BatchItem;
+
+__kernel void run_item(__global float* data, uint offset, uint length, float scale) {
+    for(uint i = get_global_id(0); i < length; i += get_global_size(0)) {
+        data[offset + i] = data[offset + i] * scale + 1.0f;
+    }
+}
+
+// Every work-group takes the next item off the queue until it is empty. The item index is uniform across the group, so the whole group
+// leaves the loop together and the barriers stay matched.
+__kernel void run_batch(__global float* data, __global const BatchItem* items, uint count, volatile __global uint* head) {
+    __local uint current;
+    for(;;) {
+        if(get_local_id(0) == 0) {
+            current = atomic_inc(head);
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+        uint index = current;
+        barrier(CLK_LOCAL_MEM_FENCE);
+        if(index >= count) {
+            return;
+        }
+        BatchItem item = items[index];
+        for(uint i = get_local_id(0); i < item.length; i += get_local_size(0)) {
+            data[item.offset + i] = data[item.offset + i] * item.scale + 1.0f;
+        }
+    }
+}
+)CLC";
+
+// Distinct slices of the data buffer the items cycle through. A batch holds at most this many items, more would have work-groups
+// updating the same slice concurrently.
+const size_t kSlices = 4096;
+
+double microsecondsBetween(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+    return std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+// Host time at which the driver reported a launch complete, set from the event callback thread.
+struct LaunchCompletion {
+    std::chrono::steady_clock::time_point time;
+    std::atomic<bool> done{false};
+};
+
+void CL_CALLBACK markLaunchComplete(cl_event, cl_int, void* userData) {
+    auto completion = static_cast<LaunchCompletion*>(userData);
+    completion->time = std::chrono::steady_clock::now();
+    completion->done.store(true, std::memory_order_release);
+}
+
+BatchItem itemAt(size_t index, size_t itemLength) {
+    BatchItem item;
+    item.offset = static_cast<cl_uint>((index % kSlices) * itemLength);
+    item.length = static_cast<cl_uint>(itemLength);
+    return item;
+}
+
+// Every item adds 1 to each element of its slice (scale 1, the buffer starts at 0), so after the runs so far a slice holds the number of
+// items that were run on it. Returns the elements that do not.
+size_t countMismatches(const DeviceSession& session, cl_mem data, size_t itemLength, std::vector<cl_float>& expected, size_t items) {
+    for(size_t idx = 0; idx < items; ++idx) {
+        expected[idx % kSlices] += 1.0f;
+    }
+    std::vector<cl_float> values(kSlices * itemLength);
+    checkOpenCLError( clEnqueueReadBuffer(session.queue, data, CL_TRUE, 0, values.size() * sizeof(cl_float), values.data(), 0, nullptr, nullptr) );
+    size_t mismatches = 0;
+    for(size_t idx = 0; idx < values.size(); ++idx) {
+        if(values[idx] != expected[idx / itemLength]) {
+            ++mismatches;
+        }
+    }
+    return mismatches;
+}
+
+// Busy-wait, sleeping would add the scheduler's wake-up latency to every paced submission.
+template <typename Idle>
+void waitUntil(std::chrono::steady_clock::time_point time, Idle idle) {
+    while(std::chrono::steady_clock::now() < time) {
+        idle();
+    }
+}
+
+// One launch per item. Latency is on the host clock like the batched one: from before the enqueue call to the CL_COMPLETE callback of the
+// launch, so enqueue overhead and the host learning of the completion count on both sides.
+BatchingSample runPerLaunch(const DeviceSession& session, cl_kernel kernel, size_t items, size_t itemLength, std::chrono::microseconds pacing,
+                            const std::string& name) {
+    BatchingSample sample;
+    sample.name = name;
+    sample.items = items;
+    std::vector<std::chrono::steady_clock::time_point> submitted(items);
+    std::vector<LaunchCompletion> completions(items);
+    std::vector<cl_event> events;
+    events.reserve(items);
+    size_t global = itemLength;
+    cl_float scale = 1.0f;
+    cl_uint length = static_cast<cl_uint>(itemLength);
+    checkOpenCLError( clSetKernelArg(kernel, 2, sizeof(cl_uint), &length) );
+    checkOpenCLError( clSetKernelArg(kernel, 3, sizeof(cl_float), &scale) );
+
+    auto start = std::chrono::steady_clock::now();
+    for(size_t idx = 0; idx < items; ++idx) {
+        waitUntil(start + idx * pacing, [] {});
+        submitted[idx] = std::chrono::steady_clock::now();
+        auto item = itemAt(idx, itemLength);
+        checkOpenCLError( clSetKernelArg(kernel, 1, sizeof(cl_uint), &item.offset) );
+        cl_event event;
+        checkOpenCLError( clEnqueueNDRangeKernel(session.queue, kernel, 1, nullptr, &global, nullptr, 0, nullptr, &event) );
+        checkOpenCLError( clSetEventCallback(event, CL_COMPLETE, markLaunchComplete, &completions[idx]) );
+        if(pacing.count() > 0) {
+            checkOpenCLError( clFlush(session.queue) );
+        }
+        events.push_back(event);
+    }
+    checkOpenCLError( clFinish(session.queue) );
+    double wall = microsecondsBetween(start, std::chrono::steady_clock::now());
+
+    // clFinish does not wait for the callbacks, completions must stay alive until every one has run.
+    for(size_t idx = 0; idx < items; ++idx) {
+        while(!completions[idx].done.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+        sample.latencies.push_back(microsecondsBetween(submitted[idx], completions[idx].time));
+        clReleaseEvent(events[idx]);
+    }
+    std::sort(sample.latencies.begin(), sample.latencies.end());
+    sample.itemsPerSecond = wall > 0 ? items / wall * 1e6 : 0.0;
+    return sample;
+}
+
+BatchingSample runBatched(PersistentBatcher& batcher, size_t items, size_t itemLength, std::chrono::microseconds pacing, const std::string& name) {
+    BatchingSample sample;
+    sample.name = name;
+    sample.items = items;
+    size_t before = batcher.latencies().size();
+
+    auto start = std::chrono::steady_clock::now();
+    for(size_t idx = 0; idx < items; ++idx) {
+        waitUntil(start + idx * pacing, [&batcher] { batcher.poll(); });
+        batcher.submit(itemAt(idx, itemLength));
+    }
+    batcher.flush();
+    double wall = microsecondsBetween(start, std::chrono::steady_clock::now());
+
+    sample.latencies.assign(batcher.latencies().begin() + before, batcher.latencies().end());
+    std::sort(sample.latencies.begin(), sample.latencies.end());
+    sample.itemsPerSecond = wall > 0 ? items / wall * 1e6 : 0.0;
+    return sample;
+}
+
+}
+
+PersistentBatcher::PersistentBatcher(const DeviceRecord& record, const DeviceSession& session, cl_mem data, const BatchOptions& options)
+        : session_(session), options_(options) {
+    options_.maxItems = std::max<size_t>(options_.maxItems, 1);
+    program_ = buildProgram(session.context, session.device, kBatchSource);
+    kernel_ = createKernel(program_, "run_batch");
+
+    size_t kernelGroupSize = 0;
+    checkOpenCLError( clGetKernelWorkGroupInfo(kernel_, session.device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(kernelGroupSize), &kernelGroupSize, nullptr) );
+    groupSize_ = std::max<size_t>(1, std::min<size_t>(record.caps.maxWorkGroupSize, kernelGroupSize));
+    groups_ = std::max<cl_uint>(1, record.caps.maxComputeUnits);
+
+    cl_int err;
+    items_ = clCreateBuffer(session.context, CL_MEM_READ_ONLY, options_.maxItems * sizeof(BatchItem), nullptr, &err);
+    checkOpenCLError(err);
+    head_ = clCreateBuffer(session.context, CL_MEM_READ_WRITE, sizeof(cl_uint), nullptr, &err);
+    checkOpenCLError(err);
+    checkOpenCLError( clSetKernelArg(kernel_, 0, sizeof(cl_mem), &data) );
+    checkOpenCLError( clSetKernelArg(kernel_, 1, sizeof(cl_mem), &items_) );
+    checkOpenCLError( clSetKernelArg(kernel_, 3, sizeof(cl_mem), &head_) );
+
+    pending_.reserve(options_.maxItems);
+    submitted_.reserve(options_.maxItems);
+}
+
+PersistentBatcher::~PersistentBatcher() {
+    clReleaseMemObject(head_);
+    clReleaseMemObject(items_);
+    clReleaseKernel(kernel_);
+    clReleaseProgram(program_);
+}
+
+void PersistentBatcher::submit(const BatchItem& item) {
+    pending_.push_back(item);
+    submitted_.push_back(std::chrono::steady_clock::now());
+    if(pending_.size() >= options_.maxItems) {
+        flush();
+    }
+    else {
+        poll();
+    }
+}
+
+void PersistentBatcher::poll() {
+    if(!pending_.empty() && std::chrono::steady_clock::now() - submitted_.front() >= options_.deadline) {
+        flush();
+    }
+}
+
+void PersistentBatcher::flush() {
+    if(pending_.empty()) {
+        return;
+    }
+    cl_uint count = static_cast<cl_uint>(pending_.size());
+    cl_uint zero = 0;
+    checkOpenCLError( clEnqueueWriteBuffer(session_.queue, items_, CL_FALSE, 0, pending_.size() * sizeof(BatchItem), pending_.data(), 0, nullptr, nullptr) );
+    checkOpenCLError( clEnqueueFillBuffer(session_.queue, head_, &zero, sizeof(zero), 0, sizeof(zero), 0, nullptr, nullptr) );
+    checkOpenCLError( clSetKernelArg(kernel_, 2, sizeof(cl_uint), &count) );
+    // No more work-groups than items, the surplus would only take the counter past the end.
+    size_t local = groupSize_;
+    size_t global = std::min<size_t>(groups_, pending_.size()) * local;
+    checkOpenCLError( clEnqueueNDRangeKernel(session_.queue, kernel_, 1, nullptr, &global, &local, 0, nullptr, nullptr) );
+    // Also keeps pending_ alive until the non-blocking write has read it.
+    checkOpenCLError( clFinish(session_.queue) );
+
+    auto done = std::chrono::steady_clock::now();
+    for(const auto& time : submitted_) {
+        latencies_.push_back(microsecondsBetween(time, done));
+    }
+    pending_.clear();
+    submitted_.clear();
+    ++batches_;
+}
+
+BatchingReport measureBatching(const DeviceRecord& record, size_t items, size_t itemLength, const BatchOptions& options,
+                               std::chrono::microseconds pacing) {
+    BatchingReport report;
+    report.itemLength = itemLength = std::max<size_t>(itemLength, 1);
+    report.options = options;
+    report.options.maxItems = std::min(std::max<size_t>(options.maxItems, 1), kSlices);
+    items = std::max<size_t>(items, 1);
+
+    auto session = DeviceSession::create(record.device);
+    cl_int err;
+    size_t bytes = kSlices * itemLength * sizeof(cl_float);
+    cl_mem data = clCreateBuffer(session.context, CL_MEM_READ_WRITE, bytes, nullptr, &err);
+    checkOpenCLError(err);
+    cl_float zero = 0.0f;
+    checkOpenCLError( clEnqueueFillBuffer(session.queue, data, &zero, sizeof(zero), 0, bytes, 0, nullptr, nullptr) );
+
+    cl_program program = buildProgram(session.context, record.device, kBatchSource);
+    cl_kernel kernel = createKernel(program, "run_item");
+    checkOpenCLError( clSetKernelArg(kernel, 0, sizeof(cl_mem), &data) );
+    std::vector<cl_float> expected(kSlices, 0.0f);
+    {
+        PersistentBatcher batcher(record, session, data, report.options);
+        report.groups = batcher.groups();
+        report.groupSize = batcher.groupSize();
+
+        // Warm-up of both kernels.
+        size_t warmupItems = std::min<size_t>(items, 64);
+        runPerLaunch(session, kernel, warmupItems, itemLength, std::chrono::microseconds(0), "");
+        runBatched(batcher, warmupItems, itemLength, std::chrono::microseconds(0), "");
+        countMismatches(session, data, itemLength, expected, 2 * warmupItems);
+        size_t warmupBatches = batcher.batches();
+
+        auto verified = [&](BatchingSample sample) {
+            sample.mismatches = countMismatches(session, data, itemLength, expected, sample.items);
+            report.samples.push_back(sample);
+        };
+        verified(runPerLaunch(session, kernel, items, itemLength, std::chrono::microseconds(0), "per-launch, burst"));
+        verified(runBatched(batcher, items, itemLength, std::chrono::microseconds(0), "batched, burst"));
+        if(pacing.count() > 0) {
+            verified(runPerLaunch(session, kernel, items, itemLength, pacing, "per-launch, paced"));
+            verified(runBatched(batcher, items, itemLength, pacing, "batched, paced"));
+        }
+        report.batches = batcher.batches() - warmupBatches;
+    }
+
+    clReleaseKernel(kernel);
+    clReleaseProgram(program);
+    clReleaseMemObject(data);
+    session.release();
+    return report;
+}
+
+void printBatchingReport(const BatchingReport& report) {
+    std::cout << "Items of " << report.itemLength << " floats; persistent kernel: " << report.groups << " work-groups x " << report.groupSize
+              << ", flush at " << report.options.maxItems << " items or " << report.options.deadline.count() << " us, "
+              << report.batches << " batches" << std::endl;
+    std::cout << std::left << std::setw(20) << "Mode" << std::right << std::setw(10) << "items" << std::setw(14) << "items/s"
+              << std::setw(14) << "p50 us" << std::setw(14) << "p99 us" << std::setw(14) << "max us" << std::setw(12) << "mismatches" << std::endl;
+    for(const auto& sample : report.samples) {
+        std::cout << std::left << std::setw(20) << sample.name << std::right << std::setw(10) << sample.items << std::fixed
+                  << std::setprecision(0) << std::setw(14) << sample.itemsPerSecond << std::setprecision(1);
+        if(sample.latencies.empty()) {
+            std::cout << std::setw(14) << "-" << std::setw(14) << "-" << std::setw(14) << "-";
+        }
+        else {
+            std::cout << std::setw(14) << percentile(sample.latencies, 50) << std::setw(14) << percentile(sample.latencies, 99)
+                      << std::setw(14) << sample.latencies.back();
+        }
+        std::cout << std::setw(12) << sample.mismatches << std::defaultfloat << std::endl;
+    }
+}
@@ -0,0 +1,95 @@
+#ifndef PERSISTENT_BATCHER_H
+#define PERSISTENT_BATCHER_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <CL/cl.h>
+
+#include "device_inventory.h"
+#include "device_session.h"
+
+// A tiny unit of work: data[offset + i] = data[offset + i] * scale + 1 for i < length. Same layout as the OpenCL C BatchItem.
+struct BatchItem {
+    cl_uint offset = 0;
+    cl_uint length = 0;
+    cl_float scale = 1.0f;
+    cl_uint reserved = 0;
+};
+
+struct BatchOptions {
+    // Flush once this many items are pending, also the capacity of the device-resident queue.
+    size_t maxItems = 1024;
+    // Flush once the oldest pending item waited this long, checked by submit() and poll().
+    std::chrono::microseconds deadline{200};
+};
+
+// Collects items on the host and runs each batch with one launch of a persistent kernel: CL_DEVICE_MAX_COMPUTE_UNITS work-groups of
+// CL_DEVICE_MAX_WORK_GROUP_SIZE (capped by the kernel's CL_KERNEL_WORK_GROUP_SIZE) work-items stay resident and pull items from the
+// queue buffer with an atomic counter until it is empty, instead of paying one clEnqueueNDRangeKernel per item.
+// Flushes are synchronous: flush() returns when the batch has finished.
+class PersistentBatcher {
+public:
+    // data is the buffer the items work on, it must stay alive as long as the batcher.
+    PersistentBatcher(const DeviceRecord& record, const DeviceSession& session, cl_mem data, const BatchOptions& options);
+    ~PersistentBatcher();
+
+    PersistentBatcher(const PersistentBatcher&) = delete;
+    PersistentBatcher& operator=(const PersistentBatcher&) = delete;
+
+    void submit(const BatchItem& item);
+    // Flush if the deadline of the oldest pending item has passed. Producers call this while they have nothing to submit.
+    void poll();
+    void flush();
+
+    // Microseconds on the host clock from submit() to clFinish returning for the batch that ran the item, one entry per finished item.
+    const std::vector<double>& latencies() const { return latencies_; }
+    size_t batches() const { return batches_; }
+    size_t groups() const { return groups_; }
+    size_t groupSize() const { return groupSize_; }
+
+private:
+    const DeviceSession& session_;
+    BatchOptions options_;
+    cl_program program_ = nullptr;
+    cl_kernel kernel_ = nullptr;
+    cl_mem items_ = nullptr;
+    cl_mem head_ = nullptr;
+    size_t groups_ = 1;
+    size_t groupSize_ = 1;
+
+    std::vector<BatchItem> pending_;
+    std::vector<std::chrono::steady_clock::time_point> submitted_;
+    std::vector<double> latencies_;
+    size_t batches_ = 0;
+};
+
+struct BatchingSample {
+    std::string name;
+    size_t items = 0;
+    double itemsPerSecond = 0.0;
+    // Submission to completion, microseconds, sorted.
+    std::vector<double> latencies;
+    // Elements of the data buffer that disagree with the host's count of the items run on them, read back after the run.
+    size_t mismatches = 0;
+};
+
+struct BatchingReport {
+    size_t itemLength = 0;
+    size_t groups = 0;
+    size_t groupSize = 0;
+    // As run: maxItems is capped at the number of data slices, so no two items of one batch update the same elements.
+    BatchOptions options;
+    size_t batches = 0;
+    std::vector<BatchingSample> samples;
+};
+
+// Run `items` items of itemLength elements one clEnqueueNDRangeKernel each and through the PersistentBatcher, once submitted as fast as
+// possible and once paced at one item every pacing (where the deadline, not the batch size, triggers the flushes).
+BatchingReport measureBatching(const DeviceRecord& record, size_t items, size_t itemLength, const BatchOptions& options,
+                               std::chrono::microseconds pacing);
+
+void printBatchingReport(const BatchingReport& report);
+
+#endif //PERSISTENT_BATCHER_H
@@ -0,0 +1,203 @@
+#include "program_cache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <utility>
+
+#include "binary_archive.h"
+#include "compute_probe.h"
+#include "device_session.h"
+#include "opencl_utils.h"
+
+namespace {
+
+const char kProgramMagic[8] = {'C', 'L', 'P', 'R', 'O', 'G', '\0', '\0'};
+const uint32_t kProgramFormatVersion = 1;
+
+// FNV-1a, stable across compilers and runs unlike std::hash.
+uint64_t fnv1a(const std::string& data) {
+    uint64_t hash = 14695981039346656037ull;
+    for(unsigned char c : data) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+std::string toHex(uint64_t value) {
+    char text[17];
+    snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(value));
+    return text;
+}
+
+uint64_t nanosecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+ProgramCache::ProgramCache(std::string directory) : directory_(std::move(directory)) {}
+
+std::string ProgramCache::makeKey(cl_device_id device, const std::string& source, const std::string& options) {
+    auto platform = getDeviceInfoScalar<cl_platform_id>(device, CL_DEVICE_PLATFORM);
+    // The source goes in as its hash, the key is stored in the file and compared on load to rule out file name collisions.
+    return getPlatformInfoString(platform, CL_PLATFORM_NAME) + '\n' + getDeviceInfoString(device, CL_DEVICE_NAME) + '\n'
+           + getDeviceInfoString(device, CL_DRIVER_VERSION) + '\n' + options + '\n' + toHex(fnv1a(source)) + ':' + std::to_string(source.size());
+}
+
+std::string ProgramCache::filePath(const std::string& key) const {
+    return directory_ + "/" + toHex(fnv1a(key)) + ".clbin";
+}
+
+bool ProgramCache::loadBinary(const std::string& key, std::vector<unsigned char>& binary) const {
+    std::vector<char> data;
+    if(!readWholeFile(filePath(key), data)) {
+        return false;
+    }
+    if(data.size() < sizeof(kProgramMagic) || std::memcmp(data.data(), kProgramMagic, sizeof(kProgramMagic)) != 0) {
+        return false;
+    }
+    BinaryReader reader(data.data() + sizeof(kProgramMagic), data.size() - sizeof(kProgramMagic));
+    uint32_t version = 0;
+    std::string storedKey;
+    reader(version);
+    reader(storedKey);
+    reader(binary);
+    return reader.ok && version == kProgramFormatVersion && storedKey == key && !binary.empty();
+}
+
+bool ProgramCache::storeBinary(const std::string& key, cl_program program) const {
+    // The program is built for a single device, so both queries return one entry.
+    size_t size = 0;
+    checkOpenCLError( clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(size), &size, nullptr) );
+    if(size == 0) {
+        return false;
+    }
+    std::vector<unsigned char> binary(size);
+    unsigned char* binaries[] = {binary.data()};
+    checkOpenCLError( clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(binaries), binaries, nullptr) );
+
+    BinaryWriter writer;
+    writer.buffer.insert(writer.buffer.end(), kProgramMagic, kProgramMagic + sizeof(kProgramMagic));
+    writer(kProgramFormatVersion);
+    writer(key);
+    writer(binary);
+    return replaceFile(filePath(key), writer.buffer);
+}
+
+cl_program ProgramCache::build(cl_context context, cl_device_id device, const std::string& source, const std::string& options, ProgramBuildInfo* info) {
+    auto start = std::chrono::steady_clock::now();
+    auto key = makeKey(device, source, options);
+    ProgramBuildInfo result;
+
+    std::vector<unsigned char> binary;
+    if(loadBinary(key, binary)) {
+        cl_int err;
+        cl_int binaryStatus = CL_SUCCESS;
+        const unsigned char* binaries[] = {binary.data()};
+        const size_t lengths[] = {binary.size()};
+        cl_program program = clCreateProgramWithBinary(context, 1, &device, lengths, binaries, &binaryStatus, &err);
+        if(err == CL_SUCCESS && binaryStatus == CL_SUCCESS) {
+            // Still required for binaries, typically a cheap finalization step.
+            err = clBuildProgram(program, 1, &device, options.c_str(), nullptr, nullptr);
+            if(err == CL_SUCCESS) {
+                result.fromBinary = true;
+                result.nanoseconds = nanosecondsSince(start);
+                if(info) {
+                    *info = result;
+                }
+                return program;
+            }
+        }
+        if(program) {
+            clReleaseProgram(program);
+        }
+        // Rejected (CL_INVALID_BINARY after a silent driver change, truncated file, ...): drop it and rebuild from source.
+        std::remove(filePath(key).c_str());
+        result.binaryRejected = true;
+    }
+
+    cl_program program = buildProgram(context, device, source, options);
+    if(!storeBinary(key, program)) {
+        fprintf(stderr, "Failed to store program binary %s\n", filePath(key).c_str());
+        result.storeFailed = true;
+    }
+    result.nanoseconds = nanosecondsSince(start);
+    if(info) {
+        *info = result;
+    }
+    return program;
+}
+
+std::vector<ProgramCacheSample> measureProgramCache(const DeviceRecord& record, ProgramCache& cache) {
+    std::vector<ProgramCacheSample> samples;
+    if(!record.caps.compilerAvailable) {
+        return samples;
+    }
+
+    auto session = DeviceSession::create(record.device, 0);
+    std::vector<std::string> types = {"float"};
+    if(record.caps.doubleFpConfig != 0) {
+        types.push_back("double");
+    }
+    const std::string options = "-DITERATIONS=512";
+
+    for(const auto& type : types) {
+        ProgramCacheSample sample;
+        sample.program = "fma_chain " + type;
+        auto source = fmaChainSource(type);
+
+        // Cold: what every process start paid so far.
+        auto start = std::chrono::steady_clock::now();
+        cl_program program = buildProgram(session.context, record.device, source, options);
+        sample.sourceNanoseconds = nanosecondsSince(start);
+        clReleaseProgram(program);
+
+        // The first pass through the cache stores the binary if it was missing, the second one is the warm start of later runs.
+        ProgramBuildInfo info;
+        program = cache.build(session.context, record.device, source, options, &info);
+        sample.wasCached = info.fromBinary;
+        sample.binaryRejected = info.binaryRejected;
+        sample.storeFailed = info.storeFailed;
+        clReleaseProgram(program);
+
+        program = cache.build(session.context, record.device, source, options, &info);
+        sample.binaryNanoseconds = info.nanoseconds;
+        sample.binaryRejected = sample.binaryRejected || info.binaryRejected;
+        // Neither loaded nor rejected: the binary stored by the first pass could not be read back.
+        sample.storeFailed = sample.storeFailed || info.storeFailed || (!info.fromBinary && !info.binaryRejected);
+        clReleaseProgram(program);
+
+        samples.push_back(sample);
+    }
+
+    session.release();
+    return samples;
+}
+
+void printProgramCacheReport(const std::vector<ProgramCacheSample>& samples) {
+    if(samples.empty()) {
+        std::cout << "No compiler available (CL_DEVICE_COMPILER_AVAILABLE is false), nothing to cache" << std::endl;
+        return;
+    }
+    for(const auto& sample : samples) {
+        std::cout << sample.program << ": cold build from source " << std::fixed << std::setprecision(2) << sample.sourceNanoseconds / 1e6 << " ms"
+                  << ", warm build from binary " << sample.binaryNanoseconds / 1e6 << " ms"
+                  << " (" << std::setprecision(1) << (sample.binaryNanoseconds > 0 ? static_cast<double>(sample.sourceNanoseconds) / sample.binaryNanoseconds : 0.0) << "x)"
+                  << std::defaultfloat;
+        if(sample.storeFailed) {
+            std::cout << ", binary could not be stored in the cache directory, every build is from source";
+        }
+        else if(sample.binaryRejected) {
+            std::cout << ", binary rejected by the driver, rebuilt from source";
+        }
+        else {
+            std::cout << (sample.wasCached ? ", binary was cached" : ", binary stored");
+        }
+        std::cout << std::endl;
+    }
+}
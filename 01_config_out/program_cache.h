@@ -0,0 +1,63 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <CL/cl.h>
+
+#include "device_inventory.h"
+
+// How ProgramCache::build produced a program.
+struct ProgramBuildInfo {
+    bool fromBinary = false;
+    // A cached binary existed but the driver refused it, it was deleted and the program rebuilt from source.
+    bool binaryRejected = false;
+    // Built from source and the binary could not be written to the cache directory.
+    bool storeFailed = false;
+    uint64_t nanoseconds = 0;
+};
+
+// On-disk cache of compiled programs, one file per (source, build options, platform, device, CL_DRIVER_VERSION).
+// The first build compiles from source and stores CL_PROGRAM_BINARIES, later builds load with clCreateProgramWithBinary.
+// A driver upgrade changes the key, so stale binaries are never offered to the new driver.
+class ProgramCache {
+public:
+    explicit ProgramCache(std::string directory);
+
+    // Build from the cached binary if there is one, otherwise from source (and store the binary).
+    // Like buildProgram, a failing source build prints the build log and exits.
+    cl_program build(cl_context context, cl_device_id device, const std::string& source, const std::string& options = "", ProgramBuildInfo* info = nullptr);
+
+    // Full key of a program, the cache file name is its hash.
+    static std::string makeKey(cl_device_id device, const std::string& source, const std::string& options);
+    std::string filePath(const std::string& key) const;
+
+    const std::string& directory() const { return directory_; }
+
+private:
+    bool loadBinary(const std::string& key, std::vector<unsigned char>& binary) const;
+    bool storeBinary(const std::string& key, cl_program program) const;
+
+    std::string directory_;
+};
+
+// Build time of one program from source, through the cache with an empty cache entry, and from the stored binary.
+struct ProgramCacheSample {
+    std::string program;
+    uint64_t sourceNanoseconds = 0;
+    uint64_t binaryNanoseconds = 0;
+    bool binaryRejected = false;
+    // The binary never made it into the cache (unwritable directory, full disk, ...), a local problem rather than the driver's.
+    bool storeFailed = false;
+    // The binary was already cached before this run.
+    bool wasCached = false;
+};
+
+// Compare cold (source) and warm (binary) builds of the compute probe's kernels on the device.
+std::vector<ProgramCacheSample> measureProgramCache(const DeviceRecord& record, ProgramCache& cache);
+
+void printProgramCacheReport(const std::vector<ProgramCacheSample>& samples);
+
+#endif //PROGRAM_CACHE_H
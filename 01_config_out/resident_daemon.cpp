@@ -0,0 +1,557 @@
+#include "resident_daemon.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "inventory_json.h"
+#include "json.h"
+#include "opencl_utils.h"
+
+extern char** environ;
+
+namespace {
+
+const char* kSampleJobSource = R"CLC(
+__kernel void scale(__global float* data, uint n) {
+    size_t i = get_global_id(0);
+    if(i < n) {
+        data[i] = data[i] * 2.0f + 1.0f;
+    }
+}
+)CLC";
+
+const size_t kSampleJobElements = 1 << 20;
+// How long measureDaemonLatency waits for a freshly started daemon to answer.
+const int kStartupTimeoutMilliseconds = 30000;
+// The daemon serves one connection at a time, a client gets this long to deliver its whole request (and to take the answer).
+const int kClientTimeoutMilliseconds = 5000;
+
+std::string errorResponse(const std::string& message) {
+    JsonWriter json;
+    json.beginObject();
+    json.key("ok");
+    json.value(false);
+    json.key("error");
+    json.value(message);
+    json.endObject();
+    return json.str();
+}
+
+std::string okResponse() {
+    JsonWriter json;
+    json.beginObject();
+    json.key("ok");
+    json.value(true);
+    json.endObject();
+    return json.str();
+}
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool fillSocketAddress(const std::string& path, sockaddr_un& address, std::string& error) {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(path.size() >= sizeof(address.sun_path)) {
+        error = "socket path longer than " + std::to_string(sizeof(address.sun_path) - 1) + " bytes: " + path;
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+// Read until the peer shuts down its side. With a timeout (milliseconds, -1 waits forever) for the whole read, a peer that stalls
+// makes it return false.
+bool readAll(int fd, std::string& data, int timeoutMilliseconds) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMilliseconds);
+    char buffer[4096];
+    for(;;) {
+        if(timeoutMilliseconds >= 0) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+            pollfd descriptor{fd, POLLIN, 0};
+            int ready = remaining > 0 ? poll(&descriptor, 1, static_cast<int>(remaining)) : 0;
+            if(ready < 0 && errno == EINTR) {
+                continue;
+            }
+            if(ready <= 0) {
+                return false;
+            }
+        }
+        ssize_t count = read(fd, buffer, sizeof(buffer));
+        if(count < 0 && errno == EINTR) {
+            continue;
+        }
+        if(count < 0) {
+            return false;
+        }
+        if(count == 0) {
+            return true;
+        }
+        data.append(buffer, static_cast<size_t>(count));
+    }
+}
+
+// A request value that must be a whole number in [minimum, maximum]. Checked before any conversion, the JSON number is a double.
+bool wholeNumberIn(const JsonValue& value, double minimum, double maximum, size_t& result) {
+    double number = value.number();
+    if(value.type != JsonValue::Type::Number || !std::isfinite(number) || std::floor(number) != number || number < minimum || number > maximum) {
+        return false;
+    }
+    result = static_cast<size_t>(number);
+    return true;
+}
+
+// Whether a process accepts connections on the socket. A stale socket file left by a daemon that died refuses them.
+bool socketIsLive(const sockaddr_un& address) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0) {
+        return false;
+    }
+    bool live = connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+    close(fd);
+    return live;
+}
+
+// MSG_NOSIGNAL: a peer that went away must not kill the daemon with SIGPIPE.
+bool sendAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while(sent < data.size()) {
+        ssize_t count = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if(count < 0 && errno == EINTR) {
+            continue;
+        }
+        if(count <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(count);
+    }
+    return true;
+}
+
+// Start this executable with the arguments, its standard output discarded.
+bool spawnSelf(const std::vector<std::string>& arguments, pid_t& pid, std::string& error) {
+    std::vector<char*> argv;
+    std::string executable = "/proc/self/exe";
+    argv.push_back(&executable[0]);
+    std::vector<std::string> copies(arguments);
+    for(auto& argument : copies) {
+        argv.push_back(&argument[0]);
+    }
+    argv.push_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    int result = posix_spawn(&pid, executable.c_str(), &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if(result != 0) {
+        error = std::string("posix_spawn failed: ") + std::strerror(result);
+        return false;
+    }
+    return true;
+}
+
+bool waitExitedCleanly(pid_t pid) {
+    int status = 0;
+    while(waitpid(pid, &status, 0) < 0) {
+        if(errno != EINTR) {
+            return false;
+        }
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+bool responseOk(const std::string& response, std::string& error) {
+    JsonValue value;
+    if(!parseJson(response, value, error)) {
+        error = "malformed answer: " + error;
+        return false;
+    }
+    auto ok = value.find("ok");
+    if(!ok || ok->text != "true") {
+        auto message = value.find("error");
+        error = message ? message->text : "request failed";
+        return false;
+    }
+    return true;
+}
+
+}
+
+ResidentDaemon::ResidentDaemon(const DeviceInventory& inventory) : inventory_(inventory) {}
+
+ResidentDaemon::~ResidentDaemon() {
+    for(auto& entry : states_) {
+        for(auto& program : entry.second.programs) {
+            clReleaseProgram(program.second);
+        }
+        entry.second.session.release();
+    }
+}
+
+ResidentDaemon::DeviceState* ResidentDaemon::stateOf(size_t deviceIndex, std::string& error) {
+    auto it = states_.find(deviceIndex);
+    if(it == states_.end()) {
+        DeviceState state;
+        if(!DeviceSession::tryCreate(inventory_.devices[deviceIndex].device, state.session, error)) {
+            return nullptr;
+        }
+        it = states_.emplace(deviceIndex, state).first;
+    }
+    return &it->second;
+}
+
+std::string ResidentDaemon::handle(const std::string& request) {
+    JsonValue value;
+    std::string error;
+    if(!parseJson(request, value, error) || value.type != JsonValue::Type::Object) {
+        return errorResponse("malformed request" + (error.empty() ? std::string() : ": " + error));
+    }
+    auto op = value.find("op");
+    if(!op) {
+        return errorResponse("missing \"op\"");
+    }
+    if(op->text == "ping") {
+        return okResponse();
+    }
+    if(op->text == "caps") {
+        return inventoryToJson(inventory_);
+    }
+    if(op->text == "shutdown") {
+        stopping_ = true;
+        return okResponse();
+    }
+    if(op->text == "run") {
+        auto device = value.find("device");
+        auto source = value.find("source");
+        auto kernel = value.find("kernel");
+        auto options = value.find("options");
+        auto elements = value.find("elements");
+        if(!source || !kernel || !elements) {
+            return errorResponse("run needs \"source\", \"kernel\" and \"elements\"");
+        }
+        size_t index = 0;
+        if(inventory_.devices.empty() || (device && !wholeNumberIn(*device, 0, static_cast<double>(inventory_.devices.size() - 1), index))) {
+            return errorResponse("no device #" + (device ? device->toString() : std::string("0")));
+        }
+        // The kernel takes the count as a uint, and the buffer has to fit one allocation.
+        const auto& caps = inventory_.devices[index].caps;
+        double maxElements = static_cast<double>(std::min<cl_ulong>(UINT32_MAX, caps.maxMemAllocSize / sizeof(cl_float)));
+        size_t count = 0;
+        if(!wholeNumberIn(*elements, 1, maxElements, count)) {
+            return errorResponse("\"elements\" must be a whole number from 1 to " + std::to_string(static_cast<uint64_t>(maxElements)));
+        }
+        return run(index, source->text, kernel->text, options ? options->text : std::string(), count);
+    }
+    return errorResponse("unknown op \"" + op->text + "\"");
+}
+
+std::string ResidentDaemon::run(size_t deviceIndex, const std::string& source, const std::string& kernelName, const std::string& options, size_t elements) {
+    auto start = std::chrono::steady_clock::now();
+    std::string error;
+    auto state = stateOf(deviceIndex, error);
+    if(!state) {
+        return errorResponse(error);
+    }
+    const auto& session = state->session;
+
+    auto key = options + '\n' + source;
+    auto it = state->programs.find(key);
+    bool cached = it != state->programs.end();
+    double buildMilliseconds = 0.0;
+    if(!cached) {
+        auto buildStart = std::chrono::steady_clock::now();
+        std::string buildLog;
+        cl_program program = tryBuildProgram(session.context, session.device, source, options, buildLog);
+        if(!program) {
+            return errorResponse("build failed: " + buildLog);
+        }
+        buildMilliseconds = millisecondsSince(buildStart);
+        it = state->programs.emplace(key, program).first;
+    }
+
+    cl_int err;
+    cl_kernel kernel = clCreateKernel(it->second, kernelName.c_str(), &err);
+    if(err != CL_SUCCESS) {
+        return errorResponse(std::string("clCreateKernel: ") + getOpenCLErrorString(err));
+    }
+    cl_mem buffer = clCreateBuffer(session.context, CL_MEM_READ_WRITE, elements * sizeof(cl_float), nullptr, &err);
+    if(err != CL_SUCCESS) {
+        clReleaseKernel(kernel);
+        return errorResponse(std::string("clCreateBuffer: ") + getOpenCLErrorString(err));
+    }
+
+    // Each step only runs if every earlier one succeeded, the cleanup below is shared.
+    cl_uint count = static_cast<cl_uint>(elements);
+    cl_float one = 1.0f;
+    cl_event event = nullptr;
+    std::vector<cl_float> data(elements);
+    err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &buffer);
+    if(err == CL_SUCCESS) {
+        err = clSetKernelArg(kernel, 1, sizeof(cl_uint), &count);
+    }
+    if(err == CL_SUCCESS) {
+        err = clEnqueueFillBuffer(session.queue, buffer, &one, sizeof(one), 0, elements * sizeof(cl_float), 0, nullptr, nullptr);
+    }
+    if(err == CL_SUCCESS) {
+        err = clEnqueueNDRangeKernel(session.queue, kernel, 1, nullptr, &elements, nullptr, 0, nullptr, &event);
+    }
+    if(err == CL_SUCCESS) {
+        err = clEnqueueReadBuffer(session.queue, buffer, CL_TRUE, 0, elements * sizeof(cl_float), data.data(), 0, nullptr, nullptr);
+    }
+    cl_ulong kernelNanoseconds = 0;
+    if(err == CL_SUCCESS) {
+        err = tryEventElapsedNanoseconds(event, kernelNanoseconds);
+    }
+    if(event) {
+        clReleaseEvent(event);
+    }
+    clReleaseMemObject(buffer);
+    clReleaseKernel(kernel);
+    if(err != CL_SUCCESS) {
+        return errorResponse(getOpenCLErrorString(err));
+    }
+
+    double checksum = 0.0;
+    for(auto v : data) {
+        checksum += v;
+    }
+    JsonWriter json;
+    json.beginObject();
+    json.key("ok");
+    json.value(true);
+    json.key("program_cached");
+    json.value(cached);
+    json.key("build_ms");
+    json.value(buildMilliseconds);
+    json.key("kernel_ns");
+    json.value(static_cast<uint64_t>(kernelNanoseconds));
+    json.key("checksum");
+    json.value(checksum);
+    json.key("server_ms");
+    json.value(millisecondsSince(start));
+    json.endObject();
+    return json.str();
+}
+
+bool ResidentDaemon::serve(const std::string& socketPath, std::string& error) {
+    sockaddr_un address;
+    if(!fillSocketAddress(socketPath, address, error)) {
+        return false;
+    }
+    // Only a stale socket is replaced, never a file that happens to be at the path.
+    struct stat existing;
+    if(lstat(socketPath.c_str(), &existing) == 0) {
+        if(!S_ISSOCK(existing.st_mode)) {
+            error = socketPath + " exists and is not a socket";
+            return false;
+        }
+        // Taking over the path of a running daemon would leave it unreachable, and its exit would unlink our socket.
+        if(socketIsLive(address)) {
+            error = "a daemon is already listening on " + socketPath;
+            return false;
+        }
+        unlink(socketPath.c_str());
+    }
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(listener < 0) {
+        error = std::string("socket: ") + std::strerror(errno);
+        return false;
+    }
+    if(bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 16) != 0) {
+        error = "cannot listen on " + socketPath + ": " + std::strerror(errno);
+        close(listener);
+        return false;
+    }
+
+    // One request per connection, answered in arrival order. Requests for different devices could run concurrently, but a job queue
+    // per device would serialize them on the device anyway.
+    stopping_ = false;
+    while(!stopping_) {
+        int client = accept(listener, nullptr, nullptr);
+        if(client < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            error = std::string("accept: ") + std::strerror(errno);
+            break;
+        }
+        // A client that stalls (never finishes its request, never reads the answer) is dropped instead of blocking every other job.
+        timeval sendTimeout{kClientTimeoutMilliseconds / 1000, (kClientTimeoutMilliseconds % 1000) * 1000};
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &sendTimeout, sizeof(sendTimeout));
+        std::string request;
+        if(readAll(client, request, kClientTimeoutMilliseconds)) {
+            sendAll(client, handle(request));
+        }
+        close(client);
+    }
+    close(listener);
+    unlink(socketPath.c_str());
+    return error.empty();
+}
+
+bool sendDaemonRequest(const std::string& socketPath, const std::string& request, std::string& response, std::string& error) {
+    sockaddr_un address;
+    if(!fillSocketAddress(socketPath, address, error)) {
+        return false;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0) {
+        error = std::string("socket: ") + std::strerror(errno);
+        return false;
+    }
+    if(connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        error = "cannot connect to " + socketPath + ": " + std::strerror(errno);
+        close(fd);
+        return false;
+    }
+    // Shutting down the write side marks the end of the request.
+    if(!sendAll(fd, request) || shutdown(fd, SHUT_WR) != 0) {
+        error = std::string("send: ") + std::strerror(errno);
+        close(fd);
+        return false;
+    }
+    response.clear();
+    if(!readAll(fd, response, -1)) {
+        error = std::string("receive: ") + std::strerror(errno);
+        close(fd);
+        return false;
+    }
+    close(fd);
+    if(response.empty()) {
+        error = "empty answer from " + socketPath;
+        return false;
+    }
+    return true;
+}
+
+std::string sampleJobRequest(size_t deviceIndex) {
+    JsonWriter json;
+    json.beginObject();
+    json.key("op");
+    json.value("run");
+    json.key("device");
+    json.value(deviceIndex);
+    json.key("source");
+    json.value(kSampleJobSource);
+    json.key("kernel");
+    json.value("scale");
+    json.key("options");
+    json.value("");
+    json.key("elements");
+    json.value(kSampleJobElements);
+    json.endObject();
+    return json.str();
+}
+
+bool measureDaemonLatency(long deviceIndex, int repetitions, DaemonLatencyReport& report, std::string& error) {
+    size_t device = deviceIndex < 0 ? 0 : static_cast<size_t>(deviceIndex);
+    auto deviceArgument = std::to_string(device);
+    repetitions = std::max(1, repetitions);
+
+    std::vector<double> cold;
+    for(int rep = 0; rep < repetitions; ++rep) {
+        auto start = std::chrono::steady_clock::now();
+        pid_t pid;
+        if(!spawnSelf({"--cold-job", "--device", deviceArgument}, pid, error)) {
+            return false;
+        }
+        if(!waitExitedCleanly(pid)) {
+            error = "cold job failed";
+            return false;
+        }
+        cold.push_back(millisecondsSince(start));
+    }
+    report.coldMilliseconds = summarize(cold);
+
+    char directory[] = "/tmp/opencl-daemon-bench-XXXXXX";
+    if(!mkdtemp(directory)) {
+        error = std::string("mkdtemp: ") + std::strerror(errno);
+        return false;
+    }
+    auto socketPath = std::string(directory) + "/daemon.sock";
+    pid_t daemon;
+    if(!spawnSelf({"--daemon", "--socket", socketPath}, daemon, error)) {
+        rmdir(directory);
+        return false;
+    }
+    std::string response;
+    auto startup = std::chrono::steady_clock::now();
+    while(!sendDaemonRequest(socketPath, "{\"op\":\"ping\"}", response, error)) {
+        int status;
+        if(waitpid(daemon, &status, WNOHANG) == daemon) {
+            error = "daemon exited during start-up";
+            unlink(socketPath.c_str());
+            rmdir(directory);
+            return false;
+        }
+        if(millisecondsSince(startup) > kStartupTimeoutMilliseconds) {
+            kill(daemon, SIGTERM);
+            waitpid(daemon, nullptr, 0);
+            error = "daemon did not answer within " + std::to_string(kStartupTimeoutMilliseconds / 1000) + " s: " + error;
+            unlink(socketPath.c_str());
+            rmdir(directory);
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    error.clear();
+
+    auto request = sampleJobRequest(device);
+    std::vector<double> warm;
+    bool ok = true;
+    for(int rep = 0; rep <= repetitions && ok; ++rep) {
+        auto start = std::chrono::steady_clock::now();
+        ok = sendDaemonRequest(socketPath, request, response, error) && responseOk(response, error);
+        double milliseconds = millisecondsSince(start);
+        if(rep == 0) {
+            report.firstRequestMilliseconds = milliseconds;
+        }
+        else {
+            warm.push_back(milliseconds);
+        }
+    }
+    report.warmMilliseconds = summarize(warm);
+
+    std::string ignored;
+    sendDaemonRequest(socketPath, "{\"op\":\"shutdown\"}", response, ignored);
+    waitExitedCleanly(daemon);
+    // The daemon removes its socket on a clean exit, this covers the others.
+    unlink(socketPath.c_str());
+    rmdir(directory);
+    return ok;
+}
+
+void printDaemonLatencyReport(const DaemonLatencyReport& report) {
+    std::cout << std::left << std::setw(34) << "Job latency (ms)" << std::right << std::setw(10) << "min" << std::setw(10) << "median"
+              << std::setw(10) << "max" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << std::left << std::setw(34) << "cold process" << std::right << std::setw(10) << report.coldMilliseconds.min
+              << std::setw(10) << report.coldMilliseconds.median << std::setw(10) << report.coldMilliseconds.max << std::endl;
+    std::cout << std::left << std::setw(34) << "daemon, first request (build)" << std::right << std::setw(10) << report.firstRequestMilliseconds
+              << std::setw(10) << report.firstRequestMilliseconds << std::setw(10) << report.firstRequestMilliseconds << std::endl;
+    std::cout << std::left << std::setw(34) << "daemon, warm request" << std::right << std::setw(10) << report.warmMilliseconds.min
+              << std::setw(10) << report.warmMilliseconds.median << std::setw(10) << report.warmMilliseconds.max << std::endl;
+    if(report.warmMilliseconds.median > 0) {
+        std::cout << "Warm requests are " << std::setprecision(1) << report.coldMilliseconds.median / report.warmMilliseconds.median
+                  << "x faster than a cold job" << std::endl;
+    }
+    std::cout << std::defaultfloat;
+}
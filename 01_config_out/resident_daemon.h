@@ -0,0 +1,76 @@
+#ifndef RESIDENT_DAEMON_H
+#define RESIDENT_DAEMON_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <CL/cl.h>
+
+#include "device_inventory.h"
+#include "device_session.h"
+#include "statistics.h"
+
+// Keeps the inventory, one context and queue per device and every program it has built alive between requests, so a job pays neither
+// ICD loading, context creation nor the program build again.
+// Requests are single JSON objects, answered with a single JSON object:
+//   {"op":"ping"}
+//   {"op":"caps"}                       -> the --json inventory document
+//   {"op":"run","device":0,"source":"...","kernel":"name","options":"","elements":N}
+//       The kernel has the signature (__global float* data, uint n) and runs over N work-items on a buffer of N floats filled with 1.
+//       The answer has the kernel time, whether the program came from the warm cache and the sum of the buffer afterwards.
+//   {"op":"shutdown"}
+class ResidentDaemon {
+public:
+    explicit ResidentDaemon(const DeviceInventory& inventory);
+    ~ResidentDaemon();
+
+    ResidentDaemon(const ResidentDaemon&) = delete;
+    ResidentDaemon& operator=(const ResidentDaemon&) = delete;
+
+    // Answer one request. Malformed requests, build failures and OpenCL errors become {"ok":false,"error":"..."}, never an exit.
+    std::string handle(const std::string& request);
+
+    // Accept connections on the Unix domain socket until a shutdown request, one request per connection. A client that does not deliver
+    // its request within a few seconds is dropped. Returns false (with error) if the socket cannot be set up. A stale socket at the path
+    // is replaced. A socket some process still listens on, or any other file there, is an error.
+    bool serve(const std::string& socketPath, std::string& error);
+
+private:
+    struct DeviceState {
+        DeviceSession session;
+        // Keyed by build options and source.
+        std::map<std::string, cl_program> programs;
+    };
+
+    // Creates the session on first use. nullptr (with error) if context or queue creation fails.
+    DeviceState* stateOf(size_t deviceIndex, std::string& error);
+    std::string run(size_t deviceIndex, const std::string& source, const std::string& kernelName, const std::string& options, size_t elements);
+
+    const DeviceInventory& inventory_;
+    std::map<size_t, DeviceState> states_;
+    bool stopping_ = false;
+};
+
+// Send one request and read the whole answer. Returns false (with error) if the daemon cannot be reached.
+bool sendDaemonRequest(const std::string& socketPath, const std::string& request, std::string& response, std::string& error);
+
+// The job both sides of the latency comparison run: a small kernel over 1M floats on the device.
+std::string sampleJobRequest(size_t deviceIndex);
+
+struct DaemonLatencyReport {
+    // A fresh process running the job: start-up, ICD loading, inventory, context, build, run.
+    Summary coldMilliseconds;
+    // The first request to a freshly started daemon (builds the program) and every later one (program warm).
+    double firstRequestMilliseconds = 0.0;
+    Summary warmMilliseconds;
+};
+
+// Start a daemon from this executable, time `repetitions` cold jobs (this executable with --cold-job) and as many requests of the same
+// job to the daemon, then shut the daemon down. The daemon listens on a socket in a private temporary directory, so a daemon the user
+// runs is neither measured nor shut down.
+bool measureDaemonLatency(long deviceIndex, int repetitions, DaemonLatencyReport& report, std::string& error);
+
+void printDaemonLatencyReport(const DaemonLatencyReport& report);
+
+#endif //RESIDENT_DAEMON_H
@@ -0,0 +1,30 @@
+#include "statistics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+Summary summarize(std::vector<double> values) {
+    Summary summary;
+    if(values.empty()) {
+        return summary;
+    }
+    std::sort(values.begin(), values.end());
+    summary.count = values.size();
+    summary.min = values.front();
+    summary.max = values.back();
+    summary.median = percentile(values, 50.0);
+    summary.mean = std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+    return summary;
+}
+
+double percentile(const std::vector<double>& sortedValues, double p) {
+    if(sortedValues.empty()) {
+        return 0.0;
+    }
+    double rank = p / 100.0 * (sortedValues.size() - 1);
+    size_t lower = static_cast<size_t>(std::floor(rank));
+    size_t upper = std::min(lower + 1, sortedValues.size() - 1);
+    double fraction = rank - lower;
+    return sortedValues[lower] + (sortedValues[upper] - sortedValues[lower]) * fraction;
+}
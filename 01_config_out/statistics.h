@@ -0,0 +1,20 @@
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <cstddef>
+#include <vector>
+
+struct Summary {
+    size_t count = 0;
+    double min = 0.0;
+    double median = 0.0;
+    double max = 0.0;
+    double mean = 0.0;
+};
+
+Summary summarize(std::vector<double> values);
+
+// Linear interpolated percentile, p in [0, 100]. values must be sorted ascending.
+double percentile(const std::vector<double>& sortedValues, double p);
+
+#endif //STATISTICS_H
@@ -0,0 +1,253 @@
+#include "stream_pipeline.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "device_session.h"
+#include "opencl_utils.h"
+#include "units.h"
+
+namespace {
+
+const char* kTransformSource = R"CLC(
+__kernel void transform_chunk(__global const uchar* in, __global uchar* out, uint bytes) {
+    size_t i = get_global_id(0);
+    if(i < bytes) {
+        out[i] = add_sat(in[i], (uchar)16);
+    }
+}
+)CLC";
+
+enum Stage {
+    kRead,
+    kUpload,
+    kCompute,
+    kDownload,
+    kWrite,
+    kStageCount,
+};
+
+struct Slot {
+    cl_mem pinnedIn = nullptr;
+    cl_mem pinnedOut = nullptr;
+    cl_mem deviceIn = nullptr;
+    cl_mem deviceOut = nullptr;
+    // Persistent mappings of the pinned buffers.
+    unsigned char* hostIn = nullptr;
+    unsigned char* hostOut = nullptr;
+    cl_event upload = nullptr;
+    cl_event compute = nullptr;
+    cl_event download = nullptr;
+    size_t bytes = 0;
+    bool busy = false;
+};
+
+uint64_t nanosecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+cl_mem createBuffer(cl_context context, cl_mem_flags flags, size_t size) {
+    cl_int err;
+    cl_mem buffer = clCreateBuffer(context, flags, size, nullptr, &err);
+    checkOpenCLError(err);
+    return buffer;
+}
+
+unsigned char* mapPinned(cl_command_queue queue, cl_mem buffer, cl_map_flags flags, size_t size) {
+    cl_int err;
+    auto host = static_cast<unsigned char*>(clEnqueueMapBuffer(queue, buffer, CL_TRUE, flags, 0, size, 0, nullptr, nullptr, &err));
+    checkOpenCLError(err);
+    return host;
+}
+
+cl_command_queue createProfilingQueue(const DeviceSession& session) {
+    cl_int err;
+    cl_queue_properties properties[] = {CL_QUEUE_PROPERTIES, CL_QUEUE_PROFILING_ENABLE, 0};
+    cl_command_queue queue = clCreateCommandQueueWithProperties(session.context, session.device, properties, &err);
+    checkOpenCLError(err);
+    return queue;
+}
+
+}
+
+bool runStreamPipeline(const DeviceRecord& record, const StreamOptions& options, StreamReport& report, std::string& error) {
+    int fd = open(options.inputPath.c_str(), O_RDONLY);
+    if(fd < 0) {
+        error = "cannot open " + options.inputPath + ": " + std::strerror(errno);
+        return false;
+    }
+    struct stat info;
+    if(fstat(fd, &info) != 0 || info.st_size == 0) {
+        error = options.inputPath + " is empty or cannot be examined";
+        close(fd);
+        return false;
+    }
+    size_t fileSize = static_cast<size_t>(info.st_size);
+    void* mapping = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED) {
+        error = "cannot mmap " + options.inputPath + ": " + std::strerror(errno);
+        return false;
+    }
+    // The pipeline walks the file front to back exactly once.
+    madvise(mapping, fileSize, MADV_SEQUENTIAL);
+    auto input = static_cast<const unsigned char*>(mapping);
+
+    std::ofstream output;
+    if(!options.outputPath.empty()) {
+        output.open(options.outputPath, std::ios::binary | std::ios::trunc);
+        if(!output) {
+            error = "cannot create " + options.outputPath;
+            munmap(mapping, fileSize);
+            return false;
+        }
+    }
+
+    // Four buffers per slot (pinned in/out, device in/out), each within CL_DEVICE_MAX_MEM_ALLOC_SIZE. The kernel takes the chunk size
+    // as a uint, so a chunk also stays below 4 GiB on devices that allow larger allocations.
+    int depth = std::max(2, options.ringDepth);
+    size_t chunkBytes = std::min<size_t>({std::max<size_t>(options.chunkBytes, 4096), record.caps.maxMemAllocSize, UINT32_MAX, fileSize});
+
+    auto session = DeviceSession::create(record.device);
+    cl_command_queue uploadQueue = createProfilingQueue(session);
+    cl_command_queue downloadQueue = createProfilingQueue(session);
+    cl_program program = buildProgram(session.context, record.device, kTransformSource);
+    cl_kernel kernel = createKernel(program, "transform_chunk");
+
+    std::vector<Slot> slots(depth);
+    for(auto& slot : slots) {
+        slot.pinnedIn = createBuffer(session.context, CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR, chunkBytes);
+        slot.pinnedOut = createBuffer(session.context, CL_MEM_WRITE_ONLY | CL_MEM_ALLOC_HOST_PTR, chunkBytes);
+        slot.deviceIn = createBuffer(session.context, CL_MEM_READ_ONLY, chunkBytes);
+        slot.deviceOut = createBuffer(session.context, CL_MEM_WRITE_ONLY, chunkBytes);
+        slot.hostIn = mapPinned(uploadQueue, slot.pinnedIn, CL_MAP_WRITE, chunkBytes);
+        slot.hostOut = mapPinned(downloadQueue, slot.pinnedOut, CL_MAP_READ, chunkBytes);
+    }
+
+    uint64_t busy[kStageCount] = {};
+    auto retire = [&](Slot& slot) {
+        checkOpenCLError( clWaitForEvents(1, &slot.download) );
+        busy[kUpload] += eventElapsedNanoseconds(slot.upload);
+        busy[kCompute] += eventElapsedNanoseconds(slot.compute);
+        busy[kDownload] += eventElapsedNanoseconds(slot.download);
+        clReleaseEvent(slot.upload);
+        clReleaseEvent(slot.compute);
+        clReleaseEvent(slot.download);
+
+        auto writeStart = std::chrono::steady_clock::now();
+        if(output.is_open()) {
+            output.write(reinterpret_cast<const char*>(slot.hostOut), slot.bytes);
+        }
+        busy[kWrite] += nanosecondsSince(writeStart);
+        slot.busy = false;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    size_t chunks = 0;
+    for(size_t offset = 0; offset < fileSize; offset += chunkBytes, ++chunks) {
+        auto& slot = slots[chunks % depth];
+        // The slot's previous chunk must be downloaded (and its staging buffers free) before it is refilled.
+        if(slot.busy) {
+            retire(slot);
+        }
+
+        slot.bytes = std::min(chunkBytes, fileSize - offset);
+        auto readStart = std::chrono::steady_clock::now();
+        // Page faults of the mapping land here, so this stage is the file I/O.
+        std::memcpy(slot.hostIn, input + offset, slot.bytes);
+        busy[kRead] += nanosecondsSince(readStart);
+
+        cl_uint bytes = static_cast<cl_uint>(slot.bytes);
+        size_t global = (slot.bytes + 255) / 256 * 256;
+        checkOpenCLError( clEnqueueWriteBuffer(uploadQueue, slot.deviceIn, CL_FALSE, 0, slot.bytes, slot.hostIn, 0, nullptr, &slot.upload) );
+        checkOpenCLError( clSetKernelArg(kernel, 0, sizeof(cl_mem), &slot.deviceIn) );
+        checkOpenCLError( clSetKernelArg(kernel, 1, sizeof(cl_mem), &slot.deviceOut) );
+        checkOpenCLError( clSetKernelArg(kernel, 2, sizeof(cl_uint), &bytes) );
+        checkOpenCLError( clEnqueueNDRangeKernel(session.queue, kernel, 1, nullptr, &global, nullptr, 1, &slot.upload, &slot.compute) );
+        checkOpenCLError( clEnqueueReadBuffer(downloadQueue, slot.deviceOut, CL_FALSE, 0, slot.bytes, slot.hostOut, 1, &slot.compute, &slot.download) );
+        // Submit now, the next wait may be several chunks away.
+        checkOpenCLError( clFlush(uploadQueue) );
+        checkOpenCLError( clFlush(session.queue) );
+        checkOpenCLError( clFlush(downloadQueue) );
+        slot.busy = true;
+    }
+    // Drain in chunk order so the output stays in input order.
+    for(size_t idx = 0; idx < slots.size(); ++idx) {
+        auto& slot = slots[(chunks + idx) % depth];
+        if(slot.busy) {
+            retire(slot);
+        }
+    }
+    report.wallNanoseconds = nanosecondsSince(start);
+
+    report.bytes = fileSize;
+    report.chunks = chunks;
+    report.chunkBytes = chunkBytes;
+    report.ringDepth = depth;
+    const char* names[kStageCount] = {"read", "upload", "compute", "download", "write"};
+    report.stages.clear();
+    for(int stage = 0; stage < kStageCount; ++stage) {
+        report.stages.push_back({names[stage], busy[stage]});
+    }
+
+    for(auto& slot : slots) {
+        checkOpenCLError( clEnqueueUnmapMemObject(uploadQueue, slot.pinnedIn, slot.hostIn, 0, nullptr, nullptr) );
+        checkOpenCLError( clEnqueueUnmapMemObject(downloadQueue, slot.pinnedOut, slot.hostOut, 0, nullptr, nullptr) );
+    }
+    checkOpenCLError( clFinish(uploadQueue) );
+    checkOpenCLError( clFinish(downloadQueue) );
+    for(auto& slot : slots) {
+        clReleaseMemObject(slot.deviceOut);
+        clReleaseMemObject(slot.deviceIn);
+        clReleaseMemObject(slot.pinnedOut);
+        clReleaseMemObject(slot.pinnedIn);
+    }
+    clReleaseKernel(kernel);
+    clReleaseProgram(program);
+    clReleaseCommandQueue(downloadQueue);
+    clReleaseCommandQueue(uploadQueue);
+    session.release();
+    munmap(mapping, fileSize);
+
+    if(output.is_open() && !output) {
+        error = "failed writing " + options.outputPath;
+        return false;
+    }
+    return true;
+}
+
+void printStreamReport(const StreamReport& report) {
+    double seconds = report.wallNanoseconds / 1e9;
+    std::cout << "Streamed " << formatBytes(report.bytes) << " in " << report.chunks << " chunks of " << formatBytes(report.chunkBytes)
+              << " through a ring of " << report.ringDepth << ": " << std::fixed << std::setprecision(3) << seconds * 1000 << " ms, "
+              << std::setprecision(2) << (seconds > 0 ? report.bytes / seconds / 1e9 : 0.0) << " GB/s end to end" << std::defaultfloat << std::endl;
+
+    // A stage near 100% is the bottleneck, the others wait on it.
+    const StageUtilization* bottleneck = nullptr;
+    for(const auto& stage : report.stages) {
+        double utilization = report.wallNanoseconds > 0 ? static_cast<double>(stage.busyNanoseconds) / report.wallNanoseconds : 0.0;
+        double stageSeconds = stage.busyNanoseconds / 1e9;
+        std::cout << "    " << std::left << std::setw(10) << stage.name << std::right << std::fixed
+                  << std::setprecision(3) << std::setw(12) << stage.busyNanoseconds / 1e6 << " ms busy"
+                  << std::setprecision(1) << std::setw(8) << utilization * 100 << "%"
+                  << std::setprecision(2) << std::setw(10) << (stageSeconds > 0 ? report.bytes / stageSeconds / 1e9 : 0.0) << " GB/s"
+                  << std::defaultfloat << std::endl;
+        if(!bottleneck || stage.busyNanoseconds > bottleneck->busyNanoseconds) {
+            bottleneck = &stage;
+        }
+    }
+    if(bottleneck) {
+        std::cout << "Bottleneck: " << bottleneck->name << std::endl;
+    }
+}
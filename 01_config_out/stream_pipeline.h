@@ -0,0 +1,43 @@
+#ifndef STREAM_PIPELINE_H
+#define STREAM_PIPELINE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "device_inventory.h"
+
+struct StreamOptions {
+    std::string inputPath;
+    // Empty: results are downloaded but discarded.
+    std::string outputPath;
+    size_t chunkBytes = 16u << 20;
+    // Ring slots, 2 for double buffering, 3 for triple buffering.
+    int ringDepth = 3;
+};
+
+struct StageUtilization {
+    std::string name;
+    // Host stages are timed with the host clock, device stages with profiling events.
+    uint64_t busyNanoseconds = 0;
+};
+
+struct StreamReport {
+    uint64_t bytes = 0;
+    size_t chunks = 0;
+    size_t chunkBytes = 0;
+    int ringDepth = 0;
+    uint64_t wallNanoseconds = 0;
+    // read (mmap -> pinned staging), upload, compute, download, write (pinned staging -> output stream).
+    std::vector<StageUtilization> stages;
+};
+
+// Stream the file through the device in chunks: the input is mmap()ed and copied chunk by chunk into a ring of pinned staging buffers
+// (CL_MEM_ALLOC_HOST_PTR, mapped once), uploaded on one queue, transformed on a second and downloaded on a third, each step waiting on
+// the event of the previous one. While chunk i computes, chunk i+1 uploads and chunk i-1 downloads.
+// The input may be larger than CL_DEVICE_GLOBAL_MEM_SIZE, only ringDepth chunks are resident at a time.
+bool runStreamPipeline(const DeviceRecord& record, const StreamOptions& options, StreamReport& report, std::string& error);
+
+void printStreamReport(const StreamReport& report);
+
+#endif //STREAM_PIPELINE_H
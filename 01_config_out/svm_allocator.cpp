@@ -0,0 +1,88 @@
+#include "svm_allocator.h"
+
+#include "opencl_utils.h"
+
+namespace {
+
+// Region alignment, enough for any OpenCL C type up to long16.
+const cl_uint kRegionAlignment = 128;
+
+}
+
+SvmGranularity svmGranularityOf(cl_device_svm_capabilities capabilities) {
+    if(capabilities & (CL_DEVICE_SVM_FINE_GRAIN_BUFFER | CL_DEVICE_SVM_FINE_GRAIN_SYSTEM)) {
+        return SvmGranularity::FineGrainBuffer;
+    }
+    if(capabilities & CL_DEVICE_SVM_COARSE_GRAIN_BUFFER) {
+        return SvmGranularity::CoarseGrainBuffer;
+    }
+    return SvmGranularity::None;
+}
+
+const char* svmGranularityName(SvmGranularity granularity) {
+    switch(granularity) {
+        case SvmGranularity::None:
+            return "none";
+        case SvmGranularity::CoarseGrainBuffer:
+            return "coarse-grained buffer";
+        case SvmGranularity::FineGrainBuffer:
+            return "fine-grained buffer";
+    }
+    return "unknown";
+}
+
+SvmArena::SvmArena(cl_context context, SvmGranularity granularity, size_t capacity) : context_(context), granularity_(granularity) {
+    if(granularity == SvmGranularity::None || capacity == 0) {
+        return;
+    }
+    cl_svm_mem_flags flags = CL_MEM_READ_WRITE;
+    if(granularity == SvmGranularity::FineGrainBuffer) {
+        flags |= CL_MEM_SVM_FINE_GRAIN_BUFFER;
+    }
+    base_ = clSVMAlloc(context, flags, capacity, kRegionAlignment);
+    if(base_) {
+        capacity_ = capacity;
+    }
+}
+
+SvmArena::~SvmArena() {
+    if(base_) {
+        clSVMFree(context_, base_);
+    }
+}
+
+void* SvmArena::allocate(size_t bytes, size_t alignment) {
+    size_t offset = (used_ + alignment - 1) / alignment * alignment;
+    if(!base_ || offset + bytes > capacity_) {
+        return nullptr;
+    }
+    used_ = offset + bytes;
+    return static_cast<char*>(base_) + offset;
+}
+
+void SvmArena::beginHostAccess(cl_command_queue queue) {
+    if(granularity_ != SvmGranularity::CoarseGrainBuffer || !base_ || mapped_) {
+        return;
+    }
+    checkOpenCLError( clEnqueueSVMMap(queue, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, base_, capacity_, 0, nullptr, nullptr) );
+    mapped_ = true;
+}
+
+void SvmArena::endHostAccess(cl_command_queue queue) {
+    if(!mapped_) {
+        return;
+    }
+    cl_event event;
+    checkOpenCLError( clEnqueueSVMUnmap(queue, base_, 0, nullptr, &event) );
+    checkOpenCLError( clWaitForEvents(1, &event) );
+    clReleaseEvent(event);
+    mapped_ = false;
+}
+
+void SvmArena::setKernelArg(cl_kernel kernel, cl_uint index, const void* pointer) const {
+    checkOpenCLError( clSetKernelArgSVMPointer(kernel, index, pointer) );
+    // Pointers the kernel loads from the region point into the same allocation as the argument, declaring it keeps drivers that
+    // migrate allocations on demand from missing it.
+    void* regions[] = {base_};
+    checkOpenCLError( clSetKernelExecInfo(kernel, CL_KERNEL_EXEC_INFO_SVM_PTRS, sizeof(regions), regions) );
+}
@@ -0,0 +1,94 @@
+#ifndef SVM_ALLOCATOR_H
+#define SVM_ALLOCATOR_H
+
+#include <cstddef>
+#include <new>
+
+#include <CL/cl.h>
+
+enum class SvmGranularity {
+    None,
+    // Host access only between clEnqueueSVMMap and clEnqueueSVMUnmap, the device sees the data after the unmap.
+    CoarseGrainBuffer,
+    // Host and device share the allocation directly, consistent at kernel boundaries.
+    FineGrainBuffer,
+};
+
+// The best kind of clSVMAlloc memory the device supports. Fine-grained system SVM implies fine-grained buffers.
+SvmGranularity svmGranularityOf(cl_device_svm_capabilities capabilities);
+const char* svmGranularityName(SvmGranularity granularity);
+
+// One clSVMAlloc region handing out pieces by bumping an offset, so a whole pointer-rich structure lives in a single SVM allocation:
+// pointers between its nodes stay valid on the device, and a coarse-grained region is mapped and unmapped with one call each.
+// Pieces are only freed together with the arena.
+class SvmArena {
+public:
+    SvmArena(cl_context context, SvmGranularity granularity, size_t capacity);
+    ~SvmArena();
+
+    SvmArena(const SvmArena&) = delete;
+    SvmArena& operator=(const SvmArena&) = delete;
+
+    // False if clSVMAlloc failed (or granularity is None), every allocation then fails.
+    bool valid() const { return base_ != nullptr; }
+
+    // nullptr once the region is exhausted.
+    void* allocate(size_t bytes, size_t alignment);
+
+    // Bracket host reads and writes. Blocking map/unmap of the whole region for coarse-grained SVM, no-ops for fine-grained SVM,
+    // where the caller only has to wait for the kernels using the region.
+    void beginHostAccess(cl_command_queue queue);
+    void endHostAccess(cl_command_queue queue);
+
+    // Pass a pointer into the region as kernel argument, and declare the region for the pointers the kernel finds inside it.
+    void setKernelArg(cl_kernel kernel, cl_uint index, const void* pointer) const;
+
+    SvmGranularity granularity() const { return granularity_; }
+    size_t used() const { return used_; }
+    size_t capacity() const { return capacity_; }
+
+private:
+    cl_context context_;
+    SvmGranularity granularity_;
+    void* base_ = nullptr;
+    size_t capacity_ = 0;
+    size_t used_ = 0;
+    bool mapped_ = false;
+};
+
+// Standard library allocator over an SvmArena, e.g. std::vector<Node, SvmStlAllocator<Node>>. deallocate() is a no-op, the arena owns
+// the memory; containers must not outlive their arena.
+template <typename T>
+class SvmStlAllocator {
+public:
+    using value_type = T;
+
+    explicit SvmStlAllocator(SvmArena& arena) : arena_(&arena) {}
+    template <typename U>
+    SvmStlAllocator(const SvmStlAllocator<U>& other) : arena_(other.arena()) {}
+
+    T* allocate(size_t count) {
+        void* memory = arena_->allocate(count * sizeof(T), alignof(T));
+        if(!memory) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(memory);
+    }
+    void deallocate(T*, size_t) {}
+
+    SvmArena* arena() const { return arena_; }
+
+private:
+    SvmArena* arena_;
+};
+
+template <typename T, typename U>
+bool operator==(const SvmStlAllocator<T>& a, const SvmStlAllocator<U>& b) {
+    return a.arena() == b.arena();
+}
+template <typename T, typename U>
+bool operator!=(const SvmStlAllocator<T>& a, const SvmStlAllocator<U>& b) {
+    return !(a == b);
+}
+
+#endif //SVM_ALLOCATOR_H
@@ -0,0 +1,322 @@
+#include "svm_benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "device_session.h"
+#include "opencl_utils.h"
+
+namespace {
+
+// The SVM kernel walks the host's own node layout, the flattened one follows indices (-1 for no child).
+const char* kTreeSource = R"CLC(
+typedef struct TreeNode {
+    int key;
+    int value;
+    __global struct TreeNode* left;
+    __global struct TreeNode* right;
+} TreeNode;
+
+typedef struct {
+    int key;
+    int value;
+    int left;
+    int right;
+} FlatNode;
+
+__kernel void lookup_svm(__global const TreeNode* root, __global const int* keys, __global int* results, uint count) {
+    uint i = get_global_id(0);
+    if(i >= count) {
+        return;
+    }
+    int key = keys[i];
+    int result = -1;
+    __global const TreeNode* node = root;
+    while(node) {
+        if(key == node->key) {
+            result = node->value;
+            break;
+        }
+        node = key < node->key ? node->left : node->right;
+    }
+    results[i] = result;
+}
+
+__kernel void lookup_flat(__global const FlatNode* nodes, __global const int* keys, __global int* results, uint count) {
+    uint i = get_global_id(0);
+    if(i >= count) {
+        return;
+    }
+    int key = keys[i];
+    int result = -1;
+    int node = 0;
+    while(node >= 0) {
+        if(key == nodes[node].key) {
+            result = nodes[node].value;
+            break;
+        }
+        node = key < nodes[node].key ? nodes[node].left : nodes[node].right;
+    }
+    results[i] = result;
+}
+)CLC";
+
+// Same layout as the OpenCL C TreeNode as long as host and device pointers have the same size, which measureSvmTree checks.
+struct TreeNode {
+    cl_int key;
+    cl_int value;
+    TreeNode* left;
+    TreeNode* right;
+};
+
+struct FlatNode {
+    cl_int key;
+    cl_int value;
+    cl_int left;
+    cl_int right;
+};
+
+cl_int keyOf(size_t index) {
+    return static_cast<cl_int>(2 * index + 1);
+}
+
+cl_int valueOf(cl_int key, int round) {
+    return key * 3 + round;
+}
+
+// Balanced tree over the keys of [lo, hi), nodes appended to a vector reserved for all of them so their addresses never change.
+template <typename Allocator>
+TreeNode* buildTree(std::vector<TreeNode, Allocator>& nodes, size_t lo, size_t hi) {
+    if(lo >= hi) {
+        return nullptr;
+    }
+    size_t mid = lo + (hi - lo) / 2;
+    nodes.push_back({keyOf(mid), 0, nullptr, nullptr});
+    TreeNode* node = &nodes.back();
+    node->left = buildTree(nodes, lo, mid);
+    node->right = buildTree(nodes, mid + 1, hi);
+    return node;
+}
+
+template <typename Allocator>
+void updateValues(std::vector<TreeNode, Allocator>& nodes, int round) {
+    for(auto& node : nodes) {
+        node.value = valueOf(node.key, round);
+    }
+}
+
+// What an upload of a pointer-linked structure costs without SVM: walk it and relocate every pointer to an index.
+void flattenTree(const TreeNode* root, std::vector<FlatNode>& flat) {
+    struct Pending {
+        const TreeNode* node;
+        cl_int parent;
+        bool right;
+    };
+    flat.clear();
+    std::vector<Pending> stack;
+    if(root) {
+        stack.push_back({root, -1, false});
+    }
+    while(!stack.empty()) {
+        auto pending = stack.back();
+        stack.pop_back();
+        auto index = static_cast<cl_int>(flat.size());
+        flat.push_back({pending.node->key, pending.node->value, -1, -1});
+        if(pending.parent >= 0) {
+            (pending.right ? flat[pending.parent].right : flat[pending.parent].left) = index;
+        }
+        if(pending.node->right) {
+            stack.push_back({pending.node->right, index, true});
+        }
+        if(pending.node->left) {
+            stack.push_back({pending.node->left, index, false});
+        }
+    }
+}
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct RoundTimes {
+    std::vector<double> prepare;
+    std::vector<double> upload;
+    std::vector<double> kernel;
+    std::vector<double> total;
+
+    void summarizeInto(SvmTreeSample& sample) const {
+        sample.prepareMilliseconds = summarize(prepare);
+        sample.uploadMilliseconds = summarize(upload);
+        sample.kernelMilliseconds = summarize(kernel);
+        sample.totalMilliseconds = summarize(total);
+    }
+};
+
+// Search every key and read the results back, returns the kernel time in milliseconds.
+double runLookups(const DeviceSession& session, cl_kernel kernel, cl_mem results, std::vector<cl_int>& hostResults) {
+    size_t global = hostResults.size();
+    cl_event event;
+    checkOpenCLError( clEnqueueNDRangeKernel(session.queue, kernel, 1, nullptr, &global, nullptr, 0, nullptr, &event) );
+    checkOpenCLError( clEnqueueReadBuffer(session.queue, results, CL_TRUE, 0, global * sizeof(cl_int), hostResults.data(), 1, &event, nullptr) );
+    auto nanoseconds = eventElapsedNanoseconds(event);
+    clReleaseEvent(event);
+    return nanoseconds / 1e6;
+}
+
+size_t countMismatches(const std::vector<cl_int>& keys, const std::vector<cl_int>& results, int round) {
+    size_t mismatches = 0;
+    for(size_t idx = 0; idx < keys.size(); ++idx) {
+        if(results[idx] != valueOf(keys[idx], round)) {
+            ++mismatches;
+        }
+    }
+    return mismatches;
+}
+
+}
+
+SvmTreeReport measureSvmTree(const DeviceRecord& record, size_t nodes, size_t lookups, int repetitions) {
+    SvmTreeReport report;
+    const auto& caps = record.caps;
+    report.nodes = nodes = std::max<size_t>(nodes, 1);
+    report.lookups = lookups = std::max<size_t>(lookups, 1);
+    report.granularity = svmGranularityOf(caps.svmCapabilities);
+    if(report.granularity == SvmGranularity::None) {
+        report.svmSkipReason = "no SVM support";
+    }
+    else if(caps.addressBits != sizeof(void*) * 8) {
+        report.svmSkipReason = "device pointers are " + std::to_string(caps.addressBits) + " bits, host pointers " + std::to_string(sizeof(void*) * 8);
+    }
+    bool svm = report.svmSkipReason.empty();
+
+    std::mt19937 random(42);
+    std::uniform_int_distribution<size_t> pick(0, nodes - 1);
+    std::vector<cl_int> keys(lookups), results(lookups);
+    for(auto& key : keys) {
+        key = keyOf(pick(random));
+    }
+
+    auto session = DeviceSession::create(record.device);
+    cl_int err;
+    cl_mem keysBuffer = clCreateBuffer(session.context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, lookups * sizeof(cl_int), keys.data(), &err);
+    checkOpenCLError(err);
+    cl_mem resultsBuffer = clCreateBuffer(session.context, CL_MEM_WRITE_ONLY, lookups * sizeof(cl_int), nullptr, &err);
+    checkOpenCLError(err);
+    cl_program program = buildProgram(session.context, record.device, kTreeSource, svm ? "-cl-std=CL2.0" : "");
+    cl_uint count = static_cast<cl_uint>(lookups);
+
+    // Flatten and copy.
+    {
+        std::vector<TreeNode> tree;
+        tree.reserve(nodes);
+        TreeNode* root = buildTree(tree, 0, nodes);
+        std::vector<FlatNode> flat;
+        flat.reserve(nodes);
+        cl_mem flatBuffer = clCreateBuffer(session.context, CL_MEM_READ_ONLY, nodes * sizeof(FlatNode), nullptr, &err);
+        checkOpenCLError(err);
+        cl_kernel kernel = createKernel(program, "lookup_flat");
+        checkOpenCLError( clSetKernelArg(kernel, 0, sizeof(cl_mem), &flatBuffer) );
+        checkOpenCLError( clSetKernelArg(kernel, 1, sizeof(cl_mem), &keysBuffer) );
+        checkOpenCLError( clSetKernelArg(kernel, 2, sizeof(cl_mem), &resultsBuffer) );
+        checkOpenCLError( clSetKernelArg(kernel, 3, sizeof(cl_uint), &count) );
+
+        RoundTimes times;
+        // Round 0 is an untimed warm-up.
+        for(int round = 0; round <= repetitions; ++round) {
+            auto start = std::chrono::steady_clock::now();
+            updateValues(tree, round);
+            flattenTree(root, flat);
+            double prepare = millisecondsSince(start);
+            auto uploadStart = std::chrono::steady_clock::now();
+            checkOpenCLError( clEnqueueWriteBuffer(session.queue, flatBuffer, CL_TRUE, 0, flat.size() * sizeof(FlatNode), flat.data(), 0, nullptr, nullptr) );
+            double upload = millisecondsSince(uploadStart);
+            double kernelMilliseconds = runLookups(session, kernel, resultsBuffer, results);
+            double total = millisecondsSince(start);
+            report.flatten.mismatches += countMismatches(keys, results, round);
+            if(round > 0) {
+                times.prepare.push_back(prepare);
+                times.upload.push_back(upload);
+                times.kernel.push_back(kernelMilliseconds);
+                times.total.push_back(total);
+            }
+        }
+        times.summarizeInto(report.flatten);
+        clReleaseKernel(kernel);
+        clReleaseMemObject(flatBuffer);
+    }
+
+    // The same tree in SVM, nothing to convert.
+    if(svm) {
+        SvmArena arena(session.context, report.granularity, nodes * sizeof(TreeNode) + alignof(TreeNode));
+        if(!arena.valid()) {
+            report.svmSkipReason = "clSVMAlloc of " + std::to_string(nodes * sizeof(TreeNode)) + " bytes failed";
+        }
+        else {
+            arena.beginHostAccess(session.queue);
+            std::vector<TreeNode, SvmStlAllocator<TreeNode>> tree{SvmStlAllocator<TreeNode>(arena)};
+            tree.reserve(nodes);
+            TreeNode* root = buildTree(tree, 0, nodes);
+            arena.endHostAccess(session.queue);
+            cl_kernel kernel = createKernel(program, "lookup_svm");
+            arena.setKernelArg(kernel, 0, root);
+            checkOpenCLError( clSetKernelArg(kernel, 1, sizeof(cl_mem), &keysBuffer) );
+            checkOpenCLError( clSetKernelArg(kernel, 2, sizeof(cl_mem), &resultsBuffer) );
+            checkOpenCLError( clSetKernelArg(kernel, 3, sizeof(cl_uint), &count) );
+
+            RoundTimes times;
+            for(int round = 0; round <= repetitions; ++round) {
+                auto start = std::chrono::steady_clock::now();
+                arena.beginHostAccess(session.queue);
+                updateValues(tree, round);
+                arena.endHostAccess(session.queue);
+                double prepare = millisecondsSince(start);
+                double kernelMilliseconds = runLookups(session, kernel, resultsBuffer, results);
+                double total = millisecondsSince(start);
+                report.svm.mismatches += countMismatches(keys, results, round);
+                if(round > 0) {
+                    times.prepare.push_back(prepare);
+                    times.upload.push_back(0.0);
+                    times.kernel.push_back(kernelMilliseconds);
+                    times.total.push_back(total);
+                }
+            }
+            times.summarizeInto(report.svm);
+            clReleaseKernel(kernel);
+            // The vector's destructor touches no node memory, the arena goes with it.
+        }
+    }
+
+    clReleaseProgram(program);
+    clReleaseMemObject(resultsBuffer);
+    clReleaseMemObject(keysBuffer);
+    session.release();
+    return report;
+}
+
+void printSvmTreeReport(const SvmTreeReport& report) {
+    std::cout << "Binary search tree of " << report.nodes << " nodes, " << report.lookups << " lookups per round, SVM: "
+              << svmGranularityName(report.granularity) << std::endl;
+    std::cout << std::left << std::setw(20) << "Median ms per round" << std::right << std::setw(10) << "prepare" << std::setw(10) << "upload"
+              << std::setw(10) << "kernel" << std::setw(10) << "total" << std::setw(12) << "mismatches" << std::endl;
+    auto row = [](const char* name, const SvmTreeSample& sample) {
+        std::cout << std::left << std::setw(20) << name << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(10) << sample.prepareMilliseconds.median << std::setw(10) << sample.uploadMilliseconds.median
+                  << std::setw(10) << sample.kernelMilliseconds.median << std::setw(10) << sample.totalMilliseconds.median
+                  << std::setw(12) << sample.mismatches << std::defaultfloat << std::endl;
+    };
+    row("flatten + copy", report.flatten);
+    if(!report.svmSkipReason.empty()) {
+        std::cout << "SVM path skipped: " << report.svmSkipReason << std::endl;
+        return;
+    }
+    row("SVM pointers", report.svm);
+    if(report.svm.totalMilliseconds.median > 0 && report.flatten.totalMilliseconds.median > 0) {
+        std::cout << "SVM rounds take " << std::fixed << std::setprecision(2)
+                  << report.svm.totalMilliseconds.median / report.flatten.totalMilliseconds.median << "x the time of flatten + copy"
+                  << std::defaultfloat << std::endl;
+    }
+}
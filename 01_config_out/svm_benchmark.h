@@ -0,0 +1,40 @@
+#ifndef SVM_BENCHMARK_H
+#define SVM_BENCHMARK_H
+
+#include <string>
+
+#include "device_inventory.h"
+#include "statistics.h"
+#include "svm_allocator.h"
+
+// Per-round cost of one way of getting an updated host-built tree to the device and searching it there.
+struct SvmTreeSample {
+    // Host side: updating the values plus flattening, or plus mapping/unmapping a coarse-grained region.
+    Summary prepareMilliseconds;
+    // Blocking upload of the flattened nodes, 0 for SVM.
+    Summary uploadMilliseconds;
+    Summary kernelMilliseconds;
+    // Whole round including reading the lookup results back.
+    Summary totalMilliseconds;
+    // Lookups whose result disagrees with the host, over all rounds.
+    size_t mismatches = 0;
+};
+
+struct SvmTreeReport {
+    size_t nodes = 0;
+    size_t lookups = 0;
+    SvmGranularity granularity = SvmGranularity::None;
+    // Why the SVM path was not measured, empty if it was.
+    std::string svmSkipReason;
+    SvmTreeSample flatten;
+    SvmTreeSample svm;
+};
+
+// A balanced binary search tree of `nodes` pointer-linked nodes is built on the host, once with plain allocations and once in an
+// SvmArena through SvmStlAllocator. Every round updates all values and searches `lookups` keys on the device: the first copy is
+// flattened to index-linked nodes and uploaded, the second is handed to the kernel as it is with clSetKernelArgSVMPointer.
+SvmTreeReport measureSvmTree(const DeviceRecord& record, size_t nodes, size_t lookups, int repetitions);
+
+void printSvmTreeReport(const SvmTreeReport& report);
+
+#endif //SVM_BENCHMARK_H
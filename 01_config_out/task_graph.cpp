@@ -0,0 +1,379 @@
+#include "task_graph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+#include "device_session.h"
+#include "opencl_utils.h"
+
+namespace {
+
+const char* kGraphSource = R"CLC(
+__kernel void burn(__global float* data, int rounds) {
+    size_t i = get_global_id(0);
+    float v = data[i];
+    for(int r = 0; r < rounds; ++r) {
+        v = mad(v, 0.999f, 0.001f);
+    }
+    data[i] = v;
+}
+
+__kernel void combine(__global float* out, __global const float* in, uint chains, uint elements) {
+    size_t i = get_global_id(0);
+    float sum = 0.0f;
+    for(uint c = 0; c < chains; ++c) {
+        sum += in[c * elements + i];
+    }
+    out[i] = sum;
+}
+)CLC";
+
+const size_t kGraphElements = 1 << 20;
+const cl_int kBurnRounds = 256;
+
+void appendUnique(std::vector<size_t>& values, size_t value) {
+    if(value != SIZE_MAX && std::find(values.begin(), values.end(), value) == values.end()) {
+        values.push_back(value);
+    }
+}
+
+cl_int enqueueTask(cl_command_queue queue, const GraphTask& task, const std::vector<cl_event>& waitList, cl_event* event) {
+    auto count = static_cast<cl_uint>(waitList.size());
+    auto events = waitList.empty() ? nullptr : waitList.data();
+    switch(task.kind) {
+        case TaskKind::Kernel:
+            return clEnqueueNDRangeKernel(queue, task.kernel, static_cast<cl_uint>(task.globalSize.size()), nullptr, task.globalSize.data(),
+                                          task.localSize.empty() ? nullptr : task.localSize.data(), count, events, event);
+        case TaskKind::Write:
+            return clEnqueueWriteBuffer(queue, task.buffer, CL_FALSE, 0, task.bytes, task.host, count, events, event);
+        case TaskKind::Read:
+            return clEnqueueReadBuffer(queue, task.buffer, CL_FALSE, 0, task.bytes, task.host, count, events, event);
+        case TaskKind::Copy:
+            return clEnqueueCopyBuffer(queue, task.buffer, task.destination, 0, 0, task.bytes, count, events, event);
+    }
+    return CL_INVALID_VALUE;
+}
+
+bool supportsOutOfOrder(const DeviceCapabilities& caps) {
+    return (caps.queueOnHostProperties & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE) != 0;
+}
+
+}
+
+size_t TaskGraph::add(GraphTask task, const std::vector<cl_mem>& reads, const std::vector<cl_mem>& writes) {
+    size_t index = tasks_.size();
+    for(auto buffer : reads) {
+        appendUnique(task.dependencies, access_[buffer].lastWriter);
+    }
+    for(auto buffer : writes) {
+        auto& access = access_[buffer];
+        appendUnique(task.dependencies, access.lastWriter);
+        for(auto reader : access.readers) {
+            appendUnique(task.dependencies, reader);
+        }
+    }
+    // Update after every dependency is known, a task both reading and writing a buffer must not depend on itself.
+    for(auto buffer : reads) {
+        access_[buffer].readers.push_back(index);
+    }
+    for(auto buffer : writes) {
+        auto& access = access_[buffer];
+        access.lastWriter = index;
+        access.readers.clear();
+    }
+    tasks_.push_back(std::move(task));
+    return index;
+}
+
+size_t TaskGraph::addKernel(const std::string& name, cl_kernel kernel, const std::vector<size_t>& globalSize, const std::vector<size_t>& localSize,
+                            const std::vector<cl_mem>& reads, const std::vector<cl_mem>& writes) {
+    GraphTask task;
+    task.name = name;
+    task.kind = TaskKind::Kernel;
+    task.kernel = kernel;
+    task.globalSize = globalSize;
+    task.localSize = localSize;
+    return add(std::move(task), reads, writes);
+}
+
+size_t TaskGraph::addWrite(const std::string& name, cl_mem buffer, size_t bytes, const void* host) {
+    GraphTask task;
+    task.name = name;
+    task.kind = TaskKind::Write;
+    task.buffer = buffer;
+    task.bytes = bytes;
+    task.host = const_cast<void*>(host);
+    return add(std::move(task), {}, {buffer});
+}
+
+size_t TaskGraph::addRead(const std::string& name, cl_mem buffer, size_t bytes, void* host) {
+    GraphTask task;
+    task.name = name;
+    task.kind = TaskKind::Read;
+    task.buffer = buffer;
+    task.bytes = bytes;
+    task.host = host;
+    return add(std::move(task), {buffer}, {});
+}
+
+size_t TaskGraph::addCopy(const std::string& name, cl_mem source, cl_mem destination, size_t bytes) {
+    GraphTask task;
+    task.name = name;
+    task.kind = TaskKind::Copy;
+    task.buffer = source;
+    task.destination = destination;
+    task.bytes = bytes;
+    return add(std::move(task), {source}, {destination});
+}
+
+void TaskGraph::addDependency(size_t task, size_t dependsOn) {
+    if(dependsOn < task && task < tasks_.size()) {
+        appendUnique(tasks_[task].dependencies, dependsOn);
+    }
+}
+
+const char* graphQueueModeName(GraphQueueMode mode) {
+    switch(mode) {
+        case GraphQueueMode::Auto:
+            return "auto";
+        case GraphQueueMode::OutOfOrder:
+            return "out-of-order";
+        case GraphQueueMode::InOrderQueues:
+            return "in-order queues";
+        case GraphQueueMode::Serialized:
+            return "serialized";
+    }
+    return "unknown";
+}
+
+GraphReport executeTaskGraph(cl_context context, cl_device_id device, const DeviceCapabilities& caps, const TaskGraph& graph,
+                             GraphQueueMode mode, size_t inOrderQueues) {
+    if(mode == GraphQueueMode::Auto) {
+        mode = supportsOutOfOrder(caps) ? GraphQueueMode::OutOfOrder : GraphQueueMode::InOrderQueues;
+    }
+    GraphReport report;
+    report.mode = mode;
+    const auto& tasks = graph.tasks();
+
+    cl_int err;
+    cl_command_queue_properties properties = CL_QUEUE_PROFILING_ENABLE;
+    if(mode == GraphQueueMode::OutOfOrder) {
+        properties |= CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE;
+    }
+    cl_queue_properties queueProperties[] = {CL_QUEUE_PROPERTIES, properties, 0};
+    std::vector<cl_command_queue> queues(mode == GraphQueueMode::InOrderQueues ? std::max<size_t>(1, inOrderQueues) : 1);
+    for(auto& queue : queues) {
+        queue = clCreateCommandQueueWithProperties(context, device, queueProperties, &err);
+        checkOpenCLError(err);
+    }
+    report.queues = queues.size();
+
+    std::vector<cl_event> events(tasks.size(), nullptr);
+    std::vector<size_t> queueOf(tasks.size(), 0);
+    // Last task submitted to each in-order queue, SIZE_MAX while empty.
+    std::vector<size_t> tail(queues.size(), SIZE_MAX);
+
+    auto start = std::chrono::steady_clock::now();
+    for(size_t idx = 0; idx < tasks.size(); ++idx) {
+        const auto& task = tasks[idx];
+        size_t queue = 0;
+        if(mode == GraphQueueMode::InOrderQueues) {
+            // Continue a dependency's queue if nothing was queued behind it, else take the queue whose tail is the oldest.
+            queue = SIZE_MAX;
+            for(auto dep : task.dependencies) {
+                if(tail[queueOf[dep]] == dep) {
+                    queue = queueOf[dep];
+                    break;
+                }
+            }
+            if(queue == SIZE_MAX) {
+                queue = 0;
+                for(size_t q = 1; q < queues.size(); ++q) {
+                    if(tail[queue] != SIZE_MAX && (tail[q] == SIZE_MAX || tail[q] < tail[queue])) {
+                        queue = q;
+                    }
+                }
+            }
+        }
+        queueOf[idx] = queue;
+        tail[queue] = idx;
+
+        // An in-order queue already orders the tasks it runs, only dependencies on other queues need an event.
+        std::vector<cl_event> waitList;
+        for(auto dep : task.dependencies) {
+            if(mode == GraphQueueMode::OutOfOrder || queueOf[dep] != queue) {
+                waitList.push_back(events[dep]);
+            }
+        }
+        checkOpenCLError( enqueueTask(queues[queue], task, waitList, &events[idx]) );
+        if(mode == GraphQueueMode::Serialized) {
+            checkOpenCLError( clFinish(queues[queue]) );
+        }
+    }
+    for(auto queue : queues) {
+        checkOpenCLError( clFlush(queue) );
+    }
+    if(!events.empty()) {
+        checkOpenCLError( clWaitForEvents(static_cast<cl_uint>(events.size()), events.data()) );
+    }
+    report.wallNanoseconds = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<cl_ulong> starts(tasks.size()), ends(tasks.size());
+    for(size_t idx = 0; idx < tasks.size(); ++idx) {
+        checkOpenCLError( clGetEventProfilingInfo(events[idx], CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &starts[idx], nullptr) );
+        checkOpenCLError( clGetEventProfilingInfo(events[idx], CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &ends[idx], nullptr) );
+        clReleaseEvent(events[idx]);
+    }
+    for(auto queue : queues) {
+        clReleaseCommandQueue(queue);
+    }
+    if(tasks.empty()) {
+        return report;
+    }
+
+    cl_ulong origin = *std::min_element(starts.begin(), starts.end());
+    cl_ulong last = *std::max_element(ends.begin(), ends.end());
+    report.spanNanoseconds = static_cast<double>(last - origin);
+
+    // Longest path through the DAG by measured durations. Dependencies always have lower indices, one pass in index order suffices.
+    std::vector<double> finish(tasks.size(), 0.0);
+    std::vector<size_t> previous(tasks.size(), SIZE_MAX);
+    double busy = 0.0;
+    report.timings.resize(tasks.size());
+    for(size_t idx = 0; idx < tasks.size(); ++idx) {
+        double duration = ends[idx] > starts[idx] ? static_cast<double>(ends[idx] - starts[idx]) : 0.0;
+        busy += duration;
+        for(auto dep : tasks[idx].dependencies) {
+            if(finish[dep] > finish[idx]) {
+                finish[idx] = finish[dep];
+                previous[idx] = dep;
+            }
+        }
+        finish[idx] += duration;
+
+        auto& timing = report.timings[idx];
+        timing.name = tasks[idx].name;
+        timing.queue = queueOf[idx];
+        timing.startNanoseconds = static_cast<double>(starts[idx] - origin);
+        timing.endNanoseconds = static_cast<double>(ends[idx] - origin);
+    }
+    size_t end = static_cast<size_t>(std::max_element(finish.begin(), finish.end()) - finish.begin());
+    report.criticalPathNanoseconds = finish[end];
+    for(size_t idx = end; idx != SIZE_MAX; idx = previous[idx]) {
+        report.criticalPath.push_back(idx);
+        report.timings[idx].critical = true;
+    }
+    std::reverse(report.criticalPath.begin(), report.criticalPath.end());
+    report.concurrency = report.spanNanoseconds > 0 ? busy / report.spanNanoseconds : 0.0;
+    return report;
+}
+
+std::vector<GraphReport> measureTaskGraph(const DeviceRecord& record, size_t chains) {
+    std::vector<GraphReport> reports;
+    chains = std::max<size_t>(1, chains);
+    auto session = DeviceSession::create(record.device);
+    cl_program program = buildProgram(session.context, record.device, kGraphSource);
+    cl_int err;
+
+    size_t bytes = kGraphElements * sizeof(float);
+    std::vector<float> input(kGraphElements * chains, 1.0f), output(kGraphElements);
+    // All chains live in one buffer of the combining kernel, each chain works on its own buffer and is copied in at the end.
+    cl_mem gathered = clCreateBuffer(session.context, CL_MEM_READ_WRITE, bytes * chains, nullptr, &err);
+    checkOpenCLError(err);
+    cl_mem result = clCreateBuffer(session.context, CL_MEM_WRITE_ONLY, bytes, nullptr, &err);
+    checkOpenCLError(err);
+    std::vector<cl_mem> buffers;
+    std::vector<cl_kernel> kernels;
+
+    TaskGraph graph;
+    std::vector<size_t> global = {kGraphElements};
+    cl_int rounds = kBurnRounds;
+    for(size_t chain = 0; chain < chains; ++chain) {
+        cl_mem buffer = clCreateBuffer(session.context, CL_MEM_READ_WRITE, bytes, nullptr, &err);
+        checkOpenCLError(err);
+        buffers.push_back(buffer);
+        auto suffix = std::to_string(chain);
+        graph.addWrite("upload " + suffix, buffer, bytes, input.data() + chain * kGraphElements);
+        for(int step = 0; step < 2; ++step) {
+            cl_kernel kernel = createKernel(program, "burn");
+            checkOpenCLError( clSetKernelArg(kernel, 0, sizeof(cl_mem), &buffer) );
+            checkOpenCLError( clSetKernelArg(kernel, 1, sizeof(cl_int), &rounds) );
+            kernels.push_back(kernel);
+            graph.addKernel("burn " + suffix + (step == 0 ? "a" : "b"), kernel, global, {}, {buffer}, {buffer});
+        }
+    }
+    // Each chain is copied into its own sub-buffer slice of the gathered buffer. The combining kernel reads the parent buffer, but declares
+    // the slices as its inputs so it waits for every copy.
+    for(size_t chain = 0; chain < chains; ++chain) {
+        cl_buffer_region region = {chain * bytes, bytes};
+        cl_mem slice = clCreateSubBuffer(gathered, CL_MEM_READ_WRITE, CL_BUFFER_CREATE_TYPE_REGION, &region, &err);
+        checkOpenCLError(err);
+        buffers.push_back(slice);
+        graph.addCopy("gather " + std::to_string(chain), buffers[chain], slice, bytes);
+    }
+    cl_kernel combine = createKernel(program, "combine");
+    cl_uint chainCount = static_cast<cl_uint>(chains), elements = static_cast<cl_uint>(kGraphElements);
+    checkOpenCLError( clSetKernelArg(combine, 0, sizeof(cl_mem), &result) );
+    checkOpenCLError( clSetKernelArg(combine, 1, sizeof(cl_mem), &gathered) );
+    checkOpenCLError( clSetKernelArg(combine, 2, sizeof(cl_uint), &chainCount) );
+    checkOpenCLError( clSetKernelArg(combine, 3, sizeof(cl_uint), &elements) );
+    kernels.push_back(combine);
+    std::vector<cl_mem> slices(buffers.begin() + chains, buffers.end());
+    graph.addKernel("combine", combine, global, {}, slices, {result});
+    graph.addRead("download", result, bytes, output.data());
+
+    // Untimed warm-up which absorbs lazy compilation and first-touch allocation.
+    executeTaskGraph(session.context, record.device, record.caps, graph, GraphQueueMode::Serialized);
+
+    reports.push_back(executeTaskGraph(session.context, record.device, record.caps, graph, GraphQueueMode::Serialized));
+    reports.push_back(executeTaskGraph(session.context, record.device, record.caps, graph, GraphQueueMode::InOrderQueues, chains));
+    if(supportsOutOfOrder(record.caps)) {
+        reports.push_back(executeTaskGraph(session.context, record.device, record.caps, graph, GraphQueueMode::OutOfOrder));
+    }
+
+    for(auto kernel : kernels) {
+        clReleaseKernel(kernel);
+    }
+    // Sub-buffers first, they hold a reference to the gathered buffer.
+    for(auto it = buffers.rbegin(); it != buffers.rend(); ++it) {
+        clReleaseMemObject(*it);
+    }
+    clReleaseMemObject(result);
+    clReleaseMemObject(gathered);
+    clReleaseProgram(program);
+    session.release();
+    return reports;
+}
+
+void printTaskGraphReport(const std::vector<GraphReport>& reports) {
+    if(reports.empty()) {
+        return;
+    }
+    std::cout << std::left << std::setw(18) << "Mode" << std::right << std::setw(8) << "queues" << std::setw(12) << "wall us"
+              << std::setw(12) << "span us" << std::setw(14) << "critical us" << std::setw(13) << "concurrency" << std::setw(10) << "speedup" << std::endl;
+    double baseline = reports.front().wallNanoseconds;
+    for(const auto& report : reports) {
+        std::cout << std::left << std::setw(18) << graphQueueModeName(report.mode) << std::right << std::setw(8) << report.queues
+                  << std::fixed << std::setprecision(1)
+                  << std::setw(12) << report.wallNanoseconds / 1e3 << std::setw(12) << report.spanNanoseconds / 1e3
+                  << std::setw(14) << report.criticalPathNanoseconds / 1e3
+                  << std::setprecision(2) << std::setw(13) << report.concurrency
+                  << std::setw(9) << (report.wallNanoseconds > 0 ? baseline / report.wallNanoseconds : 0.0) << "x"
+                  << std::defaultfloat << std::endl;
+    }
+
+    // Timeline of the last (most concurrent) mode, critical path tasks marked with '*'.
+    const auto& last = reports.back();
+    std::cout << "Timeline (" << graphQueueModeName(last.mode) << "), * on the critical path:" << std::endl;
+    std::cout << std::left << std::setw(3) << "" << std::setw(14) << "Task" << std::right << std::setw(7) << "queue"
+              << std::setw(12) << "start us" << std::setw(12) << "end us" << std::setw(12) << "duration" << std::endl;
+    for(const auto& timing : last.timings) {
+        std::cout << std::left << std::setw(3) << (timing.critical ? " *" : "") << std::setw(14) << timing.name << std::right << std::setw(7) << timing.queue
+                  << std::fixed << std::setprecision(1)
+                  << std::setw(12) << timing.startNanoseconds / 1e3 << std::setw(12) << timing.endNanoseconds / 1e3
+                  << std::setw(12) << (timing.endNanoseconds - timing.startNanoseconds) / 1e3
+                  << std::defaultfloat << std::endl;
+    }
+}
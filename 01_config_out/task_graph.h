@@ -0,0 +1,116 @@
+#ifndef TASK_GRAPH_H
+#define TASK_GRAPH_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <CL/cl.h>
+
+#include "device_inventory.h"
+
+enum class TaskKind {
+    Kernel,
+    Write,
+    Read,
+    Copy,
+};
+
+struct GraphTask {
+    std::string name;
+    TaskKind kind = TaskKind::Kernel;
+
+    // Kernel: the arguments must be set on the kernel object, one kernel object per task.
+    cl_kernel kernel = nullptr;
+    std::vector<size_t> globalSize;
+    // Empty for the driver's choice.
+    std::vector<size_t> localSize;
+
+    // Write (host -> buffer), Read (buffer -> host) and Copy (buffer -> destination).
+    cl_mem buffer = nullptr;
+    cl_mem destination = nullptr;
+    size_t bytes = 0;
+    void* host = nullptr;
+
+    // Indices of the tasks this one waits for, always lower than its own index.
+    std::vector<size_t> dependencies;
+};
+
+// A DAG of kernels and transfers. Tasks are added in a valid submission order: data dependencies are derived from the buffers each task
+// reads and writes (read after write, write after read and write after write), further ordering can be added with addDependency.
+class TaskGraph {
+public:
+    size_t addKernel(const std::string& name, cl_kernel kernel, const std::vector<size_t>& globalSize, const std::vector<size_t>& localSize,
+                     const std::vector<cl_mem>& reads, const std::vector<cl_mem>& writes);
+    size_t addWrite(const std::string& name, cl_mem buffer, size_t bytes, const void* host);
+    size_t addRead(const std::string& name, cl_mem buffer, size_t bytes, void* host);
+    size_t addCopy(const std::string& name, cl_mem source, cl_mem destination, size_t bytes);
+
+    // task waits for dependsOn, which must have been added before it.
+    void addDependency(size_t task, size_t dependsOn);
+
+    const std::vector<GraphTask>& tasks() const { return tasks_; }
+
+private:
+    size_t add(GraphTask task, const std::vector<cl_mem>& reads, const std::vector<cl_mem>& writes);
+
+    struct Access {
+        // The last task writing the buffer, SIZE_MAX if none, and every task reading it since.
+        size_t lastWriter = SIZE_MAX;
+        std::vector<size_t> readers;
+    };
+
+    std::vector<GraphTask> tasks_;
+    std::map<cl_mem, Access> access_;
+};
+
+enum class GraphQueueMode {
+    // Out-of-order when CL_DEVICE_QUEUE_ON_HOST_PROPERTIES has CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE, several in-order queues otherwise.
+    Auto,
+    OutOfOrder,
+    InOrderQueues,
+    // One in-order queue and clFinish after every task, the baseline the other modes are measured against.
+    Serialized,
+};
+
+const char* graphQueueModeName(GraphQueueMode mode);
+
+struct TaskTiming {
+    std::string name;
+    // Queue the task went to, always 0 with an out-of-order queue.
+    size_t queue = 0;
+    // Device timestamps relative to the first task start.
+    double startNanoseconds = 0.0;
+    double endNanoseconds = 0.0;
+    bool critical = false;
+};
+
+struct GraphReport {
+    GraphQueueMode mode = GraphQueueMode::Auto;
+    size_t queues = 0;
+    // First task start to last task end on the device timeline, and host time from the first enqueue until every event completed.
+    double spanNanoseconds = 0.0;
+    double wallNanoseconds = 0.0;
+    // Longest dependency chain by measured task durations, and the tasks on it in order.
+    double criticalPathNanoseconds = 0.0;
+    std::vector<size_t> criticalPath;
+    // Sum of task durations over the span: 1 means no overlap at all.
+    double concurrency = 0.0;
+    std::vector<TaskTiming> timings;
+};
+
+// Submit the graph to the device without any host synchronization between tasks and wait for it to complete.
+// Out-of-order: one queue, each task waits on the events of its dependencies.
+// In-order queues: a task continues the queue of a dependency that is still that queue's last task (the queue orders them for free),
+// otherwise it goes to the queue idle the longest; dependencies on other queues become event wait-lists.
+GraphReport executeTaskGraph(cl_context context, cl_device_id device, const DeviceCapabilities& caps, const TaskGraph& graph,
+                             GraphQueueMode mode = GraphQueueMode::Auto, size_t inOrderQueues = 4);
+
+// Run a sample graph (independent upload -> compute -> compute chains joined by one combining kernel and a download) serialized, on
+// in-order queues and, when supported, on an out-of-order queue.
+std::vector<GraphReport> measureTaskGraph(const DeviceRecord& record, size_t chains);
+
+void printTaskGraphReport(const std::vector<GraphReport>& reports);
+
+#endif //TASK_GRAPH_H
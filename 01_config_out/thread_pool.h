@@ -0,0 +1,41 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed size pool of worker threads draining a FIFO of tasks.
+// Used to spread independent driver queries (one per device) so their latency overlaps instead of adding up.
+class ThreadPool {
+public:
+    // threadCount == 0 picks std::thread::hardware_concurrency().
+    explicit ThreadPool(size_t threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> task);
+    // Block until every submitted task has finished.
+    void wait();
+
+    size_t size() const { return workers_.size(); }
+
+private:
+    void run();
+
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable taskAvailable_;
+    std::condition_variable allDone_;
+    size_t busy_ = 0;
+    bool stopping_ = false;
+};
+
+#endif //THREAD_POOL_H
@@ -0,0 +1,100 @@
+#include "tuning_database.h"
+
+#include <cstring>
+#include <utility>
+
+#include "binary_archive.h"
+
+namespace {
+
+const char kTuningMagic[8] = {'C', 'L', 'T', 'U', 'N', 'E', '\0', '\0'};
+const uint32_t kTuningFormatVersion = 2;
+
+}
+
+TuningDatabase::TuningDatabase(std::string path) : path_(std::move(path)) {}
+
+bool TuningDatabase::load() {
+    std::vector<char> data;
+    if(!readWholeFile(path_, data)) {
+        return false;
+    }
+    if(data.size() < sizeof(kTuningMagic) || std::memcmp(data.data(), kTuningMagic, sizeof(kTuningMagic)) != 0) {
+        return false;
+    }
+    BinaryReader reader(data.data() + sizeof(kTuningMagic), data.size() - sizeof(kTuningMagic));
+    uint32_t version = 0;
+    uint64_t count = 0;
+    reader(version);
+    reader(count);
+    if(!reader.ok || version != kTuningFormatVersion) {
+        return false;
+    }
+
+    std::map<std::string, TuningRecord> entries;
+    for(uint64_t idx = 0; idx < count && reader.ok; ++idx) {
+        std::string key;
+        TuningRecord record;
+        reader(key);
+        reader(record.localSize);
+        reader(record.nanoseconds);
+        reader(record.variant);
+        entries[key] = std::move(record);
+    }
+    if(!reader.ok) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_ = std::move(entries);
+    dirty_ = false;
+    return true;
+}
+
+bool TuningDatabase::save() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(!dirty_) {
+        return true;
+    }
+
+    BinaryWriter writer;
+    writer.buffer.insert(writer.buffer.end(), kTuningMagic, kTuningMagic + sizeof(kTuningMagic));
+    writer(kTuningFormatVersion);
+    writer(static_cast<uint64_t>(entries_.size()));
+    for(const auto& entry : entries_) {
+        writer(entry.first);
+        writer(entry.second.localSize);
+        writer(entry.second.nanoseconds);
+        writer(entry.second.variant);
+    }
+    return replaceFile(path_, writer.buffer);
+}
+
+std::string TuningDatabase::makeKey(const DeviceCapabilities& caps, const std::string& kernelName, const std::vector<size_t>& globalSize) {
+    auto key = caps.name + '\n' + caps.driverVersion + '\n' + kernelName + '\n';
+    for(size_t dim = 0; dim < globalSize.size(); ++dim) {
+        key += (dim ? "x" : "") + std::to_string(globalSize[dim]);
+    }
+    return key;
+}
+
+bool TuningDatabase::find(const std::string& key, TuningRecord& record) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if(it == entries_.end()) {
+        return false;
+    }
+    record = it->second;
+    return true;
+}
+
+void TuningDatabase::store(const std::string& key, const TuningRecord& record) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_[key] = record;
+    dirty_ = true;
+}
+
+size_t TuningDatabase::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
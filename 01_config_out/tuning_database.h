@@ -0,0 +1,46 @@
+#ifndef TUNING_DATABASE_H
+#define TUNING_DATABASE_H
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "device_capabilities.h"
+
+// The winning launch configuration of one kernel on one device for one problem size.
+struct TuningRecord {
+    // Empty means the driver's choice (local size NULL) won.
+    std::vector<size_t> localSize;
+    // Median device time of the winner.
+    double nanoseconds = 0.0;
+    // Winning implementation when whole kernel variants compete (e.g. "register-blocked" GEMM), empty for plain work-group tuning.
+    std::string variant;
+};
+
+// On-disk database of tuning results, same file discipline as CapabilityCache: one read in load(), one write in save().
+// Entries are keyed by device name, driver version, kernel and global size, so a driver upgrade only invalidates the entries of that device.
+class TuningDatabase {
+public:
+    explicit TuningDatabase(std::string path);
+
+    bool load();
+    bool save() const;
+
+    static std::string makeKey(const DeviceCapabilities& caps, const std::string& kernelName, const std::vector<size_t>& globalSize);
+
+    // In-memory lookup, no driver call. Returns false if the kernel was never tuned for this device and size.
+    bool find(const std::string& key, TuningRecord& record) const;
+    void store(const std::string& key, const TuningRecord& record);
+
+    const std::string& path() const { return path_; }
+    size_t size() const;
+
+private:
+    std::string path_;
+    mutable std::mutex mutex_;
+    std::map<std::string, TuningRecord> entries_;
+    bool dirty_ = false;
+};
+
+#endif //TUNING_DATABASE_H
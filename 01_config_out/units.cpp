@@ -0,0 +1,48 @@
+#include "units.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+
+bool parseByteSize(const std::string& text, uint64_t& bytes) {
+    if(text.empty() || !std::isdigit(static_cast<unsigned char>(text[0]))) {
+        return false;
+    }
+    char* end = nullptr;
+    unsigned long long value = std::strtoull(text.c_str(), &end, 10);
+    std::string suffix(end);
+    if(suffix.empty() || suffix == "B") {
+        bytes = value;
+    }
+    else if(suffix == "K" || suffix == "KB" || suffix == "KiB") {
+        bytes = value << 10;
+    }
+    else if(suffix == "M" || suffix == "MB" || suffix == "MiB") {
+        bytes = value << 20;
+    }
+    else if(suffix == "G" || suffix == "GB" || suffix == "GiB") {
+        bytes = value << 30;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+std::string formatBytes(uint64_t bytes) {
+    const char* units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+    double value = static_cast<double>(bytes);
+    size_t unit = 0;
+    while(value >= 1024 && unit + 1 < sizeof(units) / sizeof(units[0])) {
+        value /= 1024;
+        ++unit;
+    }
+    char buffer[32];
+    if(value == static_cast<uint64_t>(value)) {
+        snprintf(buffer, sizeof(buffer), "%llu %s", static_cast<unsigned long long>(value), units[unit]);
+    }
+    else {
+        snprintf(buffer, sizeof(buffer), "%.1f %s", value, units[unit]);
+    }
+    return buffer;
+}
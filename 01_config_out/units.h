@@ -0,0 +1,13 @@
+#ifndef UNITS_H
+#define UNITS_H
+
+#include <cstdint>
+#include <string>
+
+// Parse a byte count with an optional K/M/G suffix (powers of 1024), e.g. "64K" or "4G". Returns false if malformed.
+bool parseByteSize(const std::string& text, uint64_t& bytes);
+
+// Human readable byte count, e.g. "64 KiB" or "1.5 GiB".
+std::string formatBytes(uint64_t bytes);
+
+#endif //UNITS_H
@@ -0,0 +1,217 @@
+#include "work_group_tuner.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+#include "opencl_utils.h"
+#include "statistics.h"
+
+namespace {
+
+const char* kSampleSource = R"CLC(
+__kernel void saxpy(__global const float* x, __global float* y, float a) {
+    size_t i = get_global_id(0);
+    y[i] = a * x[i] + y[i];
+}
+
+__kernel void box_blur(__global const float* in, __global float* out) {
+    int x = get_global_id(0);
+    int y = get_global_id(1);
+    int width = get_global_size(0);
+    int height = get_global_size(1);
+    float sum = 0.0f;
+    for(int dy = -1; dy <= 1; ++dy) {
+        for(int dx = -1; dx <= 1; ++dx) {
+            int sx = clamp(x + dx, 0, width - 1);
+            int sy = clamp(y + dy, 0, height - 1);
+            sum += in[sy * width + sx];
+        }
+    }
+    out[y * width + x] = sum / 9.0f;
+}
+)CLC";
+
+std::vector<size_t> dimensionCandidates(size_t global, size_t maxItems, size_t multiple) {
+    std::vector<size_t> sizes;
+    for(size_t size = 1; size <= maxItems; size *= 2) {
+        sizes.push_back(size);
+    }
+    if(multiple > 1) {
+        for(size_t size = multiple; size <= maxItems; size += multiple) {
+            sizes.push_back(size);
+        }
+    }
+    sizes.erase(std::remove_if(sizes.begin(), sizes.end(), [global](size_t size) { return global % size != 0; }), sizes.end());
+    std::sort(sizes.begin(), sizes.end());
+    sizes.erase(std::unique(sizes.begin(), sizes.end()), sizes.end());
+    return sizes;
+}
+
+// Median device time of the kernel with one local size, after one untimed warm-up launch.
+double timeLaunch(const DeviceSession& session, cl_kernel kernel, const std::vector<size_t>& globalSize, const std::vector<size_t>& localSize, int repetitions) {
+    std::vector<double> nanoseconds;
+    for(int rep = 0; rep <= repetitions; ++rep) {
+        cl_event event;
+        checkOpenCLError( enqueueTuned(session.queue, kernel, globalSize, localSize, 0, nullptr, &event) );
+        checkOpenCLError( clWaitForEvents(1, &event) );
+        if(rep > 0) {
+            nanoseconds.push_back(static_cast<double>(eventElapsedNanoseconds(event)));
+        }
+        clReleaseEvent(event);
+    }
+    return summarize(nanoseconds).median;
+}
+
+std::string formatLocalSize(const std::vector<size_t>& localSize) {
+    if(localSize.empty()) {
+        return "NULL";
+    }
+    std::string text;
+    for(size_t dim = 0; dim < localSize.size(); ++dim) {
+        text += (dim ? "x" : "") + std::to_string(localSize[dim]);
+    }
+    return text;
+}
+
+}
+
+std::vector<std::vector<size_t>> legalLocalSizes(const DeviceCapabilities& caps, cl_device_id device, cl_kernel kernel, const std::vector<size_t>& globalSize) {
+    size_t kernelLimit = 0;
+    size_t multiple = 1;
+    checkOpenCLError( clGetKernelWorkGroupInfo(kernel, device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(kernelLimit), &kernelLimit, nullptr) );
+    checkOpenCLError( clGetKernelWorkGroupInfo(kernel, device, CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE, sizeof(multiple), &multiple, nullptr) );
+
+    size_t limit = std::min(kernelLimit, caps.maxWorkGroupSize);
+    // The preferred multiple is the SIMD width in practice, i.e. the sub-group size.
+    if(caps.maxNumSubGroups > 0 && multiple > 1) {
+        limit = std::min<size_t>(limit, static_cast<size_t>(caps.maxNumSubGroups) * multiple);
+    }
+
+    std::vector<std::vector<size_t>> perDimension;
+    for(size_t dim = 0; dim < globalSize.size(); ++dim) {
+        size_t maxItems = dim < caps.maxWorkItemSizes.size() ? caps.maxWorkItemSizes[dim] : 1;
+        perDimension.push_back(dimensionCandidates(globalSize[dim], std::min(maxItems, limit), dim == 0 ? multiple : 1));
+    }
+
+    // Cartesian product of the per-dimension candidates, pruned by the total work-group limit.
+    std::vector<std::vector<size_t>> candidates = {{}};
+    for(const auto& sizes : perDimension) {
+        std::vector<std::vector<size_t>> extended;
+        for(const auto& prefix : candidates) {
+            size_t items = 1;
+            for(auto size : prefix) {
+                items *= size;
+            }
+            for(auto size : sizes) {
+                if(items * size <= limit) {
+                    extended.push_back(prefix);
+                    extended.back().push_back(size);
+                }
+            }
+        }
+        candidates.swap(extended);
+    }
+    return candidates;
+}
+
+WorkGroupTuning tuneWorkGroupSize(const DeviceSession& session, const DeviceCapabilities& caps, cl_kernel kernel, const std::string& kernelName,
+                                  const std::vector<size_t>& globalSize, TuningDatabase& database, int repetitions, bool retune) {
+    WorkGroupTuning tuning;
+    tuning.kernelName = kernelName;
+    tuning.globalSize = globalSize;
+
+    auto key = TuningDatabase::makeKey(caps, kernelName, globalSize);
+    TuningRecord record;
+    if(!retune && database.find(key, record)) {
+        tuning.localSize = record.localSize;
+        tuning.nanoseconds = record.nanoseconds;
+        tuning.fromDatabase = true;
+        return tuning;
+    }
+
+    tuning.candidates.push_back({{}, timeLaunch(session, kernel, globalSize, {}, repetitions)});
+    for(const auto& localSize : legalLocalSizes(caps, session.device, kernel, globalSize)) {
+        tuning.candidates.push_back({localSize, timeLaunch(session, kernel, globalSize, localSize, repetitions)});
+    }
+
+    auto best = std::min_element(tuning.candidates.begin(), tuning.candidates.end(),
+                                 [](const WorkGroupCandidate& a, const WorkGroupCandidate& b) { return a.nanoseconds < b.nanoseconds; });
+    tuning.localSize = best->localSize;
+    tuning.nanoseconds = best->nanoseconds;
+
+    record.localSize = tuning.localSize;
+    record.nanoseconds = tuning.nanoseconds;
+    database.store(key, record);
+    return tuning;
+}
+
+cl_int enqueueTuned(cl_command_queue queue, cl_kernel kernel, const std::vector<size_t>& globalSize, const std::vector<size_t>& localSize,
+                    cl_uint numEvents, const cl_event* waitList, cl_event* event) {
+    return clEnqueueNDRangeKernel(queue, kernel, static_cast<cl_uint>(globalSize.size()), nullptr, globalSize.data(),
+                                  localSize.empty() ? nullptr : localSize.data(), numEvents, waitList, event);
+}
+
+std::vector<WorkGroupTuning> tuneSampleKernels(const DeviceRecord& record, TuningDatabase& database, int repetitions, bool retune) {
+    std::vector<WorkGroupTuning> tunings;
+    const auto& caps = record.caps;
+
+    auto session = DeviceSession::create(record.device);
+    cl_program program = buildProgram(session.context, record.device, kSampleSource);
+    cl_int err;
+
+    // 4M floats for saxpy and a 1024x1024 image for the blur, less if the device cannot allocate that much.
+    size_t elements = std::min<size_t>(1u << 22, caps.maxMemAllocSize / sizeof(float));
+    size_t side = 1024;
+    while(side > 16 && side * side * sizeof(float) > caps.maxMemAllocSize) {
+        side /= 2;
+    }
+    size_t bytes = std::max(elements, side * side) * sizeof(float);
+    cl_mem a = clCreateBuffer(session.context, CL_MEM_READ_WRITE, bytes, nullptr, &err);
+    checkOpenCLError(err);
+    cl_mem b = clCreateBuffer(session.context, CL_MEM_READ_WRITE, bytes, nullptr, &err);
+    checkOpenCLError(err);
+    float zero = 0.0f;
+    checkOpenCLError( clEnqueueFillBuffer(session.queue, a, &zero, sizeof(zero), 0, bytes, 0, nullptr, nullptr) );
+    checkOpenCLError( clEnqueueFillBuffer(session.queue, b, &zero, sizeof(zero), 0, bytes, 0, nullptr, nullptr) );
+
+    cl_kernel saxpy = createKernel(program, "saxpy");
+    float factor = 2.0f;
+    checkOpenCLError( clSetKernelArg(saxpy, 0, sizeof(cl_mem), &a) );
+    checkOpenCLError( clSetKernelArg(saxpy, 1, sizeof(cl_mem), &b) );
+    checkOpenCLError( clSetKernelArg(saxpy, 2, sizeof(float), &factor) );
+    tunings.push_back(tuneWorkGroupSize(session, caps, saxpy, "saxpy", {elements}, database, repetitions, retune));
+
+    cl_kernel blur = createKernel(program, "box_blur");
+    checkOpenCLError( clSetKernelArg(blur, 0, sizeof(cl_mem), &a) );
+    checkOpenCLError( clSetKernelArg(blur, 1, sizeof(cl_mem), &b) );
+    tunings.push_back(tuneWorkGroupSize(session, caps, blur, "box_blur", {side, side}, database, repetitions, retune));
+
+    clReleaseKernel(blur);
+    clReleaseKernel(saxpy);
+    clReleaseMemObject(b);
+    clReleaseMemObject(a);
+    clReleaseProgram(program);
+    session.release();
+    return tunings;
+}
+
+void printTuningReport(const std::vector<WorkGroupTuning>& tunings) {
+    for(const auto& tuning : tunings) {
+        std::cout << tuning.kernelName << " global " << formatLocalSize(tuning.globalSize) << ": local " << formatLocalSize(tuning.localSize)
+                  << std::fixed << std::setprecision(1) << " (" << tuning.nanoseconds / 1000.0 << " us)" << std::defaultfloat;
+        if(tuning.fromDatabase) {
+            std::cout << " from the tuning database" << std::endl;
+            continue;
+        }
+        std::cout << ", best of " << tuning.candidates.size() << " candidates" << std::endl;
+
+        double driverChoice = tuning.candidates.front().nanoseconds;
+        for(const auto& candidate : tuning.candidates) {
+            std::cout << "    " << std::left << std::setw(12) << formatLocalSize(candidate.localSize) << std::right
+                      << std::fixed << std::setprecision(1) << std::setw(12) << candidate.nanoseconds / 1000.0 << " us"
+                      << std::setprecision(2) << std::setw(8) << (candidate.nanoseconds > 0 ? driverChoice / candidate.nanoseconds : 0.0) << "x"
+                      << std::defaultfloat << std::endl;
+        }
+    }
+}
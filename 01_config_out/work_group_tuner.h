@@ -0,0 +1,50 @@
+#ifndef WORK_GROUP_TUNER_H
+#define WORK_GROUP_TUNER_H
+
+#include <string>
+#include <vector>
+
+#include <CL/cl.h>
+
+#include "device_inventory.h"
+#include "device_session.h"
+#include "tuning_database.h"
+
+struct WorkGroupCandidate {
+    // Empty for the driver's choice.
+    std::vector<size_t> localSize;
+    double nanoseconds = 0.0;
+};
+
+struct WorkGroupTuning {
+    std::string kernelName;
+    std::vector<size_t> globalSize;
+    // Winning local size, empty if passing NULL was fastest.
+    std::vector<size_t> localSize;
+    double nanoseconds = 0.0;
+    bool fromDatabase = false;
+    // Every measured candidate, the driver's choice first. Empty when the result came from the database.
+    std::vector<WorkGroupCandidate> candidates;
+};
+
+// Every local size the kernel may legally be launched with on the device for this global size:
+// each dimension within CL_DEVICE_MAX_WORK_ITEM_SIZES and dividing the global size, the product within CL_KERNEL_WORK_GROUP_SIZE
+// (which is already capped by CL_DEVICE_MAX_WORK_GROUP_SIZE) and within CL_DEVICE_MAX_NUM_SUB_GROUPS sub-groups.
+// Dimension 0 walks powers of two and multiples of CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE, the other dimensions powers of two.
+std::vector<std::vector<size_t>> legalLocalSizes(const DeviceCapabilities& caps, cl_device_id device, cl_kernel kernel, const std::vector<size_t>& globalSize);
+
+// Return the tuned local size from the database or, on a miss (or with retune), time every legal candidate with profiling events
+// and store the winner. The kernel arguments must be set, the queue of the session needs CL_QUEUE_PROFILING_ENABLE.
+WorkGroupTuning tuneWorkGroupSize(const DeviceSession& session, const DeviceCapabilities& caps, cl_kernel kernel, const std::string& kernelName,
+                                  const std::vector<size_t>& globalSize, TuningDatabase& database, int repetitions, bool retune = false);
+
+// Launch with a tuned local size, NULL if tuning picked the driver's choice.
+cl_int enqueueTuned(cl_command_queue queue, cl_kernel kernel, const std::vector<size_t>& globalSize, const std::vector<size_t>& localSize,
+                    cl_uint numEvents = 0, const cl_event* waitList = nullptr, cl_event* event = nullptr);
+
+// Tune the built-in sample kernels (1D saxpy, 2D 3x3 box blur) on the device.
+std::vector<WorkGroupTuning> tuneSampleKernels(const DeviceRecord& record, TuningDatabase& database, int repetitions, bool retune);
+
+void printTuningReport(const std::vector<WorkGroupTuning>& tunings);
+
+#endif //WORK_GROUP_TUNER_H